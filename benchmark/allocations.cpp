@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <jwt-cpp/jwt.h>
+
+/*
+ * Counts the heap allocations done by the common operations and compares them against allocation-budgets.txt.
+ *
+ * Every global operator new is replaced by a counting one. Allocations done inside OpenSSL do not go through
+ * operator new, they are counted through the memory hooks OpenSSL provides for this purpose, where available.
+ * Budgets only apply to operator new, the OpenSSL numbers depend too much on its version and are only reported.
+ *
+ * Usage: allocations [budget file] [--write]
+ * With --write the measured values plus some headroom are written to the budget file instead of being checked.
+ * The budgets were measured with libstdc++, other standard libraries allocate differently so they are only
+ * checked when building against libstdc++.
+ */
+
+inline namespace test_keys {
+	extern std::string rsa_priv_key;
+	extern std::string rsa_pub_key;
+	extern std::string ecdsa256_priv_key;
+	extern std::string ecdsa256_pub_key;
+	extern std::string ed25519_priv_key;
+	extern std::string ed25519_pub_key;
+} // namespace test_keys
+
+namespace {
+	std::atomic<uint64_t> new_count{0};
+	std::atomic<uint64_t> new_bytes{0};
+	std::atomic<uint64_t> crypto_count{0};
+
+	void* counted_alloc(std::size_t size) {
+		new_count.fetch_add(1, std::memory_order_relaxed);
+		new_bytes.fetch_add(size, std::memory_order_relaxed);
+		return std::malloc(size == 0 ? 1 : size);
+	}
+
+#if defined(JWT_OPENSSL_CRYPTO) && OPENSSL_VERSION_NUMBER >= 0x10100000L && !defined(LIBRESSL_VERSION_NUMBER)
+#define JWT_COUNT_CRYPTO_ALLOCATIONS
+	void* crypto_malloc(size_t size, const char*, int) {
+		crypto_count.fetch_add(1, std::memory_order_relaxed);
+		return std::malloc(size);
+	}
+	void* crypto_realloc(void* ptr, size_t size, const char*, int) {
+		crypto_count.fetch_add(1, std::memory_order_relaxed);
+		return std::realloc(ptr, size);
+	}
+	void crypto_free(void* ptr, const char*, int) { std::free(ptr); }
+#endif
+
+	struct measurement {
+		uint64_t allocations;
+		uint64_t bytes;
+		uint64_t crypto_allocations;
+	};
+
+	constexpr size_t iterations = 16;
+
+	// Runs fn once to warm up lazily initialized state, then reports the average of the following runs
+	template<typename Fn>
+	measurement measure(Fn&& fn) {
+		fn();
+		const auto count = new_count.load();
+		const auto bytes = new_bytes.load();
+		const auto crypto = crypto_count.load();
+		for (size_t i = 0; i < iterations; i++)
+			fn();
+		return {(new_count.load() - count + iterations - 1) / iterations,
+				(new_bytes.load() - bytes + iterations - 1) / iterations,
+				(crypto_count.load() - crypto + iterations - 1) / iterations};
+	}
+
+	const std::string jwks_json = R"({"keys": [{
+		"kid": "rsa-key",
+		"use": "sig",
+		"alg": "RS256",
+		"kty": "RSA",
+		"n": "uGbXWiK3dQTyCbX5xdE4yCuYp0AF2d15Qq1JSXT_lx8CEcXb9RbDddl8jGDv-spi5qPa8qEHiK7FwV2KpRE983wGPnYsAm9BxLFb4YrLYcDFOIGULuk2FtrPS512Qea1bXASuvYXEpQNpGbnTGVsWXI9C-yjHztqyL2h8P6mlThPY9E9ue2fCqdgixfTFIF9Dm4SLHbphUS2iw7w1JgT69s7of9-I9l5lsJ9cozf1rxrXX4V1u_SotUuNB3Fp8oB4C1fLBEhSlMcUJirz1E8AziMCxS-VrRPDM-zfvpIJg3JljAh3PJHDiLu902v9w-Iplu1WyoB2aPfitxEhRN0Yw",
+		"e": "AQAB"
+	}, {
+		"kid": "ec-key",
+		"kty": "EC",
+		"crv": "P-256",
+		"x": "Qgb5npLHd0Bk61bNnjK632uwmBfrF7I8hoPgaOZjyhg",
+		"y": "fgazwzugi-g_2lv8jzm115u0qWaIJkcBkTnDgN8lJXo"
+	}]})";
+
+	template<typename Algorithm>
+	void add_verify(std::map<std::string, measurement>& results, const std::string& name, const Algorithm& alg) {
+		const auto token = jwt::decode(jwt::create().set_issuer("auth0").set_type("JWT").sign(alg));
+		const auto verify = jwt::verify().allow_algorithm(alg).with_issuer("auth0");
+		results["verify_" + name] = measure([&]() {
+			std::error_code ec;
+			verify.verify(token, ec);
+			if (ec) std::abort();
+		});
+	}
+
+	std::map<std::string, measurement> run() {
+		std::map<std::string, measurement> results;
+
+		const jwt::algorithm::hs256 hs256{"secret"};
+		const jwt::algorithm::rs256 rs256{rsa_pub_key, rsa_priv_key};
+		const jwt::algorithm::ps256 ps256{rsa_pub_key, rsa_priv_key};
+		const jwt::algorithm::es256 es256{ecdsa256_pub_key, ecdsa256_priv_key};
+		const jwt::algorithm::ed25519 ed25519{ed25519_pub_key, ed25519_priv_key};
+
+		const auto token = jwt::create()
+							   .set_issuer("auth0")
+							   .set_type("JWT")
+							   .set_subject("user")
+							   .set_issued_at(std::chrono::system_clock::from_time_t(1600000000))
+							   .sign(hs256);
+		results["decode"] = measure([&]() { jwt::decode(token); });
+
+		add_verify(results, "hs256", hs256);
+		add_verify(results, "rs256", rs256);
+		add_verify(results, "ps256", ps256);
+		add_verify(results, "es256", es256);
+		add_verify(results, "ed25519", ed25519);
+
+		results["sign_hs256"] = measure([&]() { jwt::create().set_issuer("auth0").set_type("JWT").sign(hs256); });
+		results["sign_rs256"] = measure([&]() { jwt::create().set_issuer("auth0").set_type("JWT").sign(rs256); });
+
+		jwt::streaming_builder streaming;
+		results["sign_hs256_streaming"] = measure([&]() {
+			streaming.clear();
+			streaming.set_issuer("auth0").set_type("JWT").sign(hs256);
+		});
+
+		const auto tmpl = jwt::create().set_issuer("auth0").set_type("JWT").make_template(hs256);
+		const picojson::object claims{{"sub", picojson::value("user")}};
+		std::string buffer;
+		results["mint_hs256"] = measure([&]() {
+			std::error_code ec;
+			buffer.clear();
+			tmpl.mint(claims, buffer, ec);
+		});
+
+		auto prepared = jwt::create().set_issuer("auth0").set_type("JWT").prepare(hs256);
+		const auto iat = prepared.add_date_slot("iat");
+		const auto sub = prepared.add_string_slot("sub");
+		const auto issued_at = std::chrono::system_clock::from_time_t(1600000000);
+		results["sign_hs256_prepared"] = measure([&]() {
+			std::error_code ec;
+			buffer.clear();
+			prepared.set(iat, issued_at).set(sub, "user").sign(buffer, ec);
+		});
+
+		results["jwks_parse"] = measure([&]() { jwt::parse_jwks(jwks_json); });
+		results["jwks_parse_key_material"] =
+			measure([&]() { jwt::parse_jwks(jwks_json, jwt::jwks_retain::key_material); });
+
+		const auto jwks = jwt::parse_jwks(jwks_json);
+		const auto& jwk = jwks.get_jwk("rsa-key");
+		results["jwk_lookup"] = measure([&]() { jwks.get_jwk("ec-key"); });
+		results["jwk_accessors"] = measure([&]() {
+			jwk.get_key_id();
+			jwk.get_key_type();
+			jwk.get_algorithm();
+			jwk.get_jwk_claim("n").as_string();
+		});
+		return results;
+	}
+
+	std::map<std::string, measurement> read_budgets(const std::string& path) {
+		std::map<std::string, measurement> budgets;
+		std::ifstream file(path);
+		std::string line;
+		while (std::getline(file, line)) {
+			if (line.empty() || line[0] == '#') continue;
+			std::istringstream in(line);
+			std::string name;
+			measurement budget{};
+			if (in >> name >> budget.allocations >> budget.bytes) budgets[name] = budget;
+		}
+		return budgets;
+	}
+
+	// Leaves room for other json library versions and small changes, a real regression still exceeds it.
+	// Operations that do not allocate at all stay at zero.
+	uint64_t with_headroom(uint64_t measured, uint64_t minimum) {
+		return measured == 0 ? 0 : measured + std::max(minimum, (measured + 4) / 5);
+	}
+
+	void write_budgets(const std::string& path, const std::map<std::string, measurement>& results) {
+		std::ofstream file(path);
+		file << "# Maximum operator new calls and bytes per operation, checked by benchmark/allocations.cpp\n"
+			 << "# Measured with libstdc++ plus 20% headroom, regenerate with `allocations <this file> --write`\n"
+			 << "# name allocations bytes\n";
+		for (const auto& r : results)
+			file << r.first << " " << with_headroom(r.second.allocations, 2) << " " << with_headroom(r.second.bytes, 64)
+				 << "\n";
+	}
+} // namespace
+
+void* operator new(std::size_t size) {
+	if (void* ptr = counted_alloc(size)) return ptr;
+	throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+int main(int argc, const char** argv) {
+#ifdef JWT_COUNT_CRYPTO_ALLOCATIONS
+	CRYPTO_set_mem_functions(crypto_malloc, crypto_realloc, crypto_free);
+#endif
+	const std::string budget_file = argc > 1 ? argv[1] : "";
+	const bool write = argc > 2 && std::string(argv[2]) == "--write";
+
+	const auto results = run();
+#ifdef __GLIBCXX__
+	const bool check = !budget_file.empty() && !write;
+#else
+	const bool check = false;
+	if (!budget_file.empty() && !write) std::cout << "budgets are only checked with libstdc++\n";
+#endif
+	const auto budgets = check ? read_budgets(budget_file) : std::map<std::string, measurement>{};
+
+	int exceeded = 0;
+	std::cout << std::left << std::setw(26) << "operation" << std::right << std::setw(12) << "allocations"
+			  << std::setw(10) << "bytes" << std::setw(10) << "openssl" << "\n";
+	for (const auto& r : results) {
+		std::cout << std::left << std::setw(26) << r.first << std::right << std::setw(12) << r.second.allocations
+				  << std::setw(10) << r.second.bytes << std::setw(10) << r.second.crypto_allocations;
+		const auto budget = budgets.find(r.first);
+		if (budget != budgets.end() &&
+			(r.second.allocations > budget->second.allocations || r.second.bytes > budget->second.bytes)) {
+			std::cout << "  over budget (" << budget->second.allocations << " allocations, " << budget->second.bytes
+					  << " bytes)";
+			exceeded++;
+		} else if (check && budget == budgets.end()) {
+			std::cout << "  no budget";
+		}
+		std::cout << "\n";
+	}
+
+	if (write) {
+		write_budgets(budget_file, results);
+		std::cout << "budgets written to " << budget_file << std::endl;
+	}
+	return exceeded == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,101 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <jwt-cpp/jwt.h>
+
+/*
+ * Compares checking the signatures of a batch of HMAC signed tokens with one key:
+ *  - HMAC(): OpenSSL's one-shot HMAC() per token, as hmacsha did before keyed states were cached
+ *  - verify: hmacsha::verify() per token
+ *  - verify_batch: hmacsha::verify_batch(), using the multi-buffer engine
+ *
+ * Usage: hmac-batch [tokens per batch] [milliseconds per run]
+ */
+
+namespace {
+	struct batch {
+		std::vector<std::string> data;
+		std::vector<std::string> signatures;
+	};
+
+	template<typename Algorithm>
+	batch make_batch(const Algorithm& alg, size_t count) {
+		batch res;
+		for (size_t i = 0; i < count; i++) {
+			const auto token = jwt::create()
+								   .set_issuer("auth0")
+								   .set_type("JWT")
+								   .set_subject("user-" + std::to_string(i))
+								   .set_id(std::to_string(i * 7919))
+								   .set_issued_at(std::chrono::system_clock::from_time_t(1600000000))
+								   .sign(alg);
+			const auto decoded = jwt::decode(token);
+			res.data.push_back(decoded.get_header_base64() + "." + decoded.get_payload_base64());
+			res.signatures.push_back(decoded.get_signature());
+		}
+		return res;
+	}
+
+	// Runs fn repeatedly for the given time and returns the nanoseconds per token
+	template<typename Fn>
+	double time_per_token(size_t tokens, std::chrono::milliseconds duration, const Fn& fn) {
+		size_t runs = 0;
+		const auto begin = std::chrono::steady_clock::now();
+		auto now = begin;
+		while (now - begin < duration) {
+			fn();
+			runs++;
+			now = std::chrono::steady_clock::now();
+		}
+		return std::chrono::duration<double, std::nano>(now - begin).count() / static_cast<double>(runs * tokens);
+	}
+
+	template<typename Algorithm>
+	void run(const std::string& name, const EVP_MD* md, size_t count, std::chrono::milliseconds duration) {
+		const std::string key = "benchmark secret";
+		const Algorithm alg{key};
+		const auto b = make_batch(alg, count);
+
+		const auto one_shot = time_per_token(count, duration, [&]() {
+			unsigned char res[EVP_MAX_MD_SIZE];
+			unsigned int len = 0;
+			for (size_t i = 0; i < count; i++) {
+				if (HMAC(md, key.data(), static_cast<int>(key.size()),
+						 reinterpret_cast<const unsigned char*>(b.data[i].data()), b.data[i].size(), res,
+						 &len) == nullptr ||
+					b.signatures[i].compare(0, std::string::npos, reinterpret_cast<const char*>(res), len) != 0)
+					std::abort();
+			}
+		});
+		const auto single = time_per_token(count, duration, [&]() {
+			std::error_code ec;
+			for (size_t i = 0; i < count; i++) {
+				alg.verify(b.data[i], b.signatures[i], ec);
+				if (ec) std::abort();
+			}
+		});
+		std::vector<std::error_code> ec;
+		const auto batched = time_per_token(count, duration, [&]() {
+			alg.verify_batch(b.data, b.signatures, ec);
+			for (const auto& e : ec)
+				if (e) std::abort();
+		});
+
+		std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(0)
+				  << std::setw(12) << one_shot << std::setw(12) << single << std::setw(14) << batched
+				  << std::setprecision(2) << std::setw(10) << one_shot / batched << std::endl;
+	}
+} // namespace
+
+int main(int argc, const char** argv) {
+	const size_t count = argc > 1 ? std::stoul(argv[1]) : 256;
+	const std::chrono::milliseconds duration{argc > 2 ? std::stoul(argv[2]) : 500};
+
+	std::cout << "ns per token, " << count << " tokens per batch\n"
+			  << std::left << std::setw(10) << "algorithm" << std::right << std::setw(12) << "HMAC()"
+			  << std::setw(12) << "verify" << std::setw(14) << "verify_batch" << std::setw(10) << "speedup"
+			  << std::endl;
+	run<jwt::algorithm::hs256>("HS256", EVP_sha256(), count, duration);
+	run<jwt::algorithm::hs384>("HS384", EVP_sha384(), count, duration);
+	run<jwt::algorithm::hs512>("HS512", EVP_sha512(), count, duration);
+}
@@ -0,0 +1,121 @@
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <jwt-cpp/jwt.h>
+
+/*
+ * Measures how signing and verification scale when several threads share one verifier or algorithm instance.
+ *
+ * Usage: scaling [max threads, 0 for all cores] [milliseconds per run]
+ * For every algorithm and 1, 2, 4, ... up to max threads, all threads run the same operation for the given time.
+ * Efficiency is the throughput relative to the single threaded throughput multiplied by the number of threads.
+ */
+
+inline namespace test_keys {
+	extern std::string rsa_priv_key;
+	extern std::string rsa_pub_key;
+	extern std::string ecdsa256_priv_key;
+	extern std::string ecdsa256_pub_key;
+	extern std::string ed25519_priv_key;
+	extern std::string ed25519_pub_key;
+} // namespace test_keys
+
+namespace {
+	std::vector<size_t> thread_counts(size_t max_threads) {
+		std::vector<size_t> res;
+		for (size_t t = 1; t < max_threads; t *= 2)
+			res.push_back(t);
+		res.push_back(max_threads);
+		return res;
+	}
+
+	// Runs fn on the given number of threads for the given time and returns the total operations per second
+	template<typename Fn>
+	double throughput(size_t threads, std::chrono::milliseconds duration, const Fn& fn) {
+		std::atomic<bool> start{false};
+		std::atomic<bool> stop{false};
+		std::atomic<uint64_t> total{0};
+		std::vector<std::thread> workers;
+		for (size_t i = 0; i < threads; i++) {
+			workers.emplace_back([&]() {
+				while (!start.load(std::memory_order_acquire))
+					std::this_thread::yield();
+				uint64_t ops = 0;
+				while (!stop.load(std::memory_order_relaxed)) {
+					fn();
+					ops++;
+				}
+				total.fetch_add(ops);
+			});
+		}
+		const auto begin = std::chrono::steady_clock::now();
+		start.store(true, std::memory_order_release);
+		std::this_thread::sleep_for(duration);
+		stop.store(true);
+		for (auto& w : workers)
+			w.join();
+		const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		return static_cast<double>(total.load()) / elapsed;
+	}
+
+	template<typename Fn>
+	void report(const std::string& name, size_t max_threads, std::chrono::milliseconds duration, const Fn& fn) {
+		double single = 0;
+		for (auto threads : thread_counts(max_threads)) {
+			const auto ops = throughput(threads, duration, fn);
+			if (threads == 1) single = ops;
+			const auto per_thread = ops / static_cast<double>(threads);
+			std::cout << std::left << std::setw(16) << name << std::right << std::setw(8) << threads << std::fixed
+					  << std::setprecision(0) << std::setw(14) << ops << std::setw(14) << per_thread
+					  << std::setprecision(2) << std::setw(12) << (single > 0 ? per_thread / single : 0) << std::endl;
+		}
+	}
+
+	template<typename Algorithm>
+	void run(const std::string& name, const Algorithm& alg, size_t max_threads, std::chrono::milliseconds duration) {
+		const auto token = jwt::decode(jwt::create().set_issuer("auth0").set_type("JWT").sign(alg));
+		const auto verify = jwt::verify().allow_algorithm(alg).with_issuer("auth0");
+		report("verify " + name, max_threads, duration, [&]() {
+			std::error_code ec;
+			verify.verify(token, ec);
+			if (ec) std::abort();
+		});
+
+		const auto data = token.get_header_base64() + "." + token.get_payload_base64();
+		report("sign " + name, max_threads, duration, [&]() {
+			std::error_code ec;
+			alg.sign(data, ec);
+			if (ec) std::abort();
+		});
+	}
+
+	std::string library_version() {
+#if defined(JWT_WIN_CRYPTO)
+		return "Windows CNG";
+#elif OPENSSL_VERSION_NUMBER >= 0x10100000L
+		return OpenSSL_version(OPENSSL_VERSION);
+#else
+		return SSLeay_version(SSLEAY_VERSION);
+#endif
+	}
+} // namespace
+
+int main(int argc, const char** argv) {
+	size_t max_threads = argc > 1 ? std::stoul(argv[1]) : 0;
+	if (max_threads == 0) max_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+	const std::chrono::milliseconds duration{argc > 2 ? std::stoul(argv[2]) : 500};
+
+	std::cout << "crypto library: " << library_version() << "\n"
+			  << std::left << std::setw(16) << "operation" << std::right << std::setw(8) << "threads"
+			  << std::setw(14) << "ops/s" << std::setw(14) << "ops/s/thread" << std::setw(12) << "efficiency"
+			  << std::endl;
+
+	run("HS256", jwt::algorithm::hs256{"secret"}, max_threads, duration);
+	run("RS256", jwt::algorithm::rs256{rsa_pub_key, rsa_priv_key}, max_threads, duration);
+	run("PS256", jwt::algorithm::ps256{rsa_pub_key, rsa_priv_key}, max_threads, duration);
+	run("ES256", jwt::algorithm::es256{ecdsa256_pub_key, ecdsa256_priv_key}, max_threads, duration);
+	run("EdDSA", jwt::algorithm::ed25519{ed25519_pub_key, ed25519_priv_key}, max_threads, duration);
+}
@@ -0,0 +1,38 @@
+#include <chrono>
+#include <iostream>
+#include <jwt-cpp/jwt.h>
+
+template<typename Fn>
+void run(const std::string& name, size_t iterations, Fn&& fn) {
+	size_t matched = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < iterations; i++) {
+		if (fn()) matched++;
+	}
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+	const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+	std::cout << name << ": " << static_cast<double>(ns) / iterations << " ns/op (" << matched << " matched)"
+			  << std::endl;
+}
+
+int main(int argc, const char** argv) {
+	const size_t iterations = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+	using claim_t = jwt::verify_ops::insensitive_string_claim<jwt::picojson_traits, true>;
+	const claim_t typ{"JWT", std::locale{}};
+	const std::string ascii = "jwt";
+	const std::string unicode = "jwt\xC3\xA9";
+
+	run("unicode conversion (ascii)", iterations,
+		[&]() { return claim_t::to_lower_unicode(ascii, typ.locale) == typ.expected; });
+	run("fast path (ascii)", iterations, [&]() { return typ.matches(ascii); });
+	run("fast path (non ascii)", iterations, [&]() { return typ.matches(unicode); });
+
+	const auto token = jwt::decode(jwt::create().set_type("JWT").set_issuer("auth0").sign(jwt::algorithm::none{}));
+	const auto verify = jwt::verify().with_type("jwt").allow_algorithm(jwt::algorithm::none{});
+	run("verify with typ", iterations / 10, [&]() {
+		std::error_code ec;
+		verify.verify(token, ec);
+		return !ec;
+	});
+}
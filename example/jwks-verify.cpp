@@ -39,7 +39,7 @@ int main() {
 
 	auto decoded_jwt = jwt::decode(token);
 	auto jwks = jwt::parse_jwks(publicKey);
-	auto jwk = jwks.get_jwk(decoded_jwt.get_key_id());
+	const auto& jwk = jwks.get_jwk(decoded_jwt.get_key_id());
 
 	auto issuer = decoded_jwt.get_issuer();
 	auto x5c = jwk.get_x5c_key_value();
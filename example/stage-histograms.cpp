@@ -0,0 +1,84 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <jwt-cpp/jwt.h>
+
+/// Collects a latency histogram with power of two nanosecond buckets for every stage
+class histogram_observer {
+public:
+	static constexpr bool enabled = true;
+	static constexpr size_t stage_count = static_cast<size_t>(jwt::stage::encode) + 1;
+	static constexpr size_t bucket_count = 32;
+
+	histogram_observer() {
+		for (auto& stage : buckets)
+			for (auto& bucket : stage)
+				bucket = 0;
+	}
+
+	void on_stage_begin(const jwt::stage_event& e) { started()[index(e)] = std::chrono::steady_clock::now(); }
+
+	void on_stage_end(const jwt::stage_event& e) {
+		const auto elapsed = std::chrono::steady_clock::now() - started()[index(e)];
+		auto ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+		size_t bucket = 0;
+		while (ns > 1 && bucket < bucket_count - 1) {
+			ns >>= 1;
+			bucket++;
+		}
+		buckets[index(e)][bucket].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void print(std::ostream& os) const {
+		static const char* names[] = {"split",     "base64_decode", "header_parse", "payload_parse",
+									  "signature", "claim",         "encode"};
+		for (size_t s = 0; s < stage_count; s++) {
+			os << names[s] << ":";
+			for (size_t b = 0; b < bucket_count; b++) {
+				const auto count = buckets[s][b].load(std::memory_order_relaxed);
+				if (count != 0) os << " <" << (uint64_t{1} << (b + 1)) << "ns=" << count;
+			}
+			os << std::endl;
+		}
+	}
+
+private:
+	std::array<std::array<std::atomic<uint64_t>, bucket_count>, stage_count> buckets;
+
+	static size_t index(const jwt::stage_event& e) { return static_cast<size_t>(e.stage); }
+
+	// Stages do not nest within one kind, so one start time per stage and thread is enough
+	static std::array<std::chrono::steady_clock::time_point, stage_count>& started() {
+		static thread_local std::array<std::chrono::steady_clock::time_point, stage_count> times;
+		return times;
+	}
+};
+
+int main() {
+	histogram_observer observer;
+
+	std::error_code ec;
+	const auto token = jwt::create()
+						   .set_issuer("auth0")
+						   .set_type("JWT")
+						   .set_payload_claim("sample", jwt::claim(std::string("test")))
+						   .sign(jwt::algorithm::hs256{"secret"}, ec, &observer);
+
+	auto verifier = jwt::verifier<jwt::default_clock, jwt::picojson_traits, histogram_observer>({})
+						.allow_algorithm(jwt::algorithm::hs256{"secret"})
+						.with_issuer("auth0")
+						.with_type("jwt")
+						.with_observer(&observer);
+
+	for (int i = 0; i < 10000; i++) {
+		const jwt::decoded_jwt<jwt::picojson_traits> decoded(token, observer);
+		verifier.verify(decoded, ec);
+		if (ec) {
+			std::cerr << ec.message() << std::endl;
+			return 1;
+		}
+	}
+
+	observer.print(std::cout);
+}
@@ -77,6 +77,32 @@ namespace jwt {
 		static std::string trim(const std::string& base) {
 			return trim(base, T::fill());
 		}
+		/**
+		 * Encode without padding and append the result to an existing string
+		 * \param bin Data to encode
+		 * \param out String the encoded data is appended to
+		 */
+		template<typename T>
+		static void encode_unpadded(const std::string& bin, std::string& out) {
+			encode_unpadded(bin, T::data(), out);
+		}
+		/**
+		 * Decode input without padding and append the result to an existing string
+		 * \param base Pointer to the encoded data
+		 * \param size Number of characters to decode
+		 * \param out String the decoded data is appended to
+		 * \throw std::runtime_error Invalid input, out may have been extended
+		 */
+		template<typename T>
+		static void decode_unpadded(const char* base, size_t size, std::string& out) {
+			decode_unpadded(base, size, sextets<T>(), out);
+		}
+		/**
+		 * Get the length of the unpadded encoding
+		 * \param size Number of bytes to encode
+		 * \return Number of characters produced by encode_unpadded
+		 */
+		static size_t unpadded_size(size_t size) noexcept { return size / 3 * 4 + (size % 3 == 0 ? 0 : size % 3 + 1); }
 
 	private:
 		static std::string encode(const std::string& bin, const std::array<char, 64>& alphabet,
@@ -128,6 +154,74 @@ namespace jwt {
 			return res;
 		}
 
+		static void encode_unpadded(const std::string& bin, const std::array<char, 64>& alphabet, std::string& out) {
+			const size_t size = bin.size();
+			const size_t offset = out.size();
+			out.resize(offset + unpadded_size(size));
+			char* res = &out[offset];
+
+			size_t i = 0;
+			for (; i + 3 <= size; i += 3) {
+				const uint32_t triple = (static_cast<uint32_t>(static_cast<unsigned char>(bin[i])) << 0x10) +
+										(static_cast<uint32_t>(static_cast<unsigned char>(bin[i + 1])) << 0x08) +
+										static_cast<unsigned char>(bin[i + 2]);
+				*res++ = alphabet[(triple >> 3 * 6) & 0x3F];
+				*res++ = alphabet[(triple >> 2 * 6) & 0x3F];
+				*res++ = alphabet[(triple >> 1 * 6) & 0x3F];
+				*res++ = alphabet[(triple >> 0 * 6) & 0x3F];
+			}
+			if (i == size) return;
+
+			const uint32_t octet_a = static_cast<unsigned char>(bin[i]);
+			const uint32_t octet_b = i + 1 < size ? static_cast<unsigned char>(bin[i + 1]) : 0;
+			const uint32_t triple = (octet_a << 0x10) + (octet_b << 0x08);
+			*res++ = alphabet[(triple >> 3 * 6) & 0x3F];
+			*res++ = alphabet[(triple >> 2 * 6) & 0x3F];
+			if (i + 1 < size) *res = alphabet[(triple >> 1 * 6) & 0x3F];
+		}
+
+		/// Value of every character in the alphabet T, 0xFF for characters outside of it. Built once per alphabet.
+		template<typename T>
+		static const std::array<uint8_t, 256>& sextets() {
+			static const std::array<uint8_t, 256> table = [] {
+				std::array<uint8_t, 256> res;
+				res.fill(0xFF);
+				for (size_t i = 0; i < T::data().size(); i++)
+					res[static_cast<unsigned char>(T::data()[i])] = static_cast<uint8_t>(i);
+				return res;
+			}();
+			return table;
+		}
+
+		static void decode_unpadded(const char* base, size_t size, const std::array<uint8_t, 256>& sextets,
+									std::string& out) {
+			if (size % 4 == 1) throw std::runtime_error("Invalid input");
+			const auto get_sextet = [&](size_t offset) {
+				const auto sextet = sextets[static_cast<unsigned char>(base[offset])];
+				if (sextet == 0xFF) throw std::runtime_error("Invalid input");
+				return static_cast<uint32_t>(sextet);
+			};
+
+			const size_t offset = out.size();
+			out.resize(offset + size / 4 * 3 + (size % 4 == 0 ? 0 : size % 4 - 1));
+			char* res = &out[offset];
+
+			size_t i = 0;
+			for (; i + 4 <= size; i += 4) {
+				const uint32_t triple = (get_sextet(i) << 3 * 6) + (get_sextet(i + 1) << 2 * 6) +
+										(get_sextet(i + 2) << 1 * 6) + get_sextet(i + 3);
+				*res++ = static_cast<char>((triple >> 2 * 8) & 0xFFU);
+				*res++ = static_cast<char>((triple >> 1 * 8) & 0xFFU);
+				*res++ = static_cast<char>((triple >> 0 * 8) & 0xFFU);
+			}
+			if (i == size) return;
+
+			uint32_t triple = (get_sextet(i) << 3 * 6) + (get_sextet(i + 1) << 2 * 6);
+			if (i + 2 < size) triple |= get_sextet(i + 2) << 1 * 6;
+			*res++ = static_cast<char>((triple >> 2 * 8) & 0xFFU);
+			if (i + 2 < size) *res = static_cast<char>((triple >> 1 * 8) & 0xFFU);
+		}
+
 		static std::string decode(const std::string& base, const std::array<char, 64>& alphabet,
 								  const std::string& fill) {
 			size_t size = base.size();
@@ -23,6 +23,12 @@ namespace jwt {
 		struct token_verification_exception : public std::system_error {
 			using system_error::system_error;
 		};
+		struct encryption_exception : public std::system_error {
+			using system_error::system_error;
+		};
+		struct decryption_exception : public std::system_error {
+			using system_error::system_error;
+		};
 		/**
 		 * \brief Errors related to processing of RSA signatures
 		 */
@@ -36,7 +42,9 @@ namespace jwt {
 			load_key_bio_write,
 			load_key_bio_read,
 			create_mem_bio_failed,
-			no_key_provided
+			no_key_provided,
+			set_rsa_failed,
+			create_context_failed
 		};
 		/**
 		 * \brief Error category for RSA errors
@@ -57,6 +65,8 @@ namespace jwt {
 					case rsa_error::load_key_bio_read: return "failed to load key: bio read failed";
 					case rsa_error::create_mem_bio_failed: return "failed to create memory bio";
 					case rsa_error::no_key_provided: return "at least one of public or private key need to be present";
+					case rsa_error::set_rsa_failed: return "setting RSA failed";
+					case rsa_error::create_context_failed: return "failed to create context";
 					default: return "unknown RSA error";
 					}
 				}
@@ -76,7 +86,11 @@ namespace jwt {
 			create_mem_bio_failed,
 			no_key_provided,
 			invalid_key_size,
-			invalid_key
+			invalid_key,
+			unknown_curve,
+			set_ecdsa_failed,
+			create_context_failed,
+			write_key_failed
 		};
 		/**
 		 * \brief Error category for ECDSA errors
@@ -95,6 +109,10 @@ namespace jwt {
 						return "at least one of public or private key need to be present";
 					case ecdsa_error::invalid_key_size: return "invalid key size";
 					case ecdsa_error::invalid_key: return "invalid key";
+					case ecdsa_error::unknown_curve: return "unknown curve";
+					case ecdsa_error::set_ecdsa_failed: return "setting ECDSA key failed";
+					case ecdsa_error::create_context_failed: return "failed to create context";
+					case ecdsa_error::write_key_failed: return "error writing key data in PEM format";
 					default: return "unknown ECDSA error";
 					}
 				}
@@ -166,7 +184,9 @@ namespace jwt {
 			digestfinal_failed,
 			rsa_padding_failed,
 			rsa_private_encrypt_failed,
-			get_key_failed
+			get_key_failed,
+			duplicate_claim,
+			invalid_claim_json
 		};
 		/**
 		 * \brief Error category for signature generation errors
@@ -200,6 +220,10 @@ namespace jwt {
 						return "failed to create signature: RSA_private_encrypt failed";
 					case signature_generation_error::get_key_failed:
 						return "failed to generate signature: Could not get key";
+					case signature_generation_error::duplicate_claim:
+						return "failed to create token: claim was set more than once";
+					case signature_generation_error::invalid_claim_json:
+						return "failed to create token: claim value is not valid JSON";
 					default: return "unknown signature generation error";
 					}
 				}
@@ -222,7 +246,14 @@ namespace jwt {
 			claim_type_missmatch,
 			claim_value_missmatch,
 			token_expired,
-			audience_missmatch
+			audience_missmatch,
+			key_not_found,
+			invalid_token,
+			verification_rejected,
+			not_enough_signatures,
+			invalid_payload_encoding,
+			unsupported_critical_header,
+			token_revoked
 		};
 		/**
 		 * \brief Error category for token verification errors
@@ -243,6 +274,17 @@ namespace jwt {
 					case token_verification_error::token_expired: return "token expired";
 					case token_verification_error::audience_missmatch:
 						return "token doesn't contain the required audience";
+					case token_verification_error::key_not_found: return "no key matches the key id of the token";
+					case token_verification_error::invalid_token: return "token could not be decoded";
+					case token_verification_error::verification_rejected:
+						return "verification rejected, too many verifications in flight";
+					case token_verification_error::not_enough_signatures:
+						return "the token has fewer signatures than the signature policy requires";
+					case token_verification_error::invalid_payload_encoding:
+						return "the detached payload must be unencoded, with \"b64\" false and listed in \"crit\"";
+					case token_verification_error::unsupported_critical_header:
+						return "the token has a critical header parameter that is not understood";
+					case token_verification_error::token_revoked: return "token has been revoked";
 					default: return "unknown token verification error";
 					}
 				}
@@ -255,6 +297,97 @@ namespace jwt {
 			return {static_cast<int>(e), token_verification_error_category()};
 		}
 
+		/**
+		 * \brief Errors related to encrypting a token (JWE)
+		 */
+		enum class encryption_error {
+			ok = 0,
+			create_context_failed = 10,
+			random_failed,
+			invalid_key_size,
+			key_wrap_failed,
+			key_encrypt_failed,
+			key_agreement_failed,
+			encrypt_failed
+		};
+		/**
+		 * \brief Error category for encryption errors
+		 */
+		inline std::error_category& encryption_error_category() {
+			class encryption_error_cat : public std::error_category {
+			public:
+				const char* name() const noexcept override { return "encryption_error"; };
+				std::string message(int ev) const override {
+					switch (static_cast<encryption_error>(ev)) {
+					case encryption_error::ok: return "no error";
+					case encryption_error::create_context_failed: return "failed to encrypt: could not create context";
+					case encryption_error::random_failed: return "failed to encrypt: could not generate random bytes";
+					case encryption_error::invalid_key_size: return "failed to encrypt: key has the wrong size";
+					case encryption_error::key_wrap_failed: return "failed to encrypt: key wrap failed";
+					case encryption_error::key_encrypt_failed: return "failed to encrypt: key encryption failed";
+					case encryption_error::key_agreement_failed: return "failed to encrypt: key agreement failed";
+					case encryption_error::encrypt_failed: return "failed to encrypt content";
+					default: return "unknown encryption error";
+					}
+				}
+			};
+			static encryption_error_cat cat = {};
+			return cat;
+		}
+
+		inline std::error_code make_error_code(encryption_error e) {
+			return {static_cast<int>(e), encryption_error_category()};
+		}
+
+		/**
+		 * \brief Errors related to decrypting a token (JWE)
+		 */
+		enum class decryption_error {
+			ok = 0,
+			invalid_token = 10,
+			wrong_algorithm,
+			unsupported_compression,
+			create_context_failed,
+			invalid_key_size,
+			key_unwrap_failed,
+			key_agreement_failed,
+			invalid_tag,
+			decrypt_failed,
+			unsupported_critical_header
+		};
+		/**
+		 * \brief Error category for decryption errors
+		 */
+		inline std::error_category& decryption_error_category() {
+			class decryption_error_cat : public std::error_category {
+			public:
+				const char* name() const noexcept override { return "decryption_error"; };
+				std::string message(int ev) const override {
+					switch (static_cast<decryption_error>(ev)) {
+					case decryption_error::ok: return "no error";
+					case decryption_error::invalid_token: return "encrypted token could not be decoded";
+					case decryption_error::wrong_algorithm: return "wrong algorithm";
+					case decryption_error::unsupported_compression: return "compressed content is not supported";
+					case decryption_error::create_context_failed: return "failed to decrypt: could not create context";
+					case decryption_error::invalid_key_size: return "failed to decrypt: key has the wrong size";
+					case decryption_error::key_unwrap_failed: return "failed to decrypt: key unwrap failed";
+					case decryption_error::key_agreement_failed: return "failed to decrypt: key agreement failed";
+					case decryption_error::invalid_tag: return "authentication tag does not match";
+					case decryption_error::decrypt_failed: return "failed to decrypt content";
+					case decryption_error::unsupported_critical_header:
+						return "token lists a critical header that is not understood";
+					default: return "unknown decryption error";
+					}
+				}
+			};
+			static decryption_error_cat cat = {};
+			return cat;
+		}
+
+		inline std::error_code make_error_code(decryption_error e) {
+			return {static_cast<int>(e), decryption_error_category()};
+		}
+
 		inline void throw_if_error(std::error_code ec) {
 			if (ec) {
 				if (ec.category() == rsa_error_category()) throw rsa_exception(ec);
@@ -263,6 +396,8 @@ namespace jwt {
 					throw signature_verification_exception(ec);
 				if (ec.category() == signature_generation_error_category()) throw signature_generation_exception(ec);
 				if (ec.category() == token_verification_error_category()) throw token_verification_exception(ec);
+				if (ec.category() == encryption_error_category()) throw encryption_exception(ec);
+				if (ec.category() == decryption_error_category()) throw decryption_exception(ec);
 			}
 		}
 	} // namespace error
@@ -287,6 +422,10 @@ namespace std {
 	struct is_error_code_enum<jwt::error::signature_generation_error> : true_type {};
 	template<>
 	struct is_error_code_enum<jwt::error::token_verification_error> : true_type {};
+	template<>
+	struct is_error_code_enum<jwt::error::encryption_error> : true_type {};
+	template<>
+	struct is_error_code_enum<jwt::error::decryption_error> : true_type {};
 } // namespace std
 
 #endif
@@ -0,0 +1,340 @@
+#ifndef JWT_CPP_EXECUTOR_H
+#define JWT_CPP_EXECUTOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jwt {
+	/**
+	 * \brief Interface for running work on other threads
+	 *
+	 * Implement this to let jwt-cpp schedule work on an existing thread pool or event loop.
+	 */
+	class executor {
+	public:
+		virtual ~executor() = default;
+
+		/**
+		 * Schedule a task. Tasks may run on any thread and in any order.
+		 * \param task Task to run
+		 */
+		virtual void execute(std::function<void()> task) = 0;
+
+		/**
+		 * Schedule a task unless the executor is saturated.
+		 * \param task Task to run
+		 * \return false if the task was rejected and will not run
+		 */
+		virtual bool try_execute(std::function<void()> task) {
+			execute(std::move(task));
+			return true;
+		}
+	};
+
+	/**
+	 * \brief Fixed size thread pool with work stealing
+	 *
+	 * Every worker owns a queue. Tasks submitted from a worker are pushed to its own queue and picked up in LIFO
+	 * order, tasks submitted from other threads are distributed round robin. Idle workers steal the oldest task
+	 * from the queues of the other workers.
+	 */
+	class thread_pool : public executor {
+	public:
+		/**
+		 * Start a new pool
+		 * \param threads Number of worker threads, defaults to the number of hardware threads
+		 */
+		explicit thread_pool(size_t threads = 0) {
+			if (threads == 0) threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+			for (size_t i = 0; i < threads; i++)
+				queues.emplace_back(new worker_queue());
+			for (size_t i = 0; i < threads; i++)
+				workers.emplace_back([this, i]() { run(i); });
+		}
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		/**
+		 * Stop the pool. Tasks that were already submitted are run before the workers exit.
+		 */
+		~thread_pool() override {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wakeup.notify_all();
+			for (auto& w : workers)
+				w.join();
+		}
+
+		void execute(std::function<void()> task) override {
+			const auto self = current_worker();
+			const auto index = self != nullptr && self->pool == this ? self->index : next++ % queues.size();
+			{
+				std::lock_guard<std::mutex> lock(queues[index]->mutex);
+				queues[index]->tasks.push_back(std::move(task));
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				pending++;
+			}
+			wakeup.notify_one();
+		}
+
+		/**
+		 * Get the number of worker threads
+		 * \return Number of workers
+		 */
+		size_t size() const noexcept { return workers.size(); }
+
+		/**
+		 * Get a process wide pool sized to the number of hardware threads, started on first use
+		 * \return Shared pool
+		 */
+		static thread_pool& get_default() {
+			static thread_pool pool;
+			return pool;
+		}
+
+	private:
+		struct worker_queue {
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+		struct worker_info {
+			const thread_pool* pool;
+			size_t index;
+		};
+
+		std::vector<std::unique_ptr<worker_queue>> queues;
+		std::vector<std::thread> workers;
+		std::atomic<size_t> next{0};
+		std::mutex mutex;
+		std::condition_variable wakeup;
+		size_t pending{0};
+		bool stopping{false};
+
+		static worker_info*& current_worker() {
+			static thread_local worker_info* info = nullptr;
+			return info;
+		}
+
+		bool try_pop(size_t index, std::function<void()>& task) {
+			// Own queue from the back, then steal from the front of the others
+			for (size_t i = 0; i < queues.size(); i++) {
+				auto& q = *queues[(index + i) % queues.size()];
+				std::lock_guard<std::mutex> lock(q.mutex);
+				if (q.tasks.empty()) continue;
+				if (i == 0) {
+					task = std::move(q.tasks.back());
+					q.tasks.pop_back();
+				} else {
+					task = std::move(q.tasks.front());
+					q.tasks.pop_front();
+				}
+				return true;
+			}
+			return false;
+		}
+
+		void run(size_t index) {
+			worker_info info{this, index};
+			current_worker() = &info;
+			while (true) {
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wakeup.wait(lock, [this]() { return pending != 0 || stopping; });
+					if (pending == 0) return;
+					pending--;
+				}
+				std::function<void()> task;
+				// A task is queued for every pending count, it may just not be visible in the queue we look at
+				while (!try_pop(index, task))
+					std::this_thread::yield();
+				// An escaping exception would terminate the process, tasks must report failures themselves
+				try {
+					task();
+				} catch (...) {}
+			}
+		}
+	};
+
+	/**
+	 * \brief Executor limiting the number of tasks running at once
+	 *
+	 * At most `max_in_flight` tasks are handed to the underlying executor at a time, further tasks wait in a
+	 * local queue. `try_execute` rejects tasks once `max_queued` tasks are waiting, which lets callers shed load
+	 * instead of building up latency; `execute` always queues.
+	 */
+	class bounded_executor : public executor {
+	public:
+		/**
+		 * Limit tasks run on an existing executor
+		 * \param inner Executor running the tasks, must outlive this instance
+		 * \param max_in_flight Maximum number of tasks handed to `inner` at once
+		 * \param max_queued Maximum number of tasks waiting before `try_execute` rejects new ones
+		 */
+		bounded_executor(executor& inner, size_t max_in_flight, size_t max_queued = 0)
+			: inner(inner), max_in_flight(std::max<size_t>(1, max_in_flight)), max_queued(max_queued) {}
+		/**
+		 * Run tasks on an own thread pool
+		 * \param threads Number of worker threads
+		 * \param max_in_flight Maximum number of tasks running or waiting in the pool at once
+		 * \param max_queued Maximum number of tasks waiting before `try_execute` rejects new ones
+		 */
+		bounded_executor(size_t threads, size_t max_in_flight, size_t max_queued = 0)
+			: owned_pool(new thread_pool(threads)), inner(*owned_pool),
+			  max_in_flight(std::max<size_t>(1, max_in_flight)), max_queued(max_queued) {}
+		bounded_executor(const bounded_executor&) = delete;
+		bounded_executor& operator=(const bounded_executor&) = delete;
+
+		/**
+		 * Wait for all accepted tasks to finish
+		 */
+		~bounded_executor() override {
+			std::unique_lock<std::mutex> lock(mutex);
+			idle.wait(lock, [this]() { return running == 0; });
+		}
+
+		void execute(std::function<void()> task) override { submit(std::move(task), false); }
+
+		bool try_execute(std::function<void()> task) override { return submit(std::move(task), true); }
+
+		/**
+		 * Get the number of tasks handed to the underlying executor
+		 * \return Tasks in flight
+		 */
+		size_t in_flight() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return running;
+		}
+
+		/**
+		 * Get the number of tasks waiting for a free slot
+		 * \return Queued tasks
+		 */
+		size_t queued() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return waiting.size();
+		}
+
+	private:
+		std::unique_ptr<thread_pool> owned_pool;
+		executor& inner;
+		const size_t max_in_flight;
+		const size_t max_queued;
+		mutable std::mutex mutex;
+		std::condition_variable idle;
+		std::deque<std::function<void()>> waiting;
+		size_t running{0};
+
+		bool submit(std::function<void()> task, bool bounded) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (running >= max_in_flight) {
+					if (bounded && waiting.size() >= max_queued) return false;
+					waiting.push_back(std::move(task));
+					return true;
+				}
+				running++;
+			}
+			forward(std::move(task));
+			return true;
+		}
+
+		void forward(std::function<void()> task) {
+			auto t = std::make_shared<std::function<void()>>(std::move(task));
+			inner.execute([this, t]() {
+				try {
+					(*t)();
+				} catch (...) {}
+				std::function<void()> next;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (waiting.empty()) {
+						if (--running == 0) idle.notify_all();
+						return;
+					}
+					next = std::move(waiting.front());
+					waiting.pop_front();
+				}
+				forward(std::move(next));
+			});
+		}
+	};
+
+	namespace details {
+		/// Number of items of a batch handed to a thread at once
+		constexpr size_t batch_chunk_size = 16;
+
+		/**
+		 * Get the number of helper tasks worth scheduling for a batch on an executor
+		 * \param exec Executor the batch runs on
+		 * \return Size of the pool, or the number of hardware threads for other executors
+		 */
+		inline size_t batch_helpers(executor& exec) {
+			const auto* pool = dynamic_cast<thread_pool*>(&exec);
+			return pool != nullptr ? pool->size() : std::max<size_t>(1, std::thread::hardware_concurrency());
+		}
+
+		/**
+		 * \brief Run `fn(begin, end)` over chunks of `[0, count)` on an executor and wait for completion
+		 *
+		 * The calling thread takes chunks as well, so this makes progress even if every thread of the executor
+		 * is busy or the caller itself runs on it. The first exception thrown by `fn` is rethrown to the caller.
+		 */
+		template<typename Fn>
+		void parallel_for(executor& exec, size_t count, size_t chunk_size, size_t helpers, Fn fn) {
+			if (count == 0) return;
+			chunk_size = std::max<size_t>(1, chunk_size);
+			struct state_t {
+				std::atomic<size_t> next{0};
+				size_t chunks{0};
+				size_t done{0};
+				std::exception_ptr error;
+				std::mutex mutex;
+				std::condition_variable finished;
+			};
+			auto state = std::make_shared<state_t>();
+			state->chunks = (count + chunk_size - 1) / chunk_size;
+
+			auto work = [state, count, chunk_size, &fn]() {
+				size_t completed = 0;
+				std::exception_ptr error;
+				for (auto chunk = state->next++; chunk < state->chunks; chunk = state->next++) {
+					try {
+						fn(chunk * chunk_size, std::min(count, (chunk + 1) * chunk_size));
+					} catch (...) {
+						if (!error) error = std::current_exception();
+					}
+					completed++;
+				}
+				if (completed == 0) return;
+				std::lock_guard<std::mutex> lock(state->mutex);
+				if (error && !state->error) state->error = error;
+				state->done += completed;
+				if (state->done == state->chunks) state->finished.notify_all();
+			};
+
+			// Helpers only touch fn while they own a chunk, which the caller waits for below
+			helpers = std::min(helpers, state->chunks - 1);
+			for (size_t i = 0; i < helpers; i++)
+				exec.execute(work);
+			work();
+
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->finished.wait(lock, [&state]() { return state->done == state->chunks; });
+			if (state->error) std::rethrow_exception(state->error);
+		}
+	} // namespace details
+} // namespace jwt
+
+#endif
@@ -13,14 +13,23 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <chrono>
 #include <codecvt>
+#include <condition_variable>
 #include <functional>
+#include <future>
+#include <istream>
 #include <iterator>
 #include <locale>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <random>
 #include <set>
 #include <system_error>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
 #include <utility>
@@ -28,6 +37,9 @@
 
 #include "error.h"
 #include "crypto.h"
+#include "executor.h"
+#include "metrics.h"
+#include "revocation.h"
 
 #if __cplusplus >= 201402L
 #ifdef __has_include
@@ -37,6 +49,13 @@
 #endif
 #endif
 
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define JWT_HAS_COROUTINES
+#endif
+#endif
+
 #ifndef JWT_CLAIM_EXPLICIT
 #define JWT_CLAIM_EXPLICIT explicit
 #endif
@@ -222,6 +241,80 @@ namespace jwt {
 										  is_as_boolean_signature<traits_type, value_type, boolean_type>::value;
 		};
 
+		template<typename traits_type>
+		using equals_function = decltype(traits_type::equals);
+
+		// Uses is_detected_t so that traits without the optional function do not fail to compile
+		template<typename traits_type, typename value_type>
+		using is_equals_signature = typename std::is_same<is_detected_t<equals_function, traits_type>,
+														  bool(const value_type&, const value_type&)>;
+
+		/**
+		 * Optional `bool equals(const value_type&, const value_type&)` comparing two values structurally.
+		 * When missing, arrays and objects are compared by their serialization.
+		 */
+		template<typename traits_type, typename value_type>
+		struct supports_equals {
+			static constexpr auto value = is_detected<equals_function, traits_type>::value &&
+										  std::is_function<is_detected_t<equals_function, traits_type>>::value &&
+										  is_equals_signature<traits_type, value_type>::value;
+		};
+
+		template<typename traits_type>
+		using as_string_ref_function = decltype(traits_type::as_string_ref);
+		template<typename traits_type>
+		using as_array_ref_function = decltype(traits_type::as_array_ref);
+
+		/**
+		 * Optional `const string_type& as_string_ref(const value_type&)` and
+		 * `const array_type& as_array_ref(const value_type&)` giving access to a value without copying it.
+		 * When missing, string_ref() and array_ref() copy the value into the storage passed to them.
+		 */
+		template<typename traits_type>
+		struct supports_ref_access {
+			static constexpr auto value = is_detected<as_string_ref_function, traits_type>::value &&
+										  is_detected<as_array_ref_function, traits_type>::value;
+		};
+
+		template<typename json_traits>
+		const typename json_traits::string_type& string_ref(const typename json_traits::value_type& val,
+															 typename json_traits::string_type&, std::true_type) {
+			return json_traits::as_string_ref(val);
+		}
+		template<typename json_traits>
+		const typename json_traits::string_type& string_ref(const typename json_traits::value_type& val,
+															 typename json_traits::string_type& storage,
+															 std::false_type) {
+			storage = json_traits::as_string(val);
+			return storage;
+		}
+		/// The string in val, `storage` holds the copy if json_traits has no `as_string_ref`
+		template<typename json_traits>
+		const typename json_traits::string_type& string_ref(const typename json_traits::value_type& val,
+															 typename json_traits::string_type& storage) {
+			return string_ref<json_traits>(
+				val, storage, std::integral_constant<bool, supports_ref_access<json_traits>::value>{});
+		}
+
+		template<typename json_traits>
+		const typename json_traits::array_type& array_ref(const typename json_traits::value_type& val,
+														   typename json_traits::array_type&, std::true_type) {
+			return json_traits::as_array_ref(val);
+		}
+		template<typename json_traits>
+		const typename json_traits::array_type& array_ref(const typename json_traits::value_type& val,
+														   typename json_traits::array_type& storage, std::false_type) {
+			storage = json_traits::as_array(val);
+			return storage;
+		}
+		/// The array in val, `storage` holds the copy if json_traits has no `as_array_ref`
+		template<typename json_traits>
+		const typename json_traits::array_type& array_ref(const typename json_traits::value_type& val,
+														   typename json_traits::array_type& storage) {
+			return array_ref<json_traits>(val, storage,
+										  std::integral_constant<bool, supports_ref_access<json_traits>::value>{});
+		}
+
 		template<typename traits>
 		struct is_valid_traits {
 			// Internal assertions for better feedback
@@ -556,6 +649,17 @@ namespace jwt {
 				return basic_claim_t{claims.at(name)};
 			}
 
+			/**
+			 * Look up a claim without copying it
+			 *
+			 * \param name the name of the desired claim
+			 * \return Pointer to the JSON value of the claim or nullptr if the claim was not present
+			 */
+			const typename json_traits::value_type* find_claim(const typename json_traits::string_type& name) const {
+				if (!has_claim(name)) return nullptr;
+				return &claims.at(name);
+			}
+
 			std::unordered_map<typename json_traits::string_type, basic_claim_t> get_claims() const {
 				static_assert(
 					details::is_valid_json_object<typename json_traits::value_type, typename json_traits::string_type,
@@ -573,6 +677,98 @@ namespace jwt {
 		};
 	} // namespace details
 
+	/**
+	 * \brief Stages reported to a stage observer
+	 */
+	enum class stage {
+		/// Splitting the token into its three parts
+		split,
+		/// Base64url decoding of the token parts
+		base64_decode,
+		/// Parsing the JSON of the header
+		header_parse,
+		/// Parsing the JSON of the payload
+		payload_parse,
+		/// Creating or checking the signature
+		signature,
+		/// Checking a single claim, see stage_event::claim
+		claim,
+		/// Serializing and base64url encoding header and payload while signing
+		encode
+	};
+
+	/**
+	 * \brief Event passed to a stage observer
+	 */
+	struct stage_event {
+		/// Stage that started or ended
+		jwt::stage stage;
+		/// Algorithm of the token, empty before the header was parsed
+		std::string algorithm;
+		/// Name of the checked claim for stage::claim
+		std::string claim;
+		/// Size of the encoded token, or of the signed data while signing
+		size_t token_size;
+		/// Result of the stage, only set for end events. Exceptions are reported as invalid_token
+		std::error_code outcome;
+	};
+
+	/**
+	 * \brief Observer receiving no events, used when instrumentation is disabled
+	 *
+	 * An observer is any type with a `static constexpr bool enabled` and `on_stage_begin(const stage_event&)` and
+	 * `on_stage_end(const stage_event&)` members. When `enabled` is false no event is created and no call is made,
+	 * so the instrumentation compiles to nothing. Observers may be called from several threads at once.
+	 */
+	struct null_stage_observer {
+		static constexpr bool enabled = false;
+		void on_stage_begin(const stage_event&) {}
+		void on_stage_end(const stage_event&) {}
+	};
+
+	namespace details {
+		template<typename Observer, bool Enabled = Observer::enabled>
+		class stage_scope {
+		public:
+			stage_scope(Observer* observer, jwt::stage s, const std::string& alg, size_t size,
+						const std::string* claim = nullptr)
+				: observer(observer), event{s, alg, claim != nullptr ? *claim : std::string{}, size, {}} {
+				if (observer != nullptr) observer->on_stage_begin(event);
+			}
+			stage_scope(const stage_scope&) = delete;
+			stage_scope& operator=(const stage_scope&) = delete;
+			~stage_scope() {
+				if (!ended) end(error::token_verification_error::invalid_token);
+			}
+
+			void end(std::error_code ec = {}) {
+				ended = true;
+				event.outcome = ec;
+				if (observer != nullptr) observer->on_stage_end(event);
+			}
+
+		private:
+			Observer* observer;
+			stage_event event;
+			bool ended{false};
+		};
+
+		template<typename Observer>
+		class stage_scope<Observer, false> {
+		public:
+			stage_scope(Observer*, jwt::stage, const std::string&, size_t, const std::string* = nullptr) {}
+			void end(std::error_code = {}) {}
+		};
+
+		template<typename T>
+		using stage_observer_enabled = decltype(T::enabled);
+
+		template<typename T>
+		struct is_stage_observer {
+			static constexpr auto value = is_detected<stage_observer_enabled, T>::value;
+		};
+	} // namespace details
+
 	/**
 	 * Base class that represents a token payload.
 	 * Contains Convenience accessors for common claims.
@@ -689,6 +885,14 @@ namespace jwt {
 		basic_claim_t get_payload_claim(const typename json_traits::string_type& name) const {
 			return payload_claims.get_claim(name);
 		}
+		/**
+		 * Look up a payload claim without copying it
+		 * \return Pointer to the JSON value of the claim or nullptr if the claim was not present
+		 */
+		const typename json_traits::value_type*
+		find_payload_claim(const typename json_traits::string_type& name) const {
+			return payload_claims.find_claim(name);
+		}
 	};
 
 	/**
@@ -765,6 +969,13 @@ namespace jwt {
 		basic_claim_t get_header_claim(const typename json_traits::string_type& name) const {
 			return header_claims.get_claim(name);
 		}
+		/**
+		 * Look up a header claim without copying it
+		 * \return Pointer to the JSON value of the claim or nullptr if the claim was not present
+		 */
+		const typename json_traits::value_type* find_header_claim(const typename json_traits::string_type& name) const {
+			return header_claims.find_claim(name);
+		}
 	};
 
 	/**
@@ -788,6 +999,14 @@ namespace jwt {
 		/// Unmodified signature part in base64
 		typename json_traits::string_type signature_base64;
 
+		/// Tag selecting the constructor that leaves decoding the parts to a derived class
+		struct defer_decoding {};
+		/**
+		 * \brief Store the token, the derived class fills in the parts and claims
+		 * \param token The token as passed to the derived class
+		 */
+		decoded_jwt(const typename json_traits::string_type& token, defer_decoding) : token(token) {}
+
 	public:
 		using basic_claim_t = basic_claim<json_traits>;
 #ifndef JWT_DISABLE_BASE64
@@ -816,22 +1035,76 @@ namespace jwt {
 		 * \throw std::invalid_argument Token is not in correct format
 		 * \throw std::runtime_error Base64 decoding failed or invalid json
 		 */
-		template<typename Decode>
-		decoded_jwt(const typename json_traits::string_type& token, Decode decode) : token(token) {
-			auto hdr_end = token.find('.');
-			if (hdr_end == json_traits::string_type::npos) throw std::invalid_argument("invalid token supplied");
-			auto payload_end = token.find('.', hdr_end + 1);
-			if (payload_end == json_traits::string_type::npos) throw std::invalid_argument("invalid token supplied");
-			header_base64 = token.substr(0, hdr_end);
-			payload_base64 = token.substr(hdr_end + 1, payload_end - hdr_end - 1);
-			signature_base64 = token.substr(payload_end + 1);
-
-			header = decode(header_base64);
-			payload = decode(payload_base64);
-			signature = decode(signature_base64);
-
-			this->header_claims = details::map_of_claims<json_traits>::parse_claims(header);
-			this->payload_claims = details::map_of_claims<json_traits>::parse_claims(payload);
+		template<typename Decode,
+				 typename std::enable_if<!details::is_stage_observer<Decode>::value, int>::type = 0>
+		decoded_jwt(const typename json_traits::string_type& token, Decode decode)
+			: decoded_jwt(token, decode, static_cast<null_stage_observer*>(nullptr)) {}
+#ifndef JWT_DISABLE_BASE64
+		/**
+		 * \brief Parses a given token and reports the time spent in each stage
+		 *
+		 * \param token The token to parse
+		 * \param observer Observer receiving stage events, see null_stage_observer
+		 * \throw std::invalid_argument Token is not in correct format
+		 * \throw std::runtime_error Base64 decoding failed or invalid json
+		 */
+		template<typename Observer,
+				 typename std::enable_if<details::is_stage_observer<Observer>::value, int>::type = 0>
+		decoded_jwt(const typename json_traits::string_type& token, Observer& observer)
+			: decoded_jwt(
+				  token,
+				  [](const typename json_traits::string_type& token) {
+					  return base::decode<alphabet::base64url>(base::pad<alphabet::base64url>(token));
+				  },
+				  &observer) {}
+#endif
+		/**
+		 * \brief Parses a given token and reports the time spent in each stage
+		 *
+		 * \param token The token to parse
+		 * \param decode The function to decode the token
+		 * \param observer Observer receiving stage events, may be nullptr
+		 * \throw std::invalid_argument Token is not in correct format
+		 * \throw std::runtime_error Base64 decoding failed or invalid json
+		 */
+		template<typename Decode, typename Observer>
+		decoded_jwt(const typename json_traits::string_type& token, Decode decode, Observer* observer)
+			: token(token) {
+			const std::string unknown_alg;
+			{
+				details::stage_scope<Observer> scope(observer, stage::split, unknown_alg, token.size());
+				auto hdr_end = token.find('.');
+				if (hdr_end == json_traits::string_type::npos) throw std::invalid_argument("invalid token supplied");
+				auto payload_end = token.find('.', hdr_end + 1);
+				if (payload_end == json_traits::string_type::npos)
+					throw std::invalid_argument("invalid token supplied");
+				header_base64 = token.substr(0, hdr_end);
+				payload_base64 = token.substr(hdr_end + 1, payload_end - hdr_end - 1);
+				signature_base64 = token.substr(payload_end + 1);
+				scope.end();
+			}
+			{
+				details::stage_scope<Observer> scope(observer, stage::base64_decode, unknown_alg, token.size());
+				header = decode(header_base64);
+				payload = decode(payload_base64);
+				signature = decode(signature_base64);
+				scope.end();
+			}
+			{
+				details::stage_scope<Observer> scope(observer, stage::header_parse, unknown_alg, token.size());
+				this->header_claims = details::map_of_claims<json_traits>::parse_claims(header);
+				scope.end();
+			}
+			{
+				// A malformed "alg" is left to the verifier, decoding must not depend on the observer
+				std::string alg;
+				const auto* alg_claim = Observer::enabled ? this->find_header_claim("alg") : nullptr;
+				if (alg_claim != nullptr && json_traits::get_type(*alg_claim) == json::type::string)
+					alg = json_traits::as_string(*alg_claim);
+				details::stage_scope<Observer> scope(observer, stage::payload_parse, alg, token.size());
+				this->payload_claims = details::map_of_claims<json_traits>::parse_claims(payload);
+				scope.end();
+			}
 		}
 
 		/**
@@ -885,246 +1158,2560 @@ namespace jwt {
 		}
 	};
 
+#if !defined(JWT_DISABLE_BASE64) && defined(JWT_OPENSSL_CRYPTO)
 	/**
-	 * Builder class to build and sign a new token
-	 * Use jwt::create() to get an instance of this class.
+	 * \brief Class containing an encrypted token (JWE) in compact serialization
+	 *
+	 * The header, encrypted key, initialization vector and authentication tag are decoded on construction. The
+	 * ciphertext is only decoded by decrypt(), straight from the token into the buffer that is decrypted in place
+	 * and returned as plaintext.
 	 */
 	template<typename json_traits>
-	class builder {
-		typename json_traits::object_type header_claims;
-		typename json_traits::object_type payload_claims;
+	class decoded_jwe : public header<json_traits> {
+	protected:
+		/// Unmodifed token, as passed to constructor
+		const typename json_traits::string_type token;
+		/// Header part decoded from base64
+		typename json_traits::string_type header;
+		/// Unmodified header part in base64, the additional authenticated data
+		typename json_traits::string_type header_base64;
+		/// Encrypted key part decoded from base64
+		typename json_traits::string_type encrypted_key;
+		/// Initialization vector part decoded from base64
+		typename json_traits::string_type iv;
+		/// Authentication tag part decoded from base64
+		typename json_traits::string_type tag;
+		/// Position of the base64 ciphertext part in the token
+		size_t ciphertext_offset;
+		/// Length of the base64 ciphertext part
+		size_t ciphertext_length;
 
 	public:
-		builder() = default;
+		using basic_claim_t = basic_claim<json_traits>;
 		/**
-		 * Set a header claim.
-		 * \param id Name of the claim
-		 * \param c Claim to add
-		 * \return *this to allow for method chaining
+		 * \brief Parses a given token
+		 *
+		 * \param token The token to parse
+		 * \throw std::invalid_argument Token is not in correct format
+		 * \throw std::runtime_error Base64 decoding failed or invalid json
 		 */
-		builder& set_header_claim(const typename json_traits::string_type& id, typename json_traits::value_type c) {
-			header_claims[id] = std::move(c);
-			return *this;
+		JWT_CLAIM_EXPLICIT decoded_jwe(const typename json_traits::string_type& token) : token(token) {
+			size_t ends[4];
+			size_t start = 0;
+			for (auto& end : ends) {
+				end = token.find('.', start);
+				if (end == json_traits::string_type::npos) throw std::invalid_argument("invalid token supplied");
+				start = end + 1;
+			}
+			if (token.find('.', start) != json_traits::string_type::npos)
+				throw std::invalid_argument("invalid token supplied");
+
+			const auto decode = [&token](size_t begin, size_t end, typename json_traits::string_type& out) {
+				base::decode_unpadded<alphabet::base64url>(token.data() + begin, end - begin, out);
+			};
+			header_base64 = token.substr(0, ends[0]);
+			decode(0, ends[0], header);
+			decode(ends[0] + 1, ends[1], encrypted_key);
+			decode(ends[1] + 1, ends[2], iv);
+			decode(ends[3] + 1, token.size(), tag);
+			ciphertext_offset = ends[2] + 1;
+			ciphertext_length = ends[3] - ciphertext_offset;
+			this->header_claims = details::map_of_claims<json_traits>::parse_claims(header);
 		}
 
 		/**
-		 * Set a header claim.
-		 * \param id Name of the claim
-		 * \param c Claim to add
-		 * \return *this to allow for method chaining
+		 * Get token string, as passed to constructor
+		 * \return token as passed to constructor
 		 */
-		builder& set_header_claim(const typename json_traits::string_type& id, basic_claim<json_traits> c) {
-			header_claims[id] = c.to_json();
-			return *this;
-		}
+		const typename json_traits::string_type& get_token() const noexcept { return token; }
 		/**
-		 * Set a payload claim.
-		 * \param id Name of the claim
-		 * \param c Claim to add
-		 * \return *this to allow for method chaining
+		 * Get header part as json string
+		 * \return header part after base64 decoding
 		 */
-		builder& set_payload_claim(const typename json_traits::string_type& id, typename json_traits::value_type c) {
-			payload_claims[id] = std::move(c);
-			return *this;
-		}
+		const typename json_traits::string_type& get_header() const noexcept { return header; }
 		/**
-		 * Set a payload claim.
-		 * \param id Name of the claim
-		 * \param c Claim to add
-		 * \return *this to allow for method chaining
+		 * Get header part as base64 string
+		 * \return header part before base64 decoding
 		 */
-		builder& set_payload_claim(const typename json_traits::string_type& id, basic_claim<json_traits> c) {
-			payload_claims[id] = c.to_json();
-			return *this;
-		}
+		const typename json_traits::string_type& get_header_base64() const noexcept { return header_base64; }
 		/**
-		 * \brief Set algorithm claim
-		 * You normally don't need to do this, as the algorithm is automatically set if you don't change it.
-		 *
-		 * \param str Name of algorithm
-		 * \return *this to allow for method chaining
+		 * Get encrypted key part
+		 * \return encrypted key after base64 decoding, empty for "dir" and "ECDH-ES"
 		 */
-		builder& set_algorithm(typename json_traits::string_type str) {
-			return set_header_claim("alg", typename json_traits::value_type(str));
-		}
+		const typename json_traits::string_type& get_encrypted_key() const noexcept { return encrypted_key; }
 		/**
-		 * Set type claim
-		 * \param str Type to set
-		 * \return *this to allow for method chaining
+		 * Get initialization vector part
+		 * \return initialization vector after base64 decoding
 		 */
-		builder& set_type(typename json_traits::string_type str) {
-			return set_header_claim("typ", typename json_traits::value_type(str));
-		}
+		const typename json_traits::string_type& get_iv() const noexcept { return iv; }
 		/**
-		 * Set content type claim
-		 * \param str Type to set
-		 * \return *this to allow for method chaining
+		 * Get authentication tag part
+		 * \return authentication tag after base64 decoding
 		 */
-		builder& set_content_type(typename json_traits::string_type str) {
-			return set_header_claim("cty", typename json_traits::value_type(str));
-		}
+		const typename json_traits::string_type& get_tag() const noexcept { return tag; }
 		/**
-		 * \brief Set key id claim
-		 *
-		 * \param str Key id to set
-		 * \return *this to allow for method chaining
+		 * Get encryption algorithm claim ("enc")
+		 * \return content encryption algorithm as string
+		 * \throw std::runtime_error If claim was not present
+		 * \throw std::bad_cast Claim was present but not a string (Should not happen in a valid token)
 		 */
-		builder& set_key_id(typename json_traits::string_type str) {
-			return set_header_claim("kid", typename json_traits::value_type(str));
+		typename json_traits::string_type get_encryption_algorithm() const {
+			return this->get_header_claim("enc").as_string();
 		}
 		/**
-		 * Set issuer claim
-		 * \param str Issuer to set
-		 * \return *this to allow for method chaining
+		 * Get all header claims
+		 * \return map of claims
 		 */
-		builder& set_issuer(typename json_traits::string_type str) {
-			return set_payload_claim("iss", typename json_traits::value_type(str));
+		std::unordered_map<typename json_traits::string_type, basic_claim_t> get_header_claims() const {
+			return this->header_claims.get_claims();
 		}
+
 		/**
-		 * Set subject claim
-		 * \param str Subject to set
-		 * \return *this to allow for method chaining
+		 * Decrypt the token
+		 *
+		 * \param key_algo Key management algorithm, must match the 'alg' header
+		 * \param enc_algo Content encryption algorithm, must match the 'enc' header
+		 * \return Plaintext, pass it to jwt::decode() for a nested JWT
+		 * \throw decryption_exception on error
 		 */
-		builder& set_subject(typename json_traits::string_type str) {
-			return set_payload_claim("sub", typename json_traits::value_type(str));
+		template<typename KeyAlgo, typename EncAlgo>
+		typename json_traits::string_type decrypt(const KeyAlgo& key_algo, const EncAlgo& enc_algo) const {
+			std::error_code ec;
+			auto res = decrypt(key_algo, enc_algo, ec);
+			error::throw_if_error(ec);
+			return res;
 		}
+
 		/**
-		 * Set audience claim
-		 * \param a Audience set
-		 * \return *this to allow for method chaining
+		 * Decrypt the token
+		 *
+		 * The token is left untouched, so decrypting can be retried, e.g. with another key. No header extension
+		 * is understood, so tokens with a "crit" header fail with decryption_error::unsupported_critical_header
+		 * (RFC 7516 section 4.1.13).
+		 *
+		 * \param key_algo Key management algorithm, must match the 'alg' header
+		 * \param enc_algo Content encryption algorithm, must match the 'enc' header
+		 * \param ec error_code filled with details on error
+		 * \return Plaintext, pass it to jwt::decode() for a nested JWT
 		 */
-		builder& set_audience(typename json_traits::array_type a) {
-			return set_payload_claim("aud", typename json_traits::value_type(a));
+		template<typename KeyAlgo, typename EncAlgo>
+		typename json_traits::string_type decrypt(const KeyAlgo& key_algo, const EncAlgo& enc_algo,
+												  std::error_code& ec) const {
+			ec.clear();
+			if (!header_equals("alg", key_algo.name()) || !header_equals("enc", enc_algo.name())) {
+				ec = error::decryption_error::wrong_algorithm;
+				return {};
+			}
+			if (this->has_header_claim("zip")) {
+				ec = error::decryption_error::unsupported_compression;
+				return {};
+			}
+			if (this->has_header_claim("crit")) {
+				ec = error::decryption_error::unsupported_critical_header;
+				return {};
+			}
+			crypto::algorithm::key_agreement_parameters params;
+			if (!read_key_agreement(params)) {
+				ec = error::decryption_error::invalid_token;
+				return {};
+			}
+			const auto cek = key_algo.decrypt_key(enc_algo.name(), enc_algo.key_size(), encrypted_key, params, ec);
+			if (ec) return {};
+
+			std::string content;
+			try {
+				base::decode_unpadded<alphabet::base64url>(token.data() + ciphertext_offset, ciphertext_length,
+														   content);
+			} catch (const std::runtime_error&) {
+				ec = error::decryption_error::invalid_token;
+				return {};
+			}
+			enc_algo.decrypt(cek, iv, header_base64, content, tag, ec);
+			if (ec) return {};
+			return content;
+		}
+
+	private:
+		bool header_equals(const typename json_traits::string_type& name,
+						   const typename json_traits::string_type& expected) const {
+			const auto* value = this->find_header_claim(name);
+			return value != nullptr && json_traits::get_type(*value) == json::type::string &&
+				   json_traits::as_string(*value) == expected;
+		}
+
+		static bool decode_member(const typename json_traits::value_type& value, std::string& out) {
+			if (json_traits::get_type(value) != json::type::string) return false;
+			const auto str = json_traits::as_string(value);
+			try {
+				base::decode_unpadded<alphabet::base64url>(str.data(), str.size(), out);
+			} catch (const std::runtime_error&) { return false; }
+			return true;
+		}
+
+		// Read "epk", "apu" and "apv", absent members are left empty
+		bool read_key_agreement(crypto::algorithm::key_agreement_parameters& params) const {
+			const auto* apu = this->find_header_claim("apu");
+			const auto* apv = this->find_header_claim("apv");
+			if ((apu != nullptr && !decode_member(*apu, params.party_u_info)) ||
+				(apv != nullptr && !decode_member(*apv, params.party_v_info)))
+				return false;
+			const auto* epk = this->find_header_claim("epk");
+			if (epk == nullptr) return true;
+			if (json_traits::get_type(*epk) != json::type::object) return false;
+			const auto key = json_traits::as_object(*epk);
+			for (const auto* member : {"kty", "crv", "x", "y"})
+				if (key.count(member) == 0 || json_traits::get_type(key.at(member)) != json::type::string)
+					return false;
+			if (json_traits::as_string(key.at("kty")) != "EC") return false;
+			params.curve = json_traits::as_string(key.at("crv"));
+			return decode_member(key.at("x"), params.x) && decode_member(key.at("y"), params.y);
 		}
+	};
+#endif
+
+	namespace details {
+		/// Receives one chunk of streamed data, returns false if absorbing it failed
+		using chunk_sink = std::function<bool(const char*, size_t)>;
+		/// Passes every chunk of streamed data to a sink, returns false if reading the data or the sink failed
+		using chunk_source = std::function<bool(const chunk_sink&)>;
+
+		/// Size of the chunks read from a stream holding a detached payload
+		constexpr size_t stream_chunk_size = 16 * 1024;
+
 		/**
-		 * Set audience claim
-		 * \param aud Single audience
-		 * \return *this to allow for method chaining
+		 * Create a source reading a stream to its end in chunks of stream_chunk_size
+		 * \param in Stream to read, must outlive the source
 		 */
-		builder& set_audience(typename json_traits::string_type aud) {
-			return set_payload_claim("aud", typename json_traits::value_type(aud));
+		inline chunk_source read_stream(std::istream& in) {
+			return [&in](const chunk_sink& sink) {
+				std::string buffer(stream_chunk_size, '\0');
+				while (in) {
+					in.read(&buffer[0], static_cast<std::streamsize>(buffer.size()));
+					const auto count = static_cast<size_t>(in.gcount());
+					if (count != 0 && !sink(buffer.data(), count)) return false;
+				}
+				return !in.bad();
+			};
 		}
+
 		/**
-		 * Set expires at claim
-		 * \param d Expires time
-		 * \return *this to allow for method chaining
+		 * Create a source passing on a range of chunks, each providing `data()` and `size()`
+		 * \param begin Iterator to the first chunk
+		 * \param end Iterator past the last chunk
 		 */
-		builder& set_expires_at(const date& d) { return set_payload_claim("exp", basic_claim<json_traits>(d)); }
-		/**
+		template<typename ChunkIt>
+		chunk_source read_chunks(ChunkIt begin, ChunkIt end) {
+			return [begin, end](const chunk_sink& sink) {
+				for (auto it = begin; it != end; ++it)
+					if (!sink(it->data(), it->size())) return false;
+				return true;
+			};
+		}
+
+		template<typename T>
+		using sign_stream_t =
+			decltype(std::declval<const T&>().sign_stream(std::declval<const chunk_source&>(),
+														  std::declval<std::error_code&>()));
+		template<typename T>
+		using verify_stream_t = decltype(std::declval<const T&>().verify_stream(
+			std::declval<const chunk_source&>(), std::declval<const std::string&>(), std::declval<std::error_code&>()));
+
+		// Collect streamed data into one string, for algorithms that can not hash it incrementally (e.g. EdDSA)
+		inline bool collect(const chunk_source& source, std::string& data) {
+			return source([&data](const char* ptr, size_t size) {
+				data.append(ptr, size);
+				return true;
+			});
+		}
+
+		template<typename Algo>
+		std::string sign_stream(const Algo& algo, const chunk_source& source, std::error_code& ec, std::true_type) {
+			return algo.sign_stream(source, ec);
+		}
+		template<typename Algo>
+		std::string sign_stream(const Algo& algo, const chunk_source& source, std::error_code& ec, std::false_type) {
+			std::string data;
+			if (!collect(source, data)) {
+				ec = error::signature_generation_error::signupdate_failed;
+				return {};
+			}
+			return algo.sign(data, ec);
+		}
+		/**
+		 * Sign streamed data, in chunks if the algorithm provides `sign_stream`
+		 * \param algo Algorithm to sign with
+		 * \param source Data to sign
+		 * \param ec Filled with details on error
+		 * \return Signature
+		 */
+		template<typename Algo>
+		std::string sign_stream(const Algo& algo, const chunk_source& source, std::error_code& ec) {
+			ec.clear();
+			using supported = std::integral_constant<bool, is_detected<sign_stream_t, Algo>::value>;
+			return sign_stream(algo, source, ec, supported{});
+		}
+
+		template<typename Algo>
+		void verify_stream(const Algo& algo, const chunk_source& source, const std::string& sig, std::error_code& ec,
+						   std::true_type) {
+			algo.verify_stream(source, sig, ec);
+		}
+		template<typename Algo>
+		void verify_stream(const Algo& algo, const chunk_source& source, const std::string& sig, std::error_code& ec,
+						   std::false_type) {
+			std::string data;
+			if (!collect(source, data)) {
+				ec = error::signature_verification_error::verifyupdate_failed;
+				return;
+			}
+			algo.verify(data, sig, ec);
+		}
+		/**
+		 * Check the signature of streamed data, in chunks if the algorithm provides `verify_stream`
+		 * \param algo Algorithm to check the signature with
+		 * \param source Data the signature was created for
+		 * \param sig Signature to check
+		 * \param ec Filled with details on error
+		 */
+		template<typename Algo>
+		void verify_stream(const Algo& algo, const chunk_source& source, const std::string& sig, std::error_code& ec) {
+			ec.clear();
+			using supported = std::integral_constant<bool, is_detected<verify_stream_t, Algo>::value>;
+			verify_stream(algo, source, sig, ec, supported{});
+		}
+
+		template<typename T>
+		using verify_batch_t = decltype(std::declval<const T&>().verify_batch(
+			std::declval<const std::vector<std::string>&>(), std::declval<const std::vector<std::string>&>(),
+			std::declval<std::vector<std::error_code>&>()));
+
+		template<typename Algo>
+		void verify_batch(const Algo& algo, const std::vector<std::string>& data, const std::vector<std::string>& sigs,
+						  std::vector<std::error_code>& ec, std::true_type) {
+			algo.verify_batch(data, sigs, ec);
+		}
+		template<typename Algo>
+		void verify_batch(const Algo& algo, const std::vector<std::string>& data, const std::vector<std::string>& sigs,
+						  std::vector<std::error_code>& ec, std::false_type) {
+			ec.assign(data.size(), std::error_code{});
+			for (size_t i = 0; i < data.size(); i++)
+				algo.verify(data[i], sigs[i], ec[i]);
+		}
+		/**
+		 * Check the signatures of many inputs, all at once if the algorithm provides `verify_batch`
+		 * \param algo Algorithm to check the signatures with
+		 * \param data Data each signature was created for
+		 * \param sigs Signature of each input, as many as there are inputs
+		 * \param ec Resized to the number of inputs and filled with the result of each
+		 */
+		template<typename Algo>
+		void verify_batch(const Algo& algo, const std::vector<std::string>& data, const std::vector<std::string>& sigs,
+						  std::vector<std::error_code>& ec) {
+			using supported = std::integral_constant<bool, is_detected<verify_batch_t, Algo>::value>;
+			verify_batch(algo, data, sigs, ec, supported{});
+		}
+	} // namespace details
+
+	/**
+	 * \brief An algorithm producing one signature of a JWS in JSON serialization
+	 *
+	 * Wraps any algorithm (e.g. `jwt::crypto::algorithm::rs256`) together with the key id put into the unprotected
+	 * header of its signature. Use builder::sign_general() to sign with several of them.
+	 */
+	class jws_signer {
+	public:
+		using sign_fn_t = std::function<std::string(const std::string&, std::error_code&)>;
+
+		/**
+		 * Construct a new signer
+		 * \param alg Name of the algorithm, written to the protected header
+		 * \param kid Key id written to the unprotected header, may be empty
+		 * \param fn Function signing the data with the key
+		 */
+		jws_signer(std::string alg, std::string kid, sign_fn_t fn)
+			: alg_name(std::move(alg)), key_id(std::move(kid)), sign_fn(std::move(fn)) {}
+
+		/**
+		 * Wrap an algorithm instance
+		 * \param alg Algorithm to sign with
+		 * \param kid Key id written to the unprotected header, may be empty
+		 */
+		template<typename Algorithm>
+		static jws_signer create(Algorithm alg, std::string kid = {}) {
+			auto name = alg.name();
+			return {std::move(name), std::move(kid),
+					[alg](const std::string& data, std::error_code& ec) { return alg.sign(data, ec); }};
+		}
+
+		/// Get algorithm name
+		const std::string& get_algorithm() const noexcept { return alg_name; }
+		/// Get key id, empty if none was given
+		const std::string& get_key_id() const noexcept { return key_id; }
+
+		/**
+		 * Sign the data
+		 * \param data The data to sign
+		 * \param ec Filled with details on failure
+		 * \return The signature
+		 */
+		std::string sign(const std::string& data, std::error_code& ec) const { return sign_fn(data, ec); }
+
+	private:
+		std::string alg_name;
+		std::string key_id;
+		sign_fn_t sign_fn;
+	};
+
+#ifndef JWT_DISABLE_BASE64
+	template<typename json_traits>
+	class decoded_jws_json;
+
+	/**
+	 * \brief One signature of a JWS in JSON serialization
+	 *
+	 * The header claims are the union of the protected and the unprotected header. The signature covers the
+	 * protected header and the payload only.
+	 */
+	template<typename json_traits>
+	class jws_signature : public header<json_traits> {
+		template<typename>
+		friend class decoded_jws_json;
+
+		/// Header holding the protected claims only
+		struct protected_claims_t : header<json_traits> {
+			void assign(details::map_of_claims<json_traits> claims) { this->header_claims = std::move(claims); }
+		};
+
+		/// Protected header decoded from base64, empty if absent
+		typename json_traits::string_type protected_header;
+		/// Claims of the protected header
+		protected_claims_t protected_claims;
+		/// Unmodified protected header in base64, empty if absent
+		typename json_traits::string_type protected_base64;
+		/// Claims of the unprotected header
+		details::map_of_claims<json_traits> unprotected_claims;
+		/// Signature decoded from base64
+		typename json_traits::string_type signature;
+		/// Unmodified signature in base64
+		typename json_traits::string_type signature_base64;
+
+	public:
+		using basic_claim_t = basic_claim<json_traits>;
+
+		/**
+		 * Get protected header as json string
+		 * \return protected header after base64 decoding, empty if absent
+		 */
+		const typename json_traits::string_type& get_protected_header() const noexcept { return protected_header; }
+		/**
+		 * Get protected header as base64 string
+		 * \return protected header before base64 decoding, empty if absent
+		 */
+		const typename json_traits::string_type& get_protected_header_base64() const noexcept {
+			return protected_base64;
+		}
+		/**
+		 * Get signature
+		 * \return signature after base64 decoding
+		 */
+		const typename json_traits::string_type& get_signature() const noexcept { return signature; }
+		/**
+		 * Get signature as base64 string
+		 * \return signature before base64 decoding
+		 */
+		const typename json_traits::string_type& get_signature_base64() const noexcept { return signature_base64; }
+		/**
+		 * Check if a claim was sent in the unprotected header, and thus is not covered by the signature
+		 * \return true if claim was present in the unprotected header, false otherwise
+		 */
+		bool is_unprotected_header_claim(const typename json_traits::string_type& name) const noexcept {
+			return unprotected_claims.has_claim(name);
+		}
+		/**
+		 * Get the protected header, the claims covered by the signature
+		 * \return header without the unprotected claims
+		 */
+		const header<json_traits>& get_protected_claims() const noexcept { return protected_claims; }
+		/**
+		 * Get all header claims, protected and unprotected
+		 * \return map of claims
+		 */
+		std::unordered_map<typename json_traits::string_type, basic_claim_t> get_header_claims() const {
+			return this->header_claims.get_claims();
+		}
+	};
+
+	/**
+	 * \brief Class containing a JWS in flattened or general JSON serialization
+	 *
+	 * The payload is decoded and its claims are parsed once, however many signatures the document carries.
+	 * The decoded_jwt base holds the header and signature of the first signature, so a flattened document reads
+	 * like the equivalent compact token. Its header claims include the unprotected ones, see
+	 * jws_signature::get_protected_claims() for the signed claims. get_token() returns the JSON document.
+	 *
+	 * \see [RFC 7515 section 7.2](https://tools.ietf.org/html/rfc7515#section-7.2)
+	 */
+	template<typename json_traits>
+	class decoded_jws_json : public decoded_jwt<json_traits> {
+		/// Signatures in document order
+		std::vector<jws_signature<json_traits>> signatures;
+		/// Whether the document used the flattened syntax
+		bool flattened;
+
+	public:
+		using basic_claim_t = basic_claim<json_traits>;
+		/**
+		 * \brief Parses a given document
+		 *
+		 * \param document JWS in flattened or general JSON serialization
+		 * \throw std::invalid_argument Document is not in correct format
+		 * \throw std::runtime_error Base64 decoding failed or invalid json
+		 */
+		JWT_CLAIM_EXPLICIT decoded_jws_json(const typename json_traits::string_type& document)
+			: decoded_jwt<json_traits>(document, typename decoded_jwt<json_traits>::defer_decoding{}) {
+			const auto doc = details::map_of_claims<json_traits>::parse_claims(document);
+			this->payload_base64 = string_member(doc, "payload");
+			decode(this->payload_base64, this->payload);
+			this->payload_claims = details::map_of_claims<json_traits>::parse_claims(this->payload);
+
+			flattened = doc.count("signatures") == 0;
+			if (flattened) {
+				signatures.push_back(parse_signature(doc));
+			} else {
+				const auto& list = doc.at("signatures");
+				if (doc.count("signature") != 0 || json_traits::get_type(list) != json::type::array) fail();
+				for (const auto& entry : json_traits::as_array(list)) {
+					if (json_traits::get_type(entry) != json::type::object) fail();
+					signatures.push_back(parse_signature(json_traits::as_object(entry)));
+				}
+				if (signatures.empty()) fail();
+			}
+
+			const auto& first = signatures.front();
+			this->header = first.protected_header;
+			this->header_base64 = first.protected_base64;
+			this->signature = first.signature;
+			this->signature_base64 = first.signature_base64;
+			this->header_claims = first.header_claims;
+		}
+
+		/**
+		 * Check if the document used the flattened syntax
+		 * \return true for the flattened, false for the general syntax
+		 */
+		bool is_flattened() const noexcept { return flattened; }
+		/**
+		 * Get all signatures
+		 * \return signatures in document order, never empty
+		 */
+		const std::vector<jws_signature<json_traits>>& get_signatures() const noexcept { return signatures; }
+
+	private:
+		[[noreturn]] static void fail() { throw std::invalid_argument("invalid JWS JSON serialization supplied"); }
+
+		static void decode(const typename json_traits::string_type& in, typename json_traits::string_type& out) {
+			base::decode_unpadded<alphabet::base64url>(in.data(), in.size(), out);
+		}
+
+		static typename json_traits::string_type string_member(const typename json_traits::object_type& obj,
+																const typename json_traits::string_type& name) {
+			if (obj.count(name) == 0 || json_traits::get_type(obj.at(name)) != json::type::string) fail();
+			return json_traits::as_string(obj.at(name));
+		}
+
+		static jws_signature<json_traits> parse_signature(const typename json_traits::object_type& obj) {
+			jws_signature<json_traits> res;
+			typename json_traits::object_type joint;
+			if (obj.count("protected") != 0) {
+				res.protected_base64 = string_member(obj, "protected");
+				decode(res.protected_base64, res.protected_header);
+				joint = details::map_of_claims<json_traits>::parse_claims(res.protected_header);
+				res.protected_claims.assign(details::map_of_claims<json_traits>(joint));
+			}
+			if (obj.count("header") != 0) {
+				const auto& hdr = obj.at("header");
+				if (json_traits::get_type(hdr) != json::type::object) fail();
+				auto unprotected = json_traits::as_object(hdr);
+				for (const auto& c : unprotected) {
+					if (joint.count(c.first) != 0) fail();
+					joint[c.first] = c.second;
+				}
+				res.unprotected_claims = details::map_of_claims<json_traits>(std::move(unprotected));
+			}
+			res.signature_base64 = string_member(obj, "signature");
+			decode(res.signature_base64, res.signature);
+			res.header_claims = details::map_of_claims<json_traits>(std::move(joint));
+			return res;
+		}
+	};
+
+	/**
+	 * \brief Class containing a JWS with a detached payload
+	 *
+	 * The token has an empty payload part (`header..signature`), the payload is passed to
+	 * verifier::verify_detached() separately. Payload getters return empty strings and there are no payload claims.
+	 *
+	 * \see [RFC 7797](https://tools.ietf.org/html/rfc7797) for unencoded payloads
+	 */
+	template<typename json_traits>
+	class decoded_detached_jws : public decoded_jwt<json_traits> {
+	public:
+		using basic_claim_t = basic_claim<json_traits>;
+		/**
+		 * \brief Parses a given token
+		 *
+		 * \param token The token to parse
+		 * \throw std::invalid_argument Token is not in correct format or has a payload
+		 * \throw std::runtime_error Base64 decoding failed or invalid json
+		 */
+		JWT_CLAIM_EXPLICIT decoded_detached_jws(const typename json_traits::string_type& token)
+			: decoded_jwt<json_traits>(token, typename decoded_jwt<json_traits>::defer_decoding{}) {
+			const auto hdr_end = token.find('.');
+			if (hdr_end == json_traits::string_type::npos || token.compare(hdr_end, 2, "..") != 0)
+				throw std::invalid_argument("invalid token supplied");
+			this->header_base64 = token.substr(0, hdr_end);
+			this->signature_base64 = token.substr(hdr_end + 2);
+			base::decode_unpadded<alphabet::base64url>(this->header_base64.data(), this->header_base64.size(),
+													   this->header);
+			base::decode_unpadded<alphabet::base64url>(this->signature_base64.data(),
+													   this->signature_base64.size(), this->signature);
+			this->header_claims = details::map_of_claims<json_traits>::parse_claims(this->header);
+		}
+
+		/**
+		 * Check if the payload is signed as is, without base64url encoding ("b64" header set to false)
+		 * \return true if the payload is unencoded, false otherwise
+		 */
+		bool is_payload_unencoded() const noexcept {
+			const auto* b64 = this->find_header_claim("b64");
+			return b64 != nullptr && json_traits::get_type(*b64) == json::type::boolean && !json_traits::as_bool(*b64);
+		}
+	};
+#endif
+
+#ifndef JWT_DISABLE_BASE64
+	template<typename json_traits, typename Algo>
+	class token_template;
+	template<typename json_traits, typename Algo>
+	class prepared_builder;
+#endif
+
+	/**
+	 * Builder class to build and sign a new token
+	 * Use jwt::create() to get an instance of this class.
+	 */
+	template<typename json_traits>
+	class builder {
+		typename json_traits::object_type header_claims;
+		typename json_traits::object_type payload_claims;
+
+#ifndef JWT_DISABLE_BASE64
+		template<typename, typename>
+		friend class token_template;
+		template<typename, typename>
+		friend class prepared_builder;
+#endif
+
+#if !defined(JWT_DISABLE_BASE64) && defined(JWT_OPENSSL_CRYPTO)
+		// Decode a base64url encoded string header claim, an absent claim leaves out empty
+		bool decode_header_member(const typename json_traits::string_type& name, std::string& out) const {
+			if (header_claims.count(name) == 0) return true;
+			const auto& claim = header_claims.at(name);
+			if (json_traits::get_type(claim) != json::type::string) return false;
+			const auto value = json_traits::as_string(claim);
+			try {
+				base::decode_unpadded<alphabet::base64url>(value.data(), value.size(), out);
+			} catch (const std::runtime_error&) { return false; }
+			return true;
+		}
+#endif
+#ifndef JWT_DISABLE_BASE64
+		// Sign `protected.payload` and set the "protected" and "signature" members of a JWS JSON signature
+		template<typename Sign>
+		void sign_json_member(const std::string& alg, const std::string& payload, Sign sign, std::string& data,
+							  typename json_traits::object_type& out, std::error_code& ec) const {
+			typename json_traits::object_type obj_header = header_claims;
+			obj_header["alg"] = typename json_traits::value_type(alg);
+			data.clear();
+			base::encode_unpadded<alphabet::base64url>(
+				json_traits::serialize(typename json_traits::value_type(obj_header)), data);
+			out["protected"] = typename json_traits::value_type(data);
+			data += '.';
+			data += payload;
+			const auto signature = sign(data, ec);
+			if (ec) return;
+			out["signature"] = typename json_traits::value_type(
+				base::trim<alphabet::base64url>(base::encode<alphabet::base64url>(signature)));
+		}
+
+		// Sign `header.` followed by the unencoded payload, the token keeps the payload part empty
+		template<typename Algo>
+		typename json_traits::string_type sign_detached_source(const Algo& algo, const details::chunk_source& payload,
+															   std::error_code& ec) const {
+			typename json_traits::object_type obj_header = header_claims;
+			if (header_claims.count("alg") == 0) obj_header["alg"] = typename json_traits::value_type(algo.name());
+			obj_header["b64"] = typename json_traits::value_type(false);
+			typename json_traits::array_type crit;
+			const auto existing = header_claims.find("crit");
+			if (existing != header_claims.end() && json_traits::get_type(existing->second) == json::type::array)
+				crit = json_traits::as_array(existing->second);
+			if (std::none_of(crit.begin(), crit.end(), [](const typename json_traits::value_type& v) {
+					return json_traits::get_type(v) == json::type::string && json_traits::as_string(v) == "b64";
+				}))
+				crit.push_back(typename json_traits::value_type(typename json_traits::string_type("b64")));
+			obj_header["crit"] = typename json_traits::value_type(crit);
+
+			std::string token;
+			base::encode_unpadded<alphabet::base64url>(
+				json_traits::serialize(typename json_traits::value_type(obj_header)), token);
+			token += '.';
+			const auto signature = details::sign_stream(
+				algo, [&token, &payload](const details::chunk_sink& sink) {
+					return sink(token.data(), token.size()) && payload(sink);
+				},
+				ec);
+			if (ec) return {};
+			token += '.';
+			base::encode_unpadded<alphabet::base64url>(signature, token);
+			return token;
+		}
+#endif
+
+	public:
+		builder() = default;
+		/**
+		 * Set a header claim.
+		 * \param id Name of the claim
+		 * \param c Claim to add
+		 * \return *this to allow for method chaining
+		 */
+		builder& set_header_claim(const typename json_traits::string_type& id, typename json_traits::value_type c) {
+			header_claims[id] = std::move(c);
+			return *this;
+		}
+
+		/**
+		 * Set a header claim.
+		 * \param id Name of the claim
+		 * \param c Claim to add
+		 * \return *this to allow for method chaining
+		 */
+		builder& set_header_claim(const typename json_traits::string_type& id, basic_claim<json_traits> c) {
+			header_claims[id] = c.to_json();
+			return *this;
+		}
+		/**
+		 * Set a payload claim.
+		 * \param id Name of the claim
+		 * \param c Claim to add
+		 * \return *this to allow for method chaining
+		 */
+		builder& set_payload_claim(const typename json_traits::string_type& id, typename json_traits::value_type c) {
+			payload_claims[id] = std::move(c);
+			return *this;
+		}
+		/**
+		 * Set a payload claim.
+		 * \param id Name of the claim
+		 * \param c Claim to add
+		 * \return *this to allow for method chaining
+		 */
+		builder& set_payload_claim(const typename json_traits::string_type& id, basic_claim<json_traits> c) {
+			payload_claims[id] = c.to_json();
+			return *this;
+		}
+		/**
+		 * \brief Set algorithm claim
+		 * You normally don't need to do this, as the algorithm is automatically set if you don't change it.
+		 *
+		 * \param str Name of algorithm
+		 * \return *this to allow for method chaining
+		 */
+		builder& set_algorithm(typename json_traits::string_type str) {
+			return set_header_claim("alg", typename json_traits::value_type(str));
+		}
+		/**
+		 * Set type claim
+		 * \param str Type to set
+		 * \return *this to allow for method chaining
+		 */
+		builder& set_type(typename json_traits::string_type str) {
+			return set_header_claim("typ", typename json_traits::value_type(str));
+		}
+		/**
+		 * Set content type claim
+		 * \param str Type to set
+		 * \return *this to allow for method chaining
+		 */
+		builder& set_content_type(typename json_traits::string_type str) {
+			return set_header_claim("cty", typename json_traits::value_type(str));
+		}
+		/**
+		 * \brief Set key id claim
+		 *
+		 * \param str Key id to set
+		 * \return *this to allow for method chaining
+		 */
+		builder& set_key_id(typename json_traits::string_type str) {
+			return set_header_claim("kid", typename json_traits::value_type(str));
+		}
+		/**
+		 * Set issuer claim
+		 * \param str Issuer to set
+		 * \return *this to allow for method chaining
+		 */
+		builder& set_issuer(typename json_traits::string_type str) {
+			return set_payload_claim("iss", typename json_traits::value_type(str));
+		}
+		/**
+		 * Set subject claim
+		 * \param str Subject to set
+		 * \return *this to allow for method chaining
+		 */
+		builder& set_subject(typename json_traits::string_type str) {
+			return set_payload_claim("sub", typename json_traits::value_type(str));
+		}
+		/**
+		 * Set audience claim
+		 * \param a Audience set
+		 * \return *this to allow for method chaining
+		 */
+		builder& set_audience(typename json_traits::array_type a) {
+			return set_payload_claim("aud", typename json_traits::value_type(a));
+		}
+		/**
+		 * Set audience claim
+		 * \param aud Single audience
+		 * \return *this to allow for method chaining
+		 */
+		builder& set_audience(typename json_traits::string_type aud) {
+			return set_payload_claim("aud", typename json_traits::value_type(aud));
+		}
+		/**
+		 * Set expires at claim
+		 * \param d Expires time
+		 * \return *this to allow for method chaining
+		 */
+		builder& set_expires_at(const date& d) { return set_payload_claim("exp", basic_claim<json_traits>(d)); }
+		/**
+		 * Set not before claim
+		 * \param d First valid time
+		 * \return *this to allow for method chaining
+		 */
+		builder& set_not_before(const date& d) { return set_payload_claim("nbf", basic_claim<json_traits>(d)); }
+		/**
+		 * Set issued at claim
+		 * \param d Issued at time, should be current time
+		 * \return *this to allow for method chaining
+		 */
+		builder& set_issued_at(const date& d) { return set_payload_claim("iat", basic_claim<json_traits>(d)); }
+		/**
+		 * Set id claim
+		 * \param str ID to set
+		 * \return *this to allow for method chaining
+		 */
+		builder& set_id(const typename json_traits::string_type& str) {
+			return set_payload_claim("jti", typename json_traits::value_type(str));
+		}
+
+		/**
+		 * Sign token and return result
+		 * \tparam Algo Callable method which takes a string_type and return the signed input as a string_type
+		 * \tparam Encode Callable method which takes a string_type and base64url safe encodes it,
+		 * MUST return the result with no padding; trim the result.
+		 * \param algo Instance of an algorithm to sign the token with
+		 * \param encode Callable to transform the serialized json to base64 with no padding
+		 * \return Final token as a string
+		 *
+		 * \note If the 'alg' header in not set in the token it will be set to `algo.name()`
+		 */
+		template<typename Algo, typename Encode>
+		typename json_traits::string_type sign(const Algo& algo, Encode encode) const {
+			std::error_code ec;
+			auto res = sign(algo, encode, ec);
+			error::throw_if_error(ec);
+			return res;
+		}
+#ifndef JWT_DISABLE_BASE64
+		/**
+		 * Sign token and return result
+		 *
+		 * using the `jwt::base` functions provided
+		 *
+		 * \param algo Instance of an algorithm to sign the token with
+		 * \return Final token as a string
+		 */
+		template<typename Algo>
+		typename json_traits::string_type sign(const Algo& algo) const {
+			std::error_code ec;
+			auto res = sign(algo, ec);
+			error::throw_if_error(ec);
+			return res;
+		}
+#endif
+
+		/**
+		 * Sign token and return result
+		 * \tparam Algo Callable method which takes a string_type and return the signed input as a string_type
+		 * \tparam Encode Callable method which takes a string_type and base64url safe encodes it,
+		 * MUST return the result with no padding; trim the result.
+		 * \param algo Instance of an algorithm to sign the token with
+		 * \param encode Callable to transform the serialized json to base64 with no padding
+		 * \param ec error_code filled with details on error
+		 * \return Final token as a string
+		 *
+		 * \note If the 'alg' header in not set in the token it will be set to `algo.name()`
+		 */
+		template<typename Algo, typename Encode>
+		typename json_traits::string_type sign(const Algo& algo, Encode encode, std::error_code& ec) const {
+			return sign(algo, encode, ec, static_cast<null_stage_observer*>(nullptr));
+		}
+
+		/**
+		 * Sign token and report the time spent in each stage
+		 * \param algo Instance of an algorithm to sign the token with
+		 * \param encode Callable to transform the serialized json to base64 with no padding
+		 * \param ec error_code filled with details on error
+		 * \param observer Observer receiving stage events, may be nullptr
+		 * \return Final token as a string
+		 */
+		template<typename Algo, typename Encode, typename Observer>
+		typename json_traits::string_type sign(const Algo& algo, Encode encode, std::error_code& ec,
+											   Observer* observer) const {
+			// make a copy such that a builder can be re-used
+			typename json_traits::object_type obj_header = header_claims;
+			if (header_claims.count("alg") == 0) obj_header["alg"] = typename json_traits::value_type(algo.name());
+
+			std::string alg;
+			if (Observer::enabled) alg = algo.name();
+			details::stage_scope<Observer> encode_scope(observer, stage::encode, alg, 0);
+			const auto header = encode(json_traits::serialize(typename json_traits::value_type(obj_header)));
+			const auto payload = encode(json_traits::serialize(typename json_traits::value_type(payload_claims)));
+			const auto token = header + "." + payload;
+			encode_scope.end();
+
+			details::stage_scope<Observer> sign_scope(observer, stage::signature, alg, token.size());
+			auto signature = algo.sign(token, ec);
+			sign_scope.end(ec);
+			if (ec) return {};
+
+			return token + "." + encode(signature);
+		}
+#ifndef JWT_DISABLE_BASE64
+		/**
+		 * Sign token and return result
+		 *
+		 * using the `jwt::base` functions provided
+		 *
+		 * \param algo Instance of an algorithm to sign the token with
+		 * \param ec error_code filled with details on error
+		 * \return Final token as a string
+		 */
+		template<typename Algo>
+		typename json_traits::string_type sign(const Algo& algo, std::error_code& ec) const {
+			return sign(algo, ec, static_cast<null_stage_observer*>(nullptr));
+		}
+
+		/**
+		 * Sign token and report the time spent in each stage
+		 *
+		 * using the `jwt::base` functions provided
+		 *
+		 * \param algo Instance of an algorithm to sign the token with
+		 * \param ec error_code filled with details on error
+		 * \param observer Observer receiving stage events, may be nullptr
+		 * \return Final token as a string
+		 */
+		template<typename Algo, typename Observer>
+		typename json_traits::string_type sign(const Algo& algo, std::error_code& ec, Observer* observer) const {
+			return sign(
+				algo,
+				[](const typename json_traits::string_type& data) {
+					return base::trim<alphabet::base64url>(base::encode<alphabet::base64url>(data));
+				},
+				ec, observer);
+		}
+
+		/**
+		 * Sign token and append it to a buffer
+		 *
+		 * The header, payload and signature are encoded directly into the buffer, reusing it for many tokens
+		 * avoids allocating the output.
+		 *
+		 * \param algo Instance of an algorithm to sign the token with
+		 * \param out Buffer the token is appended to, left unchanged on error
+		 * \param ec error_code filled with details on error
+		 */
+		template<typename Algo>
+		void sign(const Algo& algo, std::string& out, std::error_code& ec) const {
+			ec.clear();
+			typename json_traits::object_type obj_header = header_claims;
+			if (header_claims.count("alg") == 0) obj_header["alg"] = typename json_traits::value_type(algo.name());
+
+			const auto offset = out.size();
+			base::encode_unpadded<alphabet::base64url>(
+				json_traits::serialize(typename json_traits::value_type(obj_header)), out);
+			out += '.';
+			base::encode_unpadded<alphabet::base64url>(
+				json_traits::serialize(typename json_traits::value_type(payload_claims)), out);
+
+			const auto signature = offset == 0 ? algo.sign(out, ec) : algo.sign(out.substr(offset), ec);
+			if (ec) {
+				out.resize(offset);
+				return;
+			}
+			out += '.';
+			base::encode_unpadded<alphabet::base64url>(signature, out);
+		}
+
+		/**
+		 * Sign the payload claims into a JWS in flattened JSON serialization
+		 *
+		 * \param algo Instance of an algorithm to sign the token with
+		 * \return Document as a string
+		 *
+		 * \note The 'alg' header is set to `algo.name()`
+		 */
+		template<typename Algo>
+		typename json_traits::string_type sign_flattened(const Algo& algo) const {
+			std::error_code ec;
+			auto res = sign_flattened(algo, ec);
+			error::throw_if_error(ec);
+			return res;
+		}
+
+		/**
+		 * Sign the payload claims into a JWS in flattened JSON serialization
+		 *
+		 * The header claims of this builder become the protected header.
+		 *
+		 * \param algo Instance of an algorithm to sign the token with
+		 * \param ec error_code filled with details on error
+		 * \return Document as a string
+		 *
+		 * \note The 'alg' header is set to `algo.name()`
+		 */
+		template<typename Algo>
+		typename json_traits::string_type sign_flattened(const Algo& algo, std::error_code& ec) const {
+			ec.clear();
+			std::string payload;
+			base::encode_unpadded<alphabet::base64url>(
+				json_traits::serialize(typename json_traits::value_type(payload_claims)), payload);
+			typename json_traits::object_type doc;
+			doc["payload"] = typename json_traits::value_type(payload);
+			std::string data;
+			sign_json_member(
+				algo.name(), payload,
+				[&algo](const std::string& d, std::error_code& e) { return algo.sign(d, e); }, data, doc, ec);
+			if (ec) return {};
+			return json_traits::serialize(typename json_traits::value_type(doc));
+		}
+
+		/**
+		 * Sign the payload claims with several keys into a JWS in general JSON serialization
+		 *
+		 * \param signers Algorithms to sign with, one signature each
+		 * \return Document as a string
+		 */
+		typename json_traits::string_type sign_general(const std::vector<jws_signer>& signers) const {
+			std::error_code ec;
+			auto res = sign_general(signers, ec);
+			error::throw_if_error(ec);
+			return res;
+		}
+
+		/**
+		 * Sign the payload claims with several keys into a JWS in general JSON serialization
+		 *
+		 * The payload is encoded once. Each signature gets a protected header made of the header claims of this
+		 * builder with 'alg' set to its algorithm, and an unprotected header with its key id, if it has one.
+		 *
+		 * \param signers Algorithms to sign with, one signature each
+		 * \param ec error_code filled with details on error
+		 * \return Document as a string
+		 */
+		typename json_traits::string_type sign_general(const std::vector<jws_signer>& signers,
+													   std::error_code& ec) const {
+			ec.clear();
+			std::string payload;
+			base::encode_unpadded<alphabet::base64url>(
+				json_traits::serialize(typename json_traits::value_type(payload_claims)), payload);
+			typename json_traits::array_type list;
+			std::string data;
+			for (const auto& signer : signers) {
+				typename json_traits::object_type entry;
+				sign_json_member(
+					signer.get_algorithm(), payload,
+					[&signer](const std::string& d, std::error_code& e) { return signer.sign(d, e); }, data, entry,
+					ec);
+				if (ec) return {};
+				if (!signer.get_key_id().empty()) {
+					typename json_traits::object_type unprotected;
+					unprotected["kid"] = typename json_traits::value_type(signer.get_key_id());
+					entry["header"] = typename json_traits::value_type(unprotected);
+				}
+				list.push_back(typename json_traits::value_type(entry));
+			}
+			typename json_traits::object_type doc;
+			doc["payload"] = typename json_traits::value_type(payload);
+			doc["signatures"] = typename json_traits::value_type(list);
+			return json_traits::serialize(typename json_traits::value_type(doc));
+		}
+
+		/**
+		 * Sign a detached, unencoded payload read from a stream
+		 * \param algo Instance of an algorithm to sign the token with
+		 * \param payload Stream holding the payload, read to its end
+		 * \return Token with an empty payload part, `header..signature`
+		 */
+		template<typename Algo>
+		typename json_traits::string_type sign_detached(const Algo& algo, std::istream& payload) const {
+			std::error_code ec;
+			auto res = sign_detached(algo, payload, ec);
+			error::throw_if_error(ec);
+			return res;
+		}
+
+		/**
+		 * Sign a detached, unencoded payload read from a stream
+		 *
+		 * The header claims of this builder are used with "b64" set to false and "b64" added to "crit"
+		 * (RFC 7797). The payload is hashed chunk by chunk as it is read and is not part of the token, the
+		 * payload claims of this builder are ignored. Algorithms without `sign_stream`, like EdDSA, need the
+		 * whole payload at once and collect it in memory first.
+		 *
+		 * \param algo Instance of an algorithm to sign the token with
+		 * \param payload Stream holding the payload, read to its end
+		 * \param ec error_code filled with details on error
+		 * \return Token with an empty payload part, `header..signature`
+		 */
+		template<typename Algo>
+		typename json_traits::string_type sign_detached(const Algo& algo, std::istream& payload,
+														std::error_code& ec) const {
+			return sign_detached_source(algo, details::read_stream(payload), ec);
+		}
+
+		/**
+		 * Sign a detached, unencoded payload made of a range of chunks
+		 * \param algo Instance of an algorithm to sign the token with
+		 * \param begin Iterator to the first chunk, chunks provide `data()` and `size()`
+		 * \param end Iterator past the last chunk
+		 * \return Token with an empty payload part, `header..signature`
+		 */
+		template<typename Algo, typename ChunkIt>
+		typename json_traits::string_type sign_detached(const Algo& algo, ChunkIt begin, ChunkIt end) const {
+			std::error_code ec;
+			auto res = sign_detached(algo, begin, end, ec);
+			error::throw_if_error(ec);
+			return res;
+		}
+
+		/**
+		 * Sign a detached, unencoded payload made of a range of chunks
+		 * \param algo Instance of an algorithm to sign the token with
+		 * \param begin Iterator to the first chunk, chunks provide `data()` and `size()`
+		 * \param end Iterator past the last chunk
+		 * \param ec error_code filled with details on error
+		 * \return Token with an empty payload part, `header..signature`
+		 * \see sign_detached(const Algo&, std::istream&, std::error_code&) const
+		 */
+		template<typename Algo, typename ChunkIt>
+		typename json_traits::string_type sign_detached(const Algo& algo, ChunkIt begin, ChunkIt end,
+														std::error_code& ec) const {
+			return sign_detached_source(algo, details::read_chunks(begin, end), ec);
+		}
+
+#ifdef JWT_OPENSSL_CRYPTO
+		/**
+		 * Encrypt the payload claims into a token in JWE compact serialization
+		 *
+		 * \param key_algo Key management algorithm, e.g. jwt::algorithm::a256kw
+		 * \param enc_algo Content encryption algorithm, e.g. jwt::algorithm::a256gcm
+		 * \return Final token as a string
+		 * \throw encryption_exception, rsa_exception or ecdsa_exception on error
+		 *
+		 * \note The 'alg' and 'enc' headers are set to the names of the algorithms
+		 */
+		template<typename KeyAlgo, typename EncAlgo>
+		typename json_traits::string_type encrypt(const KeyAlgo& key_algo, const EncAlgo& enc_algo) const {
+			std::error_code ec;
+			auto res = encrypt(key_algo, enc_algo, ec);
+			error::throw_if_error(ec);
+			return res;
+		}
+
+		/**
+		 * Encrypt the payload claims into a token in JWE compact serialization
+		 *
+		 * \param key_algo Key management algorithm, e.g. jwt::algorithm::a256kw
+		 * \param enc_algo Content encryption algorithm, e.g. jwt::algorithm::a256gcm
+		 * \param ec error_code filled with details on error
+		 * \return Final token as a string
+		 *
+		 * \note The 'alg' and 'enc' headers are set to the names of the algorithms
+		 */
+		template<typename KeyAlgo, typename EncAlgo>
+		typename json_traits::string_type encrypt(const KeyAlgo& key_algo, const EncAlgo& enc_algo,
+												  std::error_code& ec) const {
+			return encrypt(json_traits::serialize(typename json_traits::value_type(payload_claims)), key_algo,
+						   enc_algo, ec);
+		}
+
+		/**
+		 * Encrypt arbitrary content, e.g. a signed token for a nested JWT, using the header claims of this builder
+		 *
+		 * \param plaintext Content to encrypt, the payload claims of the builder are ignored
+		 * \param key_algo Key management algorithm, e.g. jwt::algorithm::a256kw
+		 * \param enc_algo Content encryption algorithm, e.g. jwt::algorithm::a256gcm
+		 * \return Final token as a string
+		 * \throw encryption_exception, rsa_exception or ecdsa_exception on error
+		 */
+		template<typename KeyAlgo, typename EncAlgo>
+		typename json_traits::string_type encrypt(typename json_traits::string_type plaintext, const KeyAlgo& key_algo,
+												  const EncAlgo& enc_algo) const {
+			std::error_code ec;
+			auto res = encrypt(std::move(plaintext), key_algo, enc_algo, ec);
+			error::throw_if_error(ec);
+			return res;
+		}
+
+		/**
+		 * Encrypt arbitrary content, e.g. a signed token for a nested JWT, using the header claims of this builder
+		 *
+		 * The content is encrypted in place and encoded directly into the token. For ECDH-ES the ephemeral
+		 * public key is added to the header as "epk", "apu" and "apv" header claims are used for the key
+		 * derivation.
+		 *
+		 * \param plaintext Content to encrypt, the payload claims of the builder are ignored
+		 * \param key_algo Key management algorithm, e.g. jwt::algorithm::a256kw
+		 * \param enc_algo Content encryption algorithm, e.g. jwt::algorithm::a256gcm
+		 * \param ec error_code filled with details on error
+		 * \return Final token as a string
+		 */
+		template<typename KeyAlgo, typename EncAlgo>
+		typename json_traits::string_type encrypt(typename json_traits::string_type plaintext, const KeyAlgo& key_algo,
+												  const EncAlgo& enc_algo, std::error_code& ec) const {
+			ec.clear();
+			crypto::algorithm::key_agreement_parameters params;
+			if (!decode_header_member("apu", params.party_u_info) ||
+				!decode_header_member("apv", params.party_v_info)) {
+				ec = error::encryption_error::key_agreement_failed;
+				return {};
+			}
+			std::string cek;
+			const auto encrypted_key = key_algo.encrypt_key(enc_algo.name(), enc_algo.key_size(), cek, params, ec);
+			if (ec) return {};
+
+			typename json_traits::object_type obj_header = header_claims;
+			obj_header["alg"] = typename json_traits::value_type(key_algo.name());
+			obj_header["enc"] = typename json_traits::value_type(enc_algo.name());
+			if (!params.curve.empty()) {
+				typename json_traits::object_type epk;
+				epk["kty"] = typename json_traits::value_type(typename json_traits::string_type("EC"));
+				epk["crv"] = typename json_traits::value_type(params.curve);
+				epk["x"] = typename json_traits::value_type(
+					base::trim<alphabet::base64url>(base::encode<alphabet::base64url>(params.x)));
+				epk["y"] = typename json_traits::value_type(
+					base::trim<alphabet::base64url>(base::encode<alphabet::base64url>(params.y)));
+				obj_header["epk"] = typename json_traits::value_type(epk);
+			}
+			std::string aad;
+			base::encode_unpadded<alphabet::base64url>(
+				json_traits::serialize(typename json_traits::value_type(obj_header)), aad);
+
+			std::string iv;
+			const auto tag = enc_algo.encrypt(cek, aad, plaintext, iv, ec);
+			if (ec) return {};
+
+			std::string token;
+			token.reserve(aad.size() + base::unpadded_size(encrypted_key.size()) + base::unpadded_size(iv.size()) +
+						  base::unpadded_size(plaintext.size()) + base::unpadded_size(tag.size()) + 4);
+			token += aad;
+			token += '.';
+			base::encode_unpadded<alphabet::base64url>(encrypted_key, token);
+			token += '.';
+			base::encode_unpadded<alphabet::base64url>(iv, token);
+			token += '.';
+			base::encode_unpadded<alphabet::base64url>(plaintext, token);
+			token += '.';
+			base::encode_unpadded<alphabet::base64url>(tag, token);
+			return token;
+		}
+#endif
+
+		/**
+		 * Create a template for minting many tokens with the header of this builder
+		 *
+		 * \param algo Instance of an algorithm to sign the tokens with
+		 * \return Template with the encoded header cached
+		 * \see token_template
+		 */
+		template<typename Algo>
+		token_template<json_traits, Algo> make_template(Algo algo) const {
+			return token_template<json_traits, Algo>(*this, std::move(algo));
+		}
+
+		/**
+		 * Create a prepared builder with the claims of this builder and slots for the claims changing per token
+		 *
+		 * \param algo Instance of an algorithm to sign the tokens with
+		 * \return Prepared builder without slots
+		 * \see prepared_builder
+		 */
+		template<typename Algo>
+		prepared_builder<json_traits, Algo> prepare(Algo algo) const {
+			return prepared_builder<json_traits, Algo>(*this, std::move(algo));
+		}
+#endif
+	};
+
+#ifndef JWT_DISABLE_BASE64
+	/**
+	 * \brief Mints tokens sharing one header
+	 *
+	 * The header of the builder is serialized and base64url encoded once on construction. Minting only serializes
+	 * the payload, and encodes it and the signature directly into one output buffer behind the cached `header.`
+	 * prefix. Payload claims set on the builder are used as defaults for every token.
+	 *
+	 * Use builder::make_template() to create an instance.
+	 */
+	template<typename json_traits, typename Algo>
+	class token_template {
+	public:
+		/**
+		 * Create a template
+		 * \param b Builder providing the header and default payload claims
+		 * \param algo Instance of an algorithm to sign the tokens with
+		 *
+		 * \note If the 'alg' header in not set in the builder it will be set to `algo.name()`
+		 */
+		token_template(const builder<json_traits>& b, Algo algo)
+			: algo(std::move(algo)), default_claims(b.payload_claims) {
+			typename json_traits::object_type header = b.header_claims;
+			if (header.count("alg") == 0) header["alg"] = typename json_traits::value_type(this->algo.name());
+			base::encode_unpadded<alphabet::base64url>(json_traits::serialize(typename json_traits::value_type(header)),
+													   header_prefix);
+			header_prefix += '.';
+		}
+		token_template(const token_template& other)
+			: algo(other.algo), default_claims(other.default_claims), header_prefix(other.header_prefix),
+			  signature_size(other.signature_size.load(std::memory_order_relaxed)) {}
+		token_template& operator=(const token_template&) = delete;
+
+		/**
+		 * Mint a token and append it to a buffer
+		 *
+		 * Reusing the buffer for many tokens avoids allocating the output.
+		 *
+		 * \param claims Payload claims, added to and overriding the default claims of the builder
+		 * \param out Buffer the token is appended to, left unchanged on error
+		 * \param ec error_code filled with details on error
+		 */
+		void mint(const typename json_traits::object_type& claims, std::string& out, std::error_code& ec) const {
+			ec.clear();
+			const auto payload = serialize_payload(claims);
+			const auto offset = out.size();
+			const auto data_size = header_prefix.size() + base::unpadded_size(payload.size());
+			out.reserve(offset + data_size + 1 + base::unpadded_size(signature_size.load(std::memory_order_relaxed)));
+			out += header_prefix;
+			base::encode_unpadded<alphabet::base64url>(payload, out);
+
+			// The algorithms take the signing input as a string, the buffer only holds it when it was empty
+			const auto signature = offset == 0 ? algo.sign(out, ec) : algo.sign(out.substr(offset), ec);
+			if (ec) {
+				out.resize(offset);
+				return;
+			}
+			signature_size.store(signature.size(), std::memory_order_relaxed);
+			out += '.';
+			base::encode_unpadded<alphabet::base64url>(signature, out);
+		}
+
+		/**
+		 * Mint a token
+		 * \param claims Payload claims, added to and overriding the default claims of the builder
+		 * \param ec error_code filled with details on error
+		 * \return Final token as a string
+		 */
+		typename json_traits::string_type mint(const typename json_traits::object_type& claims,
+											   std::error_code& ec) const {
+			std::string res;
+			mint(claims, res, ec);
+			return res;
+		}
+
+		/**
+		 * Mint a token
+		 * \param claims Payload claims, added to and overriding the default claims of the builder
+		 * \return Final token as a string
+		 * \throw std::system_error if signing failed
+		 */
+		typename json_traits::string_type mint(const typename json_traits::object_type& claims) const {
+			std::error_code ec;
+			auto res = mint(claims, ec);
+			error::throw_if_error(ec);
+			return res;
+		}
+
+		/**
+		 * Get the cached encoded header including the trailing '.'
+		 * \return Prefix shared by all minted tokens
+		 */
+		const std::string& get_header_prefix() const noexcept { return header_prefix; }
+
+	private:
+		const Algo algo;
+		const typename json_traits::object_type default_claims;
+		std::string header_prefix;
+		/// Size of the last signature, used to size the output buffer
+		mutable std::atomic<size_t> signature_size{0};
+
+		std::string serialize_payload(const typename json_traits::object_type& claims) const {
+			if (default_claims.empty())
+				return json_traits::serialize(typename json_traits::value_type(claims));
+			typename json_traits::object_type payload = default_claims;
+			for (const auto& c : claims)
+				payload[c.first] = c.second;
+			return json_traits::serialize(typename json_traits::value_type(payload));
+		}
+	};
+#endif
+
+#ifndef JWT_DISABLE_BASE64
+	namespace details {
+		/**
+		 * \brief Incremental base64url encoder without padding
+		 *
+		 * Complete groups of three bytes are encoded into the buffer as they are written, up to two trailing bytes
+		 * are held back until more data arrives or the encoding is finished.
+		 */
+		class base64url_writer {
+		public:
+			void write(const char* data, size_t size) { encode(encoded, carry, carry_size, data, size); }
+			void write(char c) { write(&c, 1); }
+
+			/**
+			 * Append the encoded data followed by the encoding of a tail to another string
+			 * \param out String to append to
+			 * \param tail Last bytes of the data, not written to this writer
+			 */
+			void finish(std::string& out, const std::string& tail) const {
+				out += encoded;
+				auto c = carry;
+				auto size = carry_size;
+				encode(out, c, size, tail.data(), tail.size());
+				if (size == 0) return;
+				if (size == 1) c[1] = 0;
+				const uint32_t triple = (static_cast<uint32_t>(c[0]) << 16) + (static_cast<uint32_t>(c[1]) << 8);
+				const auto& alphabet = alphabet::base64url::data();
+				out += alphabet[(triple >> 18) & 0x3F];
+				out += alphabet[(triple >> 12) & 0x3F];
+				if (size == 2) out += alphabet[(triple >> 6) & 0x3F];
+			}
+
+			/// Number of characters finish() appends for a tail of the given size
+			size_t finished_size(size_t tail_size) const noexcept {
+				return encoded.size() + base::unpadded_size(carry_size + tail_size);
+			}
+
+			/// Forget all data but keep the allocated buffer
+			void clear() noexcept {
+				encoded.clear();
+				carry_size = 0;
+			}
+
+		private:
+			std::string encoded;
+			std::array<unsigned char, 3> carry{};
+			size_t carry_size{0};
+
+			static void encode(std::string& out, std::array<unsigned char, 3>& carry, size_t& carry_size,
+							   const char* data, size_t size) {
+				const auto& alphabet = alphabet::base64url::data();
+				const auto put = [&out, &alphabet](uint32_t triple) {
+					out += alphabet[(triple >> 18) & 0x3F];
+					out += alphabet[(triple >> 12) & 0x3F];
+					out += alphabet[(triple >> 6) & 0x3F];
+					out += alphabet[triple & 0x3F];
+				};
+				const auto byte = [data](size_t i) {
+					return static_cast<uint32_t>(static_cast<unsigned char>(data[i]));
+				};
+				size_t i = 0;
+				while (carry_size != 0 && carry_size < carry.size() && i < size) {
+					carry[carry_size++] = static_cast<unsigned char>(data[i++]);
+					if (carry_size != 3) continue;
+					put((static_cast<uint32_t>(carry[0]) << 16) + (static_cast<uint32_t>(carry[1]) << 8) + carry[2]);
+					carry_size = 0;
+				}
+				if (i == size) return;
+				for (; i + 3 <= size; i += 3)
+					put((byte(i) << 16) + (byte(i + 1) << 8) + byte(i + 2));
+				carry_size = size - i;
+				for (size_t k = 0; k < carry_size; k++)
+					carry[k] = static_cast<unsigned char>(data[i + k]);
+			}
+		};
+
+		/**
+		 * Write an integer as JSON number
+		 * \param out Output providing `write(char)` and `write(const char*, size_t)`
+		 * \param value Number to write
+		 */
+		template<typename Output>
+		void write_json_integer(Output& out, int64_t value) {
+			char buf[20];
+			size_t pos = sizeof(buf);
+			// Work on the negative value, its range covers every int64_t
+			auto v = value < 0 ? value : -value;
+			do {
+				buf[--pos] = static_cast<char>('0' - v % 10);
+				v /= 10;
+			} while (v != 0);
+			if (value < 0) out.write('-');
+			out.write(buf + pos, sizeof(buf) - pos);
+		}
+
+		/**
+		 * Write a string as escaped JSON string, bytes outside of ASCII are copied as is
+		 * \param out Output providing `write(char)` and `write(const char*, size_t)`
+		 * \param str String to write
+		 */
+		template<typename Output>
+		void write_json_string(Output& out, const std::string& str) {
+			static constexpr char hex[] = "0123456789abcdef";
+			out.write('"');
+			size_t start = 0;
+			for (size_t i = 0; i < str.size(); i++) {
+				const auto c = static_cast<unsigned char>(str[i]);
+				if (c >= 0x20 && c != '"' && c != '\\') continue;
+				out.write(str.data() + start, i - start);
+				start = i + 1;
+				switch (c) {
+				case '"': out.write("\\\"", 2); break;
+				case '\\': out.write("\\\\", 2); break;
+				case '\b': out.write("\\b", 2); break;
+				case '\f': out.write("\\f", 2); break;
+				case '\n': out.write("\\n", 2); break;
+				case '\r': out.write("\\r", 2); break;
+				case '\t': out.write("\\t", 2); break;
+				default: {
+					const char escaped[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+					out.write(escaped, sizeof(escaped));
+				}
+				}
+			}
+			out.write(str.data() + start, str.size() - start);
+			out.write('"');
+		}
+
+		/// Output for the JSON writers appending to a string
+		struct string_writer {
+			std::string data;
+
+			void write(const char* str, size_t size) { data.append(str, size); }
+			void write(char c) { data += c; }
+			void clear() noexcept { data.clear(); }
+		};
+
+		/**
+		 * \brief Writes the members of one JSON object as text
+		 *
+		 * Values are escaped and formatted as they are written, there is no document model. The opening brace is
+		 * written with the first member, the closing brace is left to the caller.
+		 */
+		template<typename Output>
+		class json_object_writer {
+		public:
+			void string_member(const std::string& name, const std::string& value) {
+				key(name);
+				write_json_string(out, value);
+			}
+			void integer_member(const std::string& name, int64_t value) {
+				key(name);
+				write_json_integer(out, value);
+			}
+			void bool_member(const std::string& name, bool value) {
+				key(name);
+				if (value)
+					out.write("true", 4);
+				else
+					out.write("false", 5);
+			}
+			void string_array_member(const std::string& name, const std::vector<std::string>& values) {
+				key(name);
+				out.write('[');
+				for (size_t i = 0; i < values.size(); i++) {
+					if (i != 0) out.write(',');
+					write_json_string(out, values[i]);
+				}
+				out.write(']');
+			}
+			void raw_member(const std::string& name, const std::string& json) {
+				key(name);
+				out.write(json.data(), json.size());
+			}
+
+			/// Whether any member was written, and with it the opening brace
+			bool empty() const noexcept { return members == 0; }
+			/// Forget all members, see Output::clear()
+			void clear() noexcept {
+				out.clear();
+				members = 0;
+			}
+			/// Get the text written so far
+			const Output& output() const noexcept { return out; }
+
+		private:
+			Output out;
+			size_t members{0};
+
+			void key(const std::string& name) {
+				out.write(members++ == 0 ? '{' : ',');
+				write_json_string(out, name);
+				out.write(':');
+			}
+		};
+
+		/**
+		 * \brief Validating JSON reader working in place on a document
+		 *
+		 * Base of the scanners that pick single members out of a document without building a DOM. Every method
+		 * throws error::invalid_json_exception on input that is not valid JSON.
+		 */
+		class json_reader {
+		public:
+			/**
+			 * Check if a string holds exactly one JSON value, surrounding whitespace aside
+			 * \param json Text to check
+			 * \return true if the text is valid JSON
+			 */
+			static bool is_value(const std::string& json) {
+				json_reader reader(json);
+				try {
+					reader.skip_value(0);
+					reader.skip_ws();
+				} catch (const error::invalid_json_exception&) { return false; }
+				return reader.pos == json.size();
+			}
+
+		protected:
+			explicit json_reader(const std::string& doc) : doc(doc) {}
+
+			/// Same nesting limit picojson applies by default
+			static constexpr size_t max_depth = 100;
+
+			const std::string& doc;
+			size_t pos{0};
+
+			[[noreturn]] static void fail() { throw error::invalid_json_exception(); }
+
+			char peek() const {
+				if (pos >= doc.size()) fail();
+				return doc[pos];
+			}
+
+			static bool is_ws(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+			void skip_ws() {
+				while (pos < doc.size() && is_ws(doc[pos]))
+					pos++;
+			}
+
+			bool consume(char c) {
+				skip_ws();
+				if (pos < doc.size() && doc[pos] == c) {
+					pos++;
+					return true;
+				}
+				return false;
+			}
+
+			void expect(char c) {
+				if (!consume(c)) fail();
+			}
+
+			void expect_literal(const char* literal) {
+				for (; *literal != '\0'; literal++, pos++)
+					if (pos >= doc.size() || doc[pos] != *literal) fail();
+			}
+
+			unsigned int parse_hex4() {
+				unsigned int res = 0;
+				for (int i = 0; i < 4; i++) {
+					const char c = peek();
+					pos++;
+					res <<= 4;
+					if (c >= '0' && c <= '9')
+						res |= static_cast<unsigned int>(c - '0');
+					else if (c >= 'a' && c <= 'f')
+						res |= static_cast<unsigned int>(c - 'a' + 10);
+					else if (c >= 'A' && c <= 'F')
+						res |= static_cast<unsigned int>(c - 'A' + 10);
+					else
+						fail();
+				}
+				return res;
+			}
+
+			static void append_utf8(std::string& out, unsigned int cp) {
+				if (cp < 0x80) {
+					out += static_cast<char>(cp);
+				} else if (cp < 0x800) {
+					out += static_cast<char>(0xC0 | (cp >> 6));
+					out += static_cast<char>(0x80 | (cp & 0x3F));
+				} else if (cp < 0x10000) {
+					out += static_cast<char>(0xE0 | (cp >> 12));
+					out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+					out += static_cast<char>(0x80 | (cp & 0x3F));
+				} else {
+					out += static_cast<char>(0xF0 | (cp >> 18));
+					out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+					out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+					out += static_cast<char>(0x80 | (cp & 0x3F));
+				}
+			}
+
+			/// Parse a string at the current position, or only validate it if `out` is nullptr
+			void read_string(std::string* out) {
+				if (peek() != '"') fail();
+				pos++;
+				while (true) {
+					const auto c = peek();
+					pos++;
+					if (c == '"') return;
+					if (static_cast<unsigned char>(c) < 0x20) fail();
+					if (c != '\\') {
+						if (out) *out += c;
+						continue;
+					}
+					const auto e = peek();
+					pos++;
+					char decoded = 0;
+					switch (e) {
+					case '"': decoded = '"'; break;
+					case '\\': decoded = '\\'; break;
+					case '/': decoded = '/'; break;
+					case 'b': decoded = '\b'; break;
+					case 'f': decoded = '\f'; break;
+					case 'n': decoded = '\n'; break;
+					case 'r': decoded = '\r'; break;
+					case 't': decoded = '\t'; break;
+					case 'u': {
+						auto cp = parse_hex4();
+						if (cp >= 0xD800 && cp <= 0xDBFF) {
+							expect_literal("\\u");
+							const auto low = parse_hex4();
+							if (low < 0xDC00 || low > 0xDFFF) fail();
+							cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+						} else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+							fail();
+						}
+						if (out) append_utf8(*out, cp);
+						continue;
+					}
+					default: fail();
+					}
+					if (out) *out += decoded;
+				}
+			}
+
+			std::string parse_string() {
+				std::string res;
+				read_string(&res);
+				return res;
+			}
+
+			bool is_digit() const { return pos < doc.size() && doc[pos] >= '0' && doc[pos] <= '9'; }
+
+			void skip_digits() {
+				if (!is_digit()) fail();
+				while (is_digit())
+					pos++;
+			}
+
+			/// Number as in RFC 8259 section 6: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+			void skip_number() {
+				if (pos < doc.size() && doc[pos] == '-') pos++;
+				if (peek() == '0')
+					pos++;
+				else
+					skip_digits();
+				if (pos < doc.size() && doc[pos] == '.') {
+					pos++;
+					skip_digits();
+				}
+				if (pos < doc.size() && (doc[pos] == 'e' || doc[pos] == 'E')) {
+					pos++;
+					if (pos < doc.size() && (doc[pos] == '+' || doc[pos] == '-')) pos++;
+					skip_digits();
+				}
+			}
+
+			void skip_value(size_t depth) {
+				if (depth > max_depth) fail();
+				skip_ws();
+				switch (peek()) {
+				case '"': read_string(nullptr); break;
+				case '{':
+					pos++;
+					if (consume('}')) break;
+					do {
+						skip_ws();
+						read_string(nullptr);
+						expect(':');
+						skip_value(depth + 1);
+					} while (consume(','));
+					expect('}');
+					break;
+				case '[':
+					pos++;
+					if (consume(']')) break;
+					do {
+						skip_value(depth + 1);
+					} while (consume(','));
+					expect(']');
+					break;
+				case 't': expect_literal("true"); break;
+				case 'f': expect_literal("false"); break;
+				case 'n': expect_literal("null"); break;
+				default: skip_number(); break;
+				}
+			}
+		};
+	} // namespace details
+
+	/**
+	 * \brief Builder writing claims straight into the encoded token
+	 *
+	 * Unlike builder, claims are not kept in a JSON document. Every claim is serialized as it is set and the
+	 * result is base64url encoded on the fly, so signing only appends the closing braces and the signature.
+	 * Claims end up in the order they were set. A claim that was already written cannot be replaced, setting it
+	 * again makes sign() fail with error::signature_generation_error::duplicate_claim. Values passed as
+	 * serialized JSON are validated, invalid ones make sign() fail with
+	 * error::signature_generation_error::invalid_claim_json.
+	 *
+	 * Call clear() to start the next token while keeping the allocated buffers.
+	 */
+	class streaming_builder {
+	public:
+		streaming_builder() = default;
+
+		/**
+		 * Set a string header claim
+		 * \param id Name of the claim
+		 * \param value Value of the claim
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_header_claim(const std::string& id, const std::string& value) {
+			if (add_name(header_names, id)) header_writer.string_member(id, value);
+			return *this;
+		}
+		/**
+		 * Set a header claim from serialized JSON
+		 * \param id Name of the claim
+		 * \param json Serialized JSON value, written as is
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_header_claim_json(const std::string& id, const std::string& json) {
+			if (check_json(json) && add_name(header_names, id)) header_writer.raw_member(id, json);
+			return *this;
+		}
+		/**
+		 * Set a string payload claim
+		 * \param id Name of the claim
+		 * \param value Value of the claim
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_payload_claim(const std::string& id, const std::string& value) {
+			if (add_name(payload_names, id)) payload_writer.string_member(id, value);
+			return *this;
+		}
+		/**
+		 * Set a string payload claim
+		 * \param id Name of the claim
+		 * \param value Value of the claim
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_payload_claim(const std::string& id, const char* value) {
+			return set_payload_claim(id, std::string(value));
+		}
+		/**
+		 * Set an integer payload claim
+		 * \param id Name of the claim
+		 * \param value Value of the claim, written as a signed 64 bit number
+		 * \return *this to allow for method chaining
+		 */
+		template<typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value,
+													 int>::type = 0>
+		streaming_builder& set_payload_claim(const std::string& id, T value) {
+			if (add_name(payload_names, id)) payload_writer.integer_member(id, static_cast<int64_t>(value));
+			return *this;
+		}
+		/**
+		 * Set a boolean payload claim
+		 * \param id Name of the claim
+		 * \param value Value of the claim
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_payload_claim(const std::string& id, bool value) {
+			if (add_name(payload_names, id)) payload_writer.bool_member(id, value);
+			return *this;
+		}
+		/**
+		 * Set a date payload claim, written as seconds since the epoch
+		 * \param id Name of the claim
+		 * \param value Value of the claim
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_payload_claim(const std::string& id, const date& value) {
+			const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(value.time_since_epoch()).count();
+			return set_payload_claim(id, static_cast<int64_t>(seconds));
+		}
+		/**
+		 * Set a string array payload claim
+		 * \param id Name of the claim
+		 * \param values Values of the claim
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_payload_claim(const std::string& id, const std::vector<std::string>& values) {
+			if (add_name(payload_names, id)) payload_writer.string_array_member(id, values);
+			return *this;
+		}
+		/**
+		 * Set a payload claim from serialized JSON
+		 * \param id Name of the claim
+		 * \param json Serialized JSON value, written as is
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_payload_claim_json(const std::string& id, const std::string& json) {
+			if (check_json(json) && add_name(payload_names, id)) payload_writer.raw_member(id, json);
+			return *this;
+		}
+
+		/**
+		 * \brief Set algorithm claim
+		 * You normally don't need to do this, as the algorithm is automatically set if you don't change it.
+		 *
+		 * \param str Name of algorithm
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_algorithm(const std::string& str) { return set_header_claim("alg", str); }
+		/**
+		 * Set type claim
+		 * \param str Type to set
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_type(const std::string& str) { return set_header_claim("typ", str); }
+		/**
+		 * Set content type claim
+		 * \param str Type to set
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_content_type(const std::string& str) { return set_header_claim("cty", str); }
+		/**
+		 * Set key id claim
+		 * \param str Key id to set
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_key_id(const std::string& str) { return set_header_claim("kid", str); }
+		/**
+		 * Set issuer claim
+		 * \param str Issuer to set
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_issuer(const std::string& str) { return set_payload_claim("iss", str); }
+		/**
+		 * Set subject claim
+		 * \param str Subject to set
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_subject(const std::string& str) { return set_payload_claim("sub", str); }
+		/**
+		 * Set audience claim
+		 * \param aud Single audience
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_audience(const std::string& aud) { return set_payload_claim("aud", aud); }
+		/**
+		 * Set audience claim
+		 * \param aud Audience set
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_audience(const std::vector<std::string>& aud) { return set_payload_claim("aud", aud); }
+		/**
+		 * Set expires at claim
+		 * \param d Expires time
+		 * \return *this to allow for method chaining
+		 */
+		streaming_builder& set_expires_at(const date& d) { return set_payload_claim("exp", d); }
+		/**
 		 * Set not before claim
 		 * \param d First valid time
 		 * \return *this to allow for method chaining
 		 */
-		builder& set_not_before(const date& d) { return set_payload_claim("nbf", basic_claim<json_traits>(d)); }
+		streaming_builder& set_not_before(const date& d) { return set_payload_claim("nbf", d); }
 		/**
 		 * Set issued at claim
 		 * \param d Issued at time, should be current time
 		 * \return *this to allow for method chaining
 		 */
-		builder& set_issued_at(const date& d) { return set_payload_claim("iat", basic_claim<json_traits>(d)); }
+		streaming_builder& set_issued_at(const date& d) { return set_payload_claim("iat", d); }
 		/**
 		 * Set id claim
 		 * \param str ID to set
 		 * \return *this to allow for method chaining
 		 */
-		builder& set_id(const typename json_traits::string_type& str) {
-			return set_payload_claim("jti", typename json_traits::value_type(str));
+		streaming_builder& set_id(const std::string& str) { return set_payload_claim("jti", str); }
+
+		/**
+		 * Remove all claims, keeping the allocated buffers for the next token
+		 */
+		void clear() noexcept {
+			header_writer.clear();
+			payload_writer.clear();
+			header_names.clear();
+			payload_names.clear();
+			misuse.clear();
+		}
+
+		/**
+		 * Sign token and return result
+		 * \param algo Instance of an algorithm to sign the token with
+		 * \param ec error_code filled with details on error
+		 * \return Final token as a string
+		 *
+		 * \note If the 'alg' header in not set it will be set to `algo.name()`
+		 */
+		template<typename Algo>
+		std::string sign(const Algo& algo, std::error_code& ec) const {
+			ec = misuse;
+			if (ec) return {};
+			std::string header_tail;
+			if (std::find(header_names.begin(), header_names.end(), "alg") == header_names.end()) {
+				header_tail += header_writer.empty() ? "{\"alg\":\"" : ",\"alg\":\"";
+				header_tail += algo.name();
+				header_tail += '"';
+			}
+			header_tail += '}';
+			const std::string payload_tail = payload_writer.empty() ? "{}" : "}";
+
+			const auto& header = header_writer.output();
+			const auto& payload = payload_writer.output();
+			std::string token;
+			token.reserve(header.finished_size(header_tail.size()) + payload.finished_size(payload_tail.size()) + 1);
+			header.finish(token, header_tail);
+			token += '.';
+			payload.finish(token, payload_tail);
+
+			const auto signature = algo.sign(token, ec);
+			if (ec) return {};
+			token += '.';
+			base::encode_unpadded<alphabet::base64url>(signature, token);
+			return token;
+		}
+
+		/**
+		 * Sign token and return result
+		 * \param algo Instance of an algorithm to sign the token with
+		 * \return Final token as a string
+		 * \throw std::system_error if signing failed
+		 */
+		template<typename Algo>
+		std::string sign(const Algo& algo) const {
+			std::error_code ec;
+			auto res = sign(algo, ec);
+			error::throw_if_error(ec);
+			return res;
+		}
+
+	private:
+		details::json_object_writer<details::base64url_writer> header_writer;
+		details::json_object_writer<details::base64url_writer> payload_writer;
+		std::vector<std::string> header_names;
+		std::vector<std::string> payload_names;
+		/// First misuse of the setters, reported by sign()
+		std::error_code misuse;
+
+		// Claims are few, a linear search beats hashing them
+		bool add_name(std::vector<std::string>& names, const std::string& id) {
+			if (std::find(names.begin(), names.end(), id) != names.end()) {
+				if (!misuse) misuse = error::signature_generation_error::duplicate_claim;
+				return false;
+			}
+			names.push_back(id);
+			return true;
+		}
+
+		bool check_json(const std::string& json) {
+			if (details::json_reader::is_value(json)) return true;
+			if (!misuse) misuse = error::signature_generation_error::invalid_claim_json;
+			return false;
+		}
+	};
+
+	/**
+	 * \brief Builder with a fixed claim layout and slots updated in place
+	 *
+	 * The header and the claims of the builder it was created from are rendered once. Claims that change per
+	 * token, like `iat`, `exp`, `jti` or `sub`, are declared as slots. Setting a slot only formats its value,
+	 * signing splices the slot values behind the pre-rendered claims, encodes and signs. The leading part of the
+	 * payload that never changes is kept base64url encoded as well. Slots that are not set are left out.
+	 *
+	 * Use builder::prepare() to create an instance. An instance is not thread safe, use one per thread.
+	 */
+	template<typename json_traits, typename Algo>
+	class prepared_builder {
+	public:
+		/// Handle of a slot holding a date, written as seconds since the epoch
+		struct date_slot {
+			size_t index;
+		};
+		/// Handle of a slot holding a string
+		struct string_slot {
+			size_t index;
+		};
+
+		/**
+		 * Create a prepared builder without slots
+		 * \param b Builder providing the header and the constant payload claims
+		 * \param algo Instance of an algorithm to sign the tokens with
+		 *
+		 * \note If the 'alg' header in not set in the builder it will be set to `algo.name()`
+		 */
+		prepared_builder(const builder<json_traits>& b, Algo algo)
+			: algo(std::move(algo)), constant_claims(b.payload_claims) {
+			header_prefix = token_template<json_traits, Algo>(b, this->algo).get_header_prefix();
+			render_constant();
+		}
+
+		/**
+		 * Add a slot for a date claim, replacing a constant claim of the same name
+		 * \param name Name of the claim
+		 * \return Handle to set the slot with
+		 */
+		date_slot add_date_slot(const typename json_traits::string_type& name) { return {add_slot(name)}; }
+		/**
+		 * Add a slot for a string claim, replacing a constant claim of the same name
+		 * \param name Name of the claim
+		 * \return Handle to set the slot with
+		 */
+		string_slot add_string_slot(const typename json_traits::string_type& name) { return {add_slot(name)}; }
+
+		/**
+		 * Set the value of a date slot
+		 * \param slot Slot to set
+		 * \param d Value of the claim
+		 * \return *this to allow for method chaining
+		 */
+		prepared_builder& set(date_slot slot, const date& d) {
+			auto& s = slots.at(slot.index);
+			s.value.clear();
+			const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(d.time_since_epoch()).count();
+			details::write_json_integer(s.value, static_cast<int64_t>(seconds));
+			s.is_set = true;
+			return *this;
+		}
+		/**
+		 * Set the value of a string slot
+		 * \param slot Slot to set
+		 * \param str Value of the claim
+		 * \return *this to allow for method chaining
+		 */
+		prepared_builder& set(string_slot slot, const std::string& str) {
+			auto& s = slots.at(slot.index);
+			s.value.clear();
+			details::write_json_string(s.value, str);
+			s.is_set = true;
+			return *this;
+		}
+		/**
+		 * Leave a date slot out of the following tokens
+		 * \param slot Slot to clear
+		 * \return *this to allow for method chaining
+		 */
+		prepared_builder& unset(date_slot slot) {
+			slots.at(slot.index).is_set = false;
+			return *this;
+		}
+		/**
+		 * Leave a string slot out of the following tokens
+		 * \param slot Slot to clear
+		 * \return *this to allow for method chaining
+		 */
+		prepared_builder& unset(string_slot slot) {
+			slots.at(slot.index).is_set = false;
+			return *this;
 		}
 
 		/**
-		 * Sign token and return result
-		 * \tparam Algo Callable method which takes a string_type and return the signed input as a string_type
-		 * \tparam Encode Callable method which takes a string_type and base64url safe encodes it,
-		 * MUST return the result with no padding; trim the result.
-		 * \param algo Instance of an algorithm to sign the token with
-		 * \param encode Callable to transform the serialized json to base64 with no padding
+		 * Sign a token with the current slot values and append it to a buffer
+		 * \param out Buffer the token is appended to, left unchanged on error
+		 * \param ec error_code filled with details on error
+		 */
+		void sign(std::string& out, std::error_code& ec) {
+			ec.clear();
+			payload.clear();
+			payload.write(constant_tail.data(), constant_tail.size());
+			bool first = constant_members.empty();
+			for (const auto& s : slots) {
+				if (!s.is_set) continue;
+				if (!first) payload.write(',');
+				first = false;
+				payload.write(s.key.data(), s.key.size());
+				payload.write(s.value.data.data(), s.value.data.size());
+			}
+			payload.write('}');
+
+			const auto offset = out.size();
+			out.reserve(offset + header_prefix.size() + constant_head.size() +
+						base::unpadded_size(payload.data.size()) + 1 + base::unpadded_size(signature_size));
+			out += header_prefix;
+			out += constant_head;
+			base::encode_unpadded<alphabet::base64url>(payload.data, out);
+
+			const auto signature = offset == 0 ? algo.sign(out, ec) : algo.sign(out.substr(offset), ec);
+			if (ec) {
+				out.resize(offset);
+				return;
+			}
+			signature_size = signature.size();
+			out += '.';
+			base::encode_unpadded<alphabet::base64url>(signature, out);
+		}
+
+		/**
+		 * Sign a token with the current slot values
+		 * \param ec error_code filled with details on error
 		 * \return Final token as a string
-		 *
-		 * \note If the 'alg' header in not set in the token it will be set to `algo.name()`
 		 */
-		template<typename Algo, typename Encode>
-		typename json_traits::string_type sign(const Algo& algo, Encode encode) const {
-			std::error_code ec;
-			auto res = sign(algo, encode, ec);
-			error::throw_if_error(ec);
+		std::string sign(std::error_code& ec) {
+			std::string res;
+			sign(res, ec);
 			return res;
 		}
-#ifndef JWT_DISABLE_BASE64
+
 		/**
-		 * Sign token and return result
-		 *
-		 * using the `jwt::base` functions provided
-		 *
-		 * \param algo Instance of an algorithm to sign the token with
+		 * Sign a token with the current slot values
 		 * \return Final token as a string
+		 * \throw std::system_error if signing failed
 		 */
-		template<typename Algo>
-		typename json_traits::string_type sign(const Algo& algo) const {
+		std::string sign() {
 			std::error_code ec;
-			auto res = sign(algo, ec);
+			auto res = sign(ec);
 			error::throw_if_error(ec);
 			return res;
 		}
-#endif
 
-		/**
-		 * Sign token and return result
-		 * \tparam Algo Callable method which takes a string_type and return the signed input as a string_type
-		 * \tparam Encode Callable method which takes a string_type and base64url safe encodes it,
-		 * MUST return the result with no padding; trim the result.
-		 * \param algo Instance of an algorithm to sign the token with
-		 * \param encode Callable to transform the serialized json to base64 with no padding
-		 * \param ec error_code filled with details on error
-		 * \return Final token as a string
-		 *
-		 * \note If the 'alg' header in not set in the token it will be set to `algo.name()`
-		 */
-		template<typename Algo, typename Encode>
-		typename json_traits::string_type sign(const Algo& algo, Encode encode, std::error_code& ec) const {
-			// make a copy such that a builder can be re-used
-			typename json_traits::object_type obj_header = header_claims;
-			if (header_claims.count("alg") == 0) obj_header["alg"] = typename json_traits::value_type(algo.name());
+	private:
+		struct slot_data {
+			/// Rendered `"name":`
+			std::string key;
+			details::string_writer value;
+			bool is_set;
+		};
 
-			const auto header = encode(json_traits::serialize(typename json_traits::value_type(obj_header)));
-			const auto payload = encode(json_traits::serialize(typename json_traits::value_type(payload_claims)));
-			const auto token = header + "." + payload;
+		const Algo algo;
+		typename json_traits::object_type constant_claims;
+		std::string header_prefix;
+		/// Constant claims rendered as `"a":1,"b":2`
+		std::string constant_members;
+		/// Encoding of the first bytes of `{` followed by the constant claims, a multiple of three bytes long
+		std::string constant_head;
+		/// Bytes of `{` followed by the constant claims not covered by constant_head
+		std::string constant_tail;
+		std::vector<slot_data> slots;
+		/// Payload text behind constant_head, reused between tokens
+		details::string_writer payload;
+		/// Size of the last signature, used to size the output buffer
+		size_t signature_size{0};
+
+		size_t add_slot(const typename json_traits::string_type& name) {
+			details::string_writer key;
+			details::write_json_string(key, name);
+			key.write(':');
+			for (auto& s : slots)
+				if (s.key == key.data) throw std::invalid_argument("duplicate slot " + name);
+			slots.push_back({std::move(key.data), {}, false});
+			if (constant_claims.erase(name) != 0) render_constant();
+			return slots.size() - 1;
+		}
 
-			auto signature = algo.sign(token, ec);
-			if (ec) return {};
+		void render_constant() {
+			const auto json = json_traits::serialize(typename json_traits::value_type(constant_claims));
+			// Strip the braces of the serialized object
+			constant_members = json.size() > 2 ? json.substr(1, json.size() - 2) : std::string{};
+			const auto text = "{" + constant_members;
+			const auto head_size = text.size() - text.size() % 3;
+			constant_head.clear();
+			base::encode_unpadded<alphabet::base64url>(text.substr(0, head_size), constant_head);
+			constant_tail = text.substr(head_size);
+		}
+	};
 
-			return token + "." + encode(signature);
+	/**
+	 * \brief Tokens of a batch stored back to back in one buffer
+	 *
+	 * Filled by sign_batch(). All tokens share one allocation, a token that could not be signed is empty.
+	 * Reusing an instance for many batches keeps its buffers allocated.
+	 */
+	class token_batch {
+	public:
+		/**
+		 * Get the number of tokens
+		 * \return Number of tokens in the batch
+		 */
+		size_t size() const noexcept { return ends.size(); }
+		/**
+		 * Check if there are no tokens
+		 * \return true if the batch is empty
+		 */
+		bool empty() const noexcept { return ends.empty(); }
+		/**
+		 * Get the start of a token inside the shared buffer, the token is not null terminated
+		 * \param i Index of the token
+		 * \return Pointer to the first character of the token
+		 */
+		const char* data(size_t i) const { return buffer.data() + start(i); }
+		/**
+		 * Get the length of a token
+		 * \param i Index of the token
+		 * \return Number of characters, 0 if the token could not be signed
+		 */
+		size_t length(size_t i) const { return ends.at(i) - start(i); }
+		/**
+		 * Copy a token out of the batch
+		 * \param i Index of the token
+		 * \return The token
+		 */
+		std::string get(size_t i) const { return buffer.substr(start(i), length(i)); }
+		/**
+		 * Get the shared buffer holding all tokens in input order
+		 * \return Concatenation of all tokens
+		 */
+		const std::string& get_buffer() const noexcept { return buffer; }
+		/**
+		 * Remove all tokens, keeping the buffers allocated
+		 */
+		void clear() noexcept {
+			buffer.clear();
+			ends.clear();
 		}
-#ifndef JWT_DISABLE_BASE64
+
 		/**
-		 * Sign token and return result
+		 * Fill the batch by calling `sign(i, out, ec)` for every index in parallel
 		 *
-		 * using the `jwt::base` functions provided
+		 * `sign` must append the token with index i to `out` and leave `out` unchanged on error.
 		 *
-		 * \param algo Instance of an algorithm to sign the token with
-		 * \param ec error_code filled with details on error
-		 * \return Final token as a string
+		 * \param count Number of tokens
+		 * \param sign Callable signing a single token
+		 * \param ec Resized to the number of tokens and filled with the result of each token, in input order
+		 * \param exec Executor to run the work on, the calling thread takes part as well
 		 */
-		template<typename Algo>
-		typename json_traits::string_type sign(const Algo& algo, std::error_code& ec) const {
-			return sign(
-				algo,
-				[](const typename json_traits::string_type& data) {
-					return base::trim<alphabet::base64url>(base::encode<alphabet::base64url>(data));
-				},
-				ec);
+		template<typename Sign>
+		void fill(size_t count, const Sign& sign, std::vector<std::error_code>& ec, executor& exec) {
+			clear();
+			ec.assign(count, std::error_code{});
+			ends.resize(count);
+			// Every chunk of the batch is signed into its own scratch buffer, which are joined in order afterwards
+			const auto chunks = (count + details::batch_chunk_size - 1) / details::batch_chunk_size;
+			if (scratch.size() < chunks) scratch.resize(chunks);
+			details::parallel_for(exec, count, details::batch_chunk_size, details::batch_helpers(exec),
+								  [&](size_t begin, size_t end) {
+									  auto& out = scratch[begin / details::batch_chunk_size];
+									  out.clear();
+									  for (size_t i = begin; i < end; i++) {
+										  sign(i, out, ec[i]);
+										  ends[i] = out.size();
+									  }
+								  });
+
+			size_t total = 0;
+			for (size_t c = 0; c < chunks; c++)
+				total += scratch[c].size();
+			buffer.reserve(total);
+			for (size_t i = 0; i < count; i++) {
+				if (i % details::batch_chunk_size == 0) buffer += scratch[i / details::batch_chunk_size];
+				ends[i] += buffer.size() - scratch[i / details::batch_chunk_size].size();
+			}
 		}
-#endif
+
+	private:
+		std::string buffer;
+		/// End offset of every token in buffer
+		std::vector<size_t> ends;
+		/// Per chunk buffers kept between batches
+		std::vector<std::string> scratch;
+
+		size_t start(size_t i) const { return i == 0 ? 0 : ends.at(i - 1); }
 	};
 
+	namespace details {
+		template<typename Sign>
+		void sign_each(size_t count, const Sign& sign, token_batch& out, std::vector<std::error_code>& ec,
+					   executor& exec) {
+			out.fill(count, sign, ec, exec);
+		}
+
+		template<typename Sign>
+		void sign_each(size_t count, const Sign& sign, std::vector<std::string>& out, std::vector<std::error_code>& ec,
+					   executor& exec) {
+			ec.assign(count, std::error_code{});
+			out.resize(count);
+			parallel_for(exec, count, batch_chunk_size, batch_helpers(exec), [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					out[i].clear();
+					sign(i, out[i], ec[i]);
+				}
+			});
+		}
+	} // namespace details
+
+	/**
+	 * Sign a batch of tokens in parallel
+	 *
+	 * The builders are serialized, encoded and signed on the executor, every token is written straight into
+	 * the output. The algorithm is shared by all threads, the builders must not be modified while the batch runs.
+	 *
+	 * \param builders Builders of the tokens to sign
+	 * \param algo Instance of an algorithm to sign the tokens with
+	 * \param out Either a token_batch storing all tokens in one buffer, or a `std::vector<std::string>` whose
+	 * strings are reused as per-token buffers. Tokens are in input order, failed tokens are empty.
+	 * \param ec Resized to the number of tokens and filled with the result of each token, in input order
+	 * \param exec Executor to run the work on, the calling thread takes part as well
+	 */
+	template<typename json_traits, typename Algo, typename Output>
+	void sign_batch(const std::vector<builder<json_traits>>& builders, const Algo& algo, Output& out,
+					std::vector<std::error_code>& ec, executor& exec) {
+		details::sign_each(
+			builders.size(),
+			[&](size_t i, std::string& token, std::error_code& e) { builders[i].sign(algo, token, e); }, out, ec,
+			exec);
+	}
+
+	/**
+	 * Sign a batch of tokens in parallel on the default thread pool
+	 * \param builders Builders of the tokens to sign
+	 * \param algo Instance of an algorithm to sign the tokens with
+	 * \param out Either a token_batch or a `std::vector<std::string>` receiving the tokens in input order
+	 * \param ec Resized to the number of tokens and filled with the result of each token, in input order
+	 */
+	template<typename json_traits, typename Algo, typename Output>
+	void sign_batch(const std::vector<builder<json_traits>>& builders, const Algo& algo, Output& out,
+					std::vector<std::error_code>& ec) {
+		sign_batch(builders, algo, out, ec, thread_pool::get_default());
+	}
+
+	/**
+	 * Mint a batch of tokens from a list of payloads in parallel
+	 *
+	 * Every token uses the cached header of the template, see token_template::mint().
+	 *
+	 * \param tmpl Template providing the header, default claims and algorithm
+	 * \param payloads Payload claims of the tokens
+	 * \param out Either a token_batch storing all tokens in one buffer, or a `std::vector<std::string>` whose
+	 * strings are reused as per-token buffers. Tokens are in input order, failed tokens are empty.
+	 * \param ec Resized to the number of tokens and filled with the result of each token, in input order
+	 * \param exec Executor to run the work on, the calling thread takes part as well
+	 */
+	template<typename json_traits, typename Algo, typename Output>
+	void sign_batch(const token_template<json_traits, Algo>& tmpl,
+					const std::vector<typename json_traits::object_type>& payloads, Output& out,
+					std::vector<std::error_code>& ec, executor& exec) {
+		details::sign_each(
+			payloads.size(),
+			[&](size_t i, std::string& token, std::error_code& e) { tmpl.mint(payloads[i], token, e); }, out, ec,
+			exec);
+	}
+
+	/**
+	 * Mint a batch of tokens from a list of payloads in parallel on the default thread pool
+	 * \param tmpl Template providing the header, default claims and algorithm
+	 * \param payloads Payload claims of the tokens
+	 * \param out Either a token_batch or a `std::vector<std::string>` receiving the tokens in input order
+	 * \param ec Resized to the number of tokens and filled with the result of each token, in input order
+	 */
+	template<typename json_traits, typename Algo, typename Output>
+	void sign_batch(const token_template<json_traits, Algo>& tmpl,
+					const std::vector<typename json_traits::object_type>& payloads, Output& out,
+					std::vector<std::error_code>& ec) {
+		sign_batch(tmpl, payloads, out, ec, thread_pool::get_default());
+	}
+#endif
+
+	namespace details {
+		/**
+		 * \brief Immutable set of strings using open addressing
+		 *
+		 * Built once and then only probed, entries live in one contiguous table with linear probing and a load
+		 * factor of at most one half.
+		 */
+		template<typename String>
+		class hashed_string_set {
+		public:
+			hashed_string_set() = default;
+
+			template<typename Iterator>
+			hashed_string_set(Iterator begin, Iterator end) {
+				size_t capacity = 4;
+				while (capacity < 2 * static_cast<size_t>(std::distance(begin, end)))
+					capacity <<= 1;
+				slots.resize(capacity);
+				for (; begin != end; ++begin)
+					insert(*begin);
+			}
+
+			bool contains(const String& value) const {
+				if (slots.empty()) return false;
+				const auto h = std::hash<String>{}(value);
+				for (size_t i = h & (slots.size() - 1);; i = (i + 1) & (slots.size() - 1)) {
+					const auto& s = slots[i];
+					if (!s.used) return false;
+					if (s.hash == h && s.value == value) return true;
+				}
+			}
+
+			size_t size() const noexcept { return count; }
+
+		private:
+			struct slot {
+				bool used{false};
+				size_t hash{0};
+				String value;
+			};
+			std::vector<slot> slots;
+			size_t count{0};
+
+			void insert(const String& value) {
+				const auto h = std::hash<String>{}(value);
+				for (size_t i = h & (slots.size() - 1);; i = (i + 1) & (slots.size() - 1)) {
+					auto& s = slots[i];
+					if (s.used) {
+						if (s.hash == h && s.value == value) return;
+						continue;
+					}
+					s.used = true;
+					s.hash = h;
+					s.value = value;
+					count++;
+					return;
+				}
+			}
+		};
+	} // namespace details
+
 	namespace verify_ops {
 		template<typename json_traits>
 		struct verify_context {
-			verify_context(date ctime, const decoded_jwt<json_traits>& j, size_t l)
-				: current_time(ctime), jwt(j), default_leeway(l) {}
+			verify_context(date ctime, const decoded_jwt<json_traits>& j, size_t l) : verify_context(ctime, j, j, l) {}
+			verify_context(date ctime, const decoded_jwt<json_traits>& j, const header<json_traits>& h, size_t l)
+				: current_time(ctime), jwt(j), hdr(h), default_leeway(l) {}
 			// Current time, retrieved from the verifiers clock and cached for performance and consistency
 			date current_time;
 			// The jwt passed to the verifier
 			const decoded_jwt<json_traits>& jwt;
+			// The header claims are read from, the signed header of a JWS in JSON serialization
+			const header<json_traits>& hdr;
 			// The configured default leeway for this verification
 			size_t default_leeway{0};
 
@@ -1134,11 +3721,11 @@ namespace jwt {
 			// Helper method to get a claim from the jwt in this context
 			basic_claim<json_traits> get_claim(bool in_header, std::error_code& ec) const {
 				if (in_header) {
-					if (!jwt.has_header_claim(claim_key)) {
+					if (!hdr.has_header_claim(claim_key)) {
 						ec = error::token_verification_error::missing_claim;
 						return {};
 					}
-					return jwt.get_header_claim(claim_key);
+					return hdr.get_header_claim(claim_key);
 				} else {
 					if (!jwt.has_payload_claim(claim_key)) {
 						ec = error::token_verification_error::missing_claim;
@@ -1156,6 +3743,23 @@ namespace jwt {
 				}
 				return c;
 			}
+			// Helper method to access a claim of the jwt in this context without copying it
+			const typename json_traits::value_type* get_claim_json(bool in_header, std::error_code& ec) const {
+				const auto* value =
+					in_header ? hdr.find_header_claim(claim_key) : jwt.find_payload_claim(claim_key);
+				if (value == nullptr) ec = error::token_verification_error::missing_claim;
+				return value;
+			}
+			const typename json_traits::value_type* get_claim_json(bool in_header, json::type t,
+																   std::error_code& ec) const {
+				const auto* value = get_claim_json(in_header, ec);
+				if (ec) return nullptr;
+				if (json_traits::get_type(*value) != t) {
+					ec = error::token_verification_error::claim_type_missmatch;
+					return nullptr;
+				}
+				return value;
+			}
 			basic_claim<json_traits> get_claim(std::error_code& ec) const { return get_claim(false, ec); }
 			basic_claim<json_traits> get_claim(json::type t, std::error_code& ec) const {
 				return get_claim(false, t, ec);
@@ -1164,22 +3768,37 @@ namespace jwt {
 
 		/**
 		 * This is the default operation and does case sensitive matching
+		 *
+		 * Arrays and objects are compared structurally with `json_traits::equals` when the traits provide it,
+		 * otherwise against a serialization of the expected value prepared once at construction.
 		 */
 		template<typename json_traits, bool in_header = false>
 		struct equals_claim {
 			const basic_claim<json_traits> expected;
+
+			equals_claim(basic_claim<json_traits> e)
+				: expected(std::move(e)), expected_json(expected.to_json()),
+				  expected_serialized(serialize_expected(
+					  expected_json, std::integral_constant<bool, has_equals>{})) {}
+
 			void operator()(const verify_context<json_traits>& ctx, std::error_code& ec) const {
-				auto jc = ctx.get_claim(in_header, expected.get_type(), ec);
+				const auto type = expected.get_type();
+				if (type == json::type::array || type == json::type::object) {
+					const auto* value = ctx.get_claim_json(in_header, type, ec);
+					if (ec) return;
+					if (!structurally_equal(*value, std::integral_constant<bool, has_equals>{}))
+						ec = error::token_verification_error::claim_value_missmatch;
+					return;
+				}
+
+				auto jc = ctx.get_claim(in_header, type, ec);
 				if (ec) return;
 				const bool matches = [&]() {
-					switch (expected.get_type()) {
+					switch (type) {
 					case json::type::boolean: return expected.as_bool() == jc.as_bool();
 					case json::type::integer: return expected.as_int() == jc.as_int();
 					case json::type::number: return expected.as_number() == jc.as_number();
 					case json::type::string: return expected.as_string() == jc.as_string();
-					case json::type::array:
-					case json::type::object:
-						return json_traits::serialize(expected.to_json()) == json_traits::serialize(jc.to_json());
 					default: throw std::logic_error("internal error, should be unreachable");
 					}
 				}();
@@ -1188,6 +3807,31 @@ namespace jwt {
 					return;
 				}
 			}
+
+		private:
+			static constexpr bool has_equals =
+				details::supports_equals<json_traits, typename json_traits::value_type>::value;
+
+			const typename json_traits::value_type expected_json;
+			const typename json_traits::string_type expected_serialized;
+
+			static typename json_traits::string_type serialize_expected(const typename json_traits::value_type&,
+																		std::true_type) {
+				return {};
+			}
+			static typename json_traits::string_type serialize_expected(const typename json_traits::value_type& val,
+																		std::false_type) {
+				const auto type = json_traits::get_type(val);
+				if (type != json::type::array && type != json::type::object) return {};
+				return json_traits::serialize(val);
+			}
+
+			bool structurally_equal(const typename json_traits::value_type& val, std::true_type) const {
+				return json_traits::equals(expected_json, val);
+			}
+			bool structurally_equal(const typename json_traits::value_type& val, std::false_type) const {
+				return json_traits::serialize(val) == expected_serialized;
+			}
 		};
 
 		/**
@@ -1256,38 +3900,220 @@ namespace jwt {
 		};
 
 		/**
-		 * Checks if the claim is a string and does an case insensitive comparison.
+		 * Checks that at least one of the values of the claim is in the set of allowed values.
+		 * The claim can either be a single string or an array of strings, any other element fails the check.
+		 */
+		template<typename json_traits, bool in_header = false>
+		struct is_any_of_claim {
+			const details::hashed_string_set<typename json_traits::string_type> allowed;
+			void operator()(const verify_context<json_traits>& ctx, std::error_code& ec) const {
+				const auto* c = ctx.get_claim_json(in_header, ec);
+				if (ec) return;
+				typename json_traits::string_type str_storage;
+				const auto type = json_traits::get_type(*c);
+				if (type == json::type::string) {
+					if (!allowed.contains(details::string_ref<json_traits>(*c, str_storage)))
+						ec = error::token_verification_error::audience_missmatch;
+				} else if (type == json::type::array) {
+					typename json_traits::array_type arr_storage;
+					const auto& arr = details::array_ref<json_traits>(*c, arr_storage);
+					for (const auto& e : arr) {
+						if (json_traits::get_type(e) != json::type::string) {
+							ec = error::token_verification_error::claim_type_missmatch;
+							return;
+						}
+					}
+					for (const auto& e : arr)
+						if (allowed.contains(details::string_ref<json_traits>(e, str_storage))) return;
+					ec = error::token_verification_error::audience_missmatch;
+				} else {
+					ec = error::token_verification_error::claim_type_missmatch;
+				}
+			}
+		};
+
+		/**
+		 * Checks if the claim is a string and does an case insensitive comparison.
+		 */
+		template<typename json_traits, bool in_header = false>
+		struct insensitive_string_claim {
+			const typename json_traits::string_type expected;
+			std::locale locale;
+			insensitive_string_claim(const typename json_traits::string_type& e, std::locale loc)
+				: expected(to_lower_unicode(e, loc)), locale(loc), ascii_fast_path(folds_ascii_to_ascii(loc)) {}
+
+			void operator()(const verify_context<json_traits>& ctx, std::error_code& ec) const {
+				const auto c = ctx.get_claim(in_header, json::type::string, ec);
+				if (ec) return;
+				if (!matches(c.as_string())) { ec = error::token_verification_error::claim_value_missmatch; }
+			}
+
+			/**
+			 * Compare a value against the expected one, ignoring case.
+			 *
+			 * ASCII input is folded byte by byte without allocating, the full Unicode conversion is only used
+			 * once a non ASCII byte is found or if the locale does not map ASCII letters onto ASCII letters.
+			 */
+			bool matches(const std::string& str) const {
+				if (!ascii_fast_path) return to_lower_unicode(str, locale) == expected;
+				for (size_t i = 0; i < str.size(); i++) {
+					const auto c = static_cast<unsigned char>(str[i]);
+					if (c >= 0x80) return to_lower_unicode(str, locale) == expected;
+					// ASCII characters fold to a single ASCII byte, so a differing prefix can never match
+					if (i >= expected.size() || fold_ascii(c) != static_cast<unsigned char>(expected[i])) return false;
+				}
+				return str.size() == expected.size();
+			}
+
+			static std::string to_lower_unicode(const std::string& str, const std::locale& loc) {
+				std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> conv;
+				auto wide = conv.from_bytes(str);
+				auto& f = std::use_facet<std::ctype<wchar_t>>(loc);
+				f.toupper(&wide[0], &wide[0] + wide.size());
+				return conv.to_bytes(wide);
+			}
+
+		private:
+			const bool ascii_fast_path;
+
+			static unsigned char fold_ascii(unsigned char c) {
+				return (c >= 'a' && c <= 'z') ? static_cast<unsigned char>(c - 'a' + 'A') : c;
+			}
+
+			static bool folds_ascii_to_ascii(const std::locale& loc) {
+				auto& f = std::use_facet<std::ctype<wchar_t>>(loc);
+				for (wchar_t c = 0; c < 0x80; c++) {
+					if (f.toupper(c) != static_cast<wchar_t>(fold_ascii(static_cast<unsigned char>(c)))) return false;
+				}
+				return true;
+			}
+		};
+	} // namespace verify_ops
+
+	/**
+	 * \brief A verification algorithm bound to a key id
+	 *
+	 * Wraps any algorithm (e.g. `jwt::crypto::algorithm::rs256`) together with the key id and algorithm name it was
+	 * built for. Instances are immutable and can be shared between threads.
+	 */
+	class verification_key {
+	public:
+		using verify_fn_t = std::function<void(const std::string&, const std::string&, std::error_code&)>;
+		using verify_stream_fn_t =
+			std::function<void(const details::chunk_source&, const std::string&, std::error_code&)>;
+
+		/**
+		 * Construct a new key
+		 * \param kid Key id ("kid") the key was published with
+		 * \param alg Name of the algorithm the key is used with
+		 * \param fingerprint Summary of the key material, used to detect unchanged keys
+		 * \param fn Function checking a signature with this key
+		 * \param stream_fn Function checking the signature of streamed data, if empty the data is collected and
+		 * passed to `fn`
+		 */
+		verification_key(std::string kid, std::string alg, std::string fingerprint, verify_fn_t fn,
+						 verify_stream_fn_t stream_fn = nullptr)
+			: key_id(std::move(kid)), alg_name(std::move(alg)), material(std::move(fingerprint)),
+			  verify_fn(std::move(fn)), verify_stream_fn(std::move(stream_fn)) {}
+
+		/**
+		 * Wrap an algorithm instance
+		 * \param kid Key id ("kid") the key was published with
+		 * \param fingerprint Summary of the key material, used to detect unchanged keys
+		 * \param alg Algorithm to check signatures with
+		 */
+		template<typename Algorithm>
+		static std::shared_ptr<const verification_key> create(std::string kid, std::string fingerprint, Algorithm alg) {
+			auto name = alg.name();
+			return std::make_shared<const verification_key>(
+				std::move(kid), std::move(name), std::move(fingerprint),
+				[alg](const std::string& data, const std::string& sig, std::error_code& ec) {
+					alg.verify(data, sig, ec);
+				},
+				[alg](const details::chunk_source& source, const std::string& sig, std::error_code& ec) {
+					details::verify_stream(alg, source, sig, ec);
+				});
+		}
+
+		/// Get key id claim
+		const std::string& get_key_id() const noexcept { return key_id; }
+		/// Get algorithm name
+		const std::string& get_algorithm() const noexcept { return alg_name; }
+		/// Get the summary of the key material this key was built from
+		const std::string& get_fingerprint() const noexcept { return material; }
+
+		/**
+		 * Check if signature is valid
+		 * \param data The data to check signature against
+		 * \param signature Signature provided by the jwt
+		 * \param ec Filled with details on failure
+		 */
+		void verify(const std::string& data, const std::string& signature, std::error_code& ec) const {
+			verify_fn(data, signature, ec);
+		}
+
+		/**
+		 * Check if the signature of streamed data is valid
+		 * \param source Data the signature was created for
+		 * \param signature Signature provided by the jwt
+		 * \param ec Filled with details on failure
+		 */
+		void verify_stream(const details::chunk_source& source, const std::string& signature,
+						   std::error_code& ec) const {
+			ec.clear();
+			if (verify_stream_fn) {
+				verify_stream_fn(source, signature, ec);
+				return;
+			}
+			std::string data;
+			if (!details::collect(source, data)) {
+				ec = error::signature_verification_error::verifyupdate_failed;
+				return;
+			}
+			verify_fn(data, signature, ec);
+		}
+
+	private:
+		const std::string key_id;
+		const std::string alg_name;
+		const std::string material;
+		const verify_fn_t verify_fn;
+		const verify_stream_fn_t verify_stream_fn;
+	};
+
+	/**
+	 * \brief Number of valid signatures a JWS in JSON serialization needs to pass verification
+	 */
+	class signature_policy {
+	public:
+		/// Require at least one valid signature
+		static signature_policy any() noexcept { return signature_policy(1, false); }
+		/// Require every signature to be valid
+		static signature_policy all() noexcept { return signature_policy(0, true); }
+		/// Require at least `k` valid signatures, `k` of 0 is treated as 1
+		static signature_policy at_least(size_t k) noexcept { return signature_policy(std::max<size_t>(1, k), false); }
+
+		/**
+		 * Get the number of valid signatures required
+		 * \param total Number of signatures of the token
+		 * \return Number of signatures that must be valid, may exceed `total`
 		 */
-		template<typename json_traits, bool in_header = false>
-		struct insensitive_string_claim {
-			const typename json_traits::string_type expected;
-			std::locale locale;
-			insensitive_string_claim(const typename json_traits::string_type& e, std::locale loc)
-				: expected(to_lower_unicode(e, loc)), locale(loc) {}
+		size_t required(size_t total) const noexcept { return every ? total : count; }
 
-			void operator()(const verify_context<json_traits>& ctx, std::error_code& ec) const {
-				const auto c = ctx.get_claim(in_header, json::type::string, ec);
-				if (ec) return;
-				if (to_lower_unicode(c.as_string(), locale) != expected) {
-					ec = error::token_verification_error::claim_value_missmatch;
-				}
-			}
+	private:
+		signature_policy(size_t count, bool every) noexcept : count(count), every(every) {}
 
-			static std::string to_lower_unicode(const std::string& str, const std::locale& loc) {
-				std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> conv;
-				auto wide = conv.from_bytes(str);
-				auto& f = std::use_facet<std::ctype<wchar_t>>(loc);
-				f.toupper(&wide[0], &wide[0] + wide.size());
-				return conv.to_bytes(wide);
-			}
-		};
-	} // namespace verify_ops
+		size_t count;
+		bool every;
+	};
 
 	/**
 	 * Verifier class used to check if a decoded token contains all claims required by your application and has a valid
 	 * signature.
+	 *
+	 * \tparam Observer Receives the time spent checking the signature and each claim, see null_stage_observer
 	 */
-	template<typename Clock, typename json_traits>
+	template<typename Clock, typename json_traits, typename Observer = null_stage_observer>
 	class verifier {
 	public:
 		using basic_claim_t = basic_claim<json_traits>;
@@ -1302,11 +4128,22 @@ namespace jwt {
 		 */
 		using verify_check_fn_t =
 			std::function<void(const verify_ops::verify_context<json_traits>&, std::error_code& ec)>;
+		/**
+		 * Key lookup function
+		 *
+		 * Returns the key for the given key id or nullptr if no such key is known.
+		 */
+		using key_lookup_fn_t =
+			std::function<std::shared_ptr<const verification_key>(const typename json_traits::string_type&)>;
 
 	private:
 		struct algo_base {
 			virtual ~algo_base() = default;
 			virtual void verify(const std::string& data, const std::string& sig, std::error_code& ec) = 0;
+			virtual void verify_stream(const details::chunk_source& source, const std::string& sig,
+									   std::error_code& ec) = 0;
+			virtual void verify_batch(const std::vector<std::string>& data, const std::vector<std::string>& sigs,
+									  std::vector<std::error_code>& ec) = 0;
 		};
 		template<typename T>
 		struct algo : public algo_base {
@@ -1315,6 +4152,14 @@ namespace jwt {
 			void verify(const std::string& data, const std::string& sig, std::error_code& ec) override {
 				alg.verify(data, sig, ec);
 			}
+			void verify_stream(const details::chunk_source& source, const std::string& sig,
+							   std::error_code& ec) override {
+				details::verify_stream(alg, source, sig, ec);
+			}
+			void verify_batch(const std::vector<std::string>& data, const std::vector<std::string>& sigs,
+							  std::vector<std::error_code>& ec) override {
+				details::verify_batch(alg, data, sigs, ec);
+			}
 		};
 		/// Required claims
 		std::unordered_map<typename json_traits::string_type, verify_check_fn_t> claims;
@@ -1324,201 +4169,1076 @@ namespace jwt {
 		Clock clock;
 		/// Supported algorithms
 		std::unordered_map<std::string, std::shared_ptr<algo_base>> algs;
+		/// Keys selected by the "kid" header
+		key_lookup_fn_t key_lookup;
+		/// Receives stage events, if enabled
+		Observer* observer = nullptr;
+		/// Counts verifications and their outcome
+		std::shared_ptr<verification_metrics> metrics;
+		/// Revoked values, each checked against the named payload claim
+		std::vector<std::pair<typename json_traits::string_type, std::shared_ptr<const revocation_list>>> revocations;
 
 	public:
 		/**
-		 * Constructor for building a new verifier instance
-		 * \param c Clock instance
+		 * Constructor for building a new verifier instance
+		 * \param c Clock instance
+		 */
+		explicit verifier(Clock c) : clock(c) {
+			claims["exp"] = [](const verify_ops::verify_context<json_traits>& ctx, std::error_code& ec) {
+				if (!ctx.jwt.has_expires_at()) return;
+				auto exp = ctx.jwt.get_expires_at();
+				if (ctx.current_time > exp + std::chrono::seconds(ctx.default_leeway)) {
+					ec = error::token_verification_error::token_expired;
+				}
+			};
+			claims["iat"] = [](const verify_ops::verify_context<json_traits>& ctx, std::error_code& ec) {
+				if (!ctx.jwt.has_issued_at()) return;
+				auto iat = ctx.jwt.get_issued_at();
+				if (ctx.current_time < iat - std::chrono::seconds(ctx.default_leeway)) {
+					ec = error::token_verification_error::token_expired;
+				}
+			};
+			claims["nbf"] = [](const verify_ops::verify_context<json_traits>& ctx, std::error_code& ec) {
+				if (!ctx.jwt.has_not_before()) return;
+				auto nbf = ctx.jwt.get_not_before();
+				if (ctx.current_time < nbf - std::chrono::seconds(ctx.default_leeway)) {
+					ec = error::token_verification_error::token_expired;
+				}
+			};
+		}
+
+		/**
+		 * Set default leeway to use.
+		 * \param leeway Default leeway to use if not specified otherwise
+		 * \return *this to allow chaining
+		 */
+		verifier& leeway(size_t leeway) {
+			default_leeway = leeway;
+			return *this;
+		}
+		/**
+		 * Set leeway for expires at.
+		 * If not specified the default leeway will be used.
+		 * \param leeway Set leeway to use for expires at.
+		 * \return *this to allow chaining
+		 */
+		verifier& expires_at_leeway(size_t leeway) {
+			claims["exp"] = verify_ops::date_before_claim<json_traits>{leeway};
+			return *this;
+		}
+		/**
+		 * Set leeway for not before.
+		 * If not specified the default leeway will be used.
+		 * \param leeway Set leeway to use for not before.
+		 * \return *this to allow chaining
+		 */
+		verifier& not_before_leeway(size_t leeway) {
+			claims["nbf"] = verify_ops::date_after_claim<json_traits>{leeway};
+			return *this;
+		}
+		/**
+		 * Set leeway for issued at.
+		 * If not specified the default leeway will be used.
+		 * \param leeway Set leeway to use for issued at.
+		 * \return *this to allow chaining
+		 */
+		verifier& issued_at_leeway(size_t leeway) {
+			claims["iat"] = verify_ops::date_after_claim<json_traits>{leeway};
+			return *this;
+		}
+
+		/**
+		 * Set an type to check for.
+		 * Check is casesensitive.
+		 * \param iss Issuer to check for.
+		 * \return *this to allow chaining
+		 */
+		verifier& with_type(const typename json_traits::string_type& type, std::locale locale = std::locale{}) {
+			return with_claim("typ", verify_ops::insensitive_string_claim<json_traits, true>{type, std::move(locale)});
+		}
+
+		/**
+		 * Set an issuer to check for.
+		 * Check is casesensitive.
+		 * \param iss Issuer to check for.
+		 * \return *this to allow chaining
+		 */
+		verifier& with_issuer(const typename json_traits::string_type& iss) {
+			return with_claim("iss", basic_claim_t(iss));
+		}
+
+		/**
+		 * Set a subject to check for.
+		 * Check is casesensitive.
+		 * \param sub Subject to check for.
+		 * \return *this to allow chaining
+		 */
+		verifier& with_subject(const typename json_traits::string_type& sub) {
+			return with_claim("sub", basic_claim_t(sub));
+		}
+		/**
+		 * Set an audience to check for.
+		 * If any of the specified audiences is not present in the token the check fails.
+		 * \param aud Audience to check for.
+		 * \return *this to allow chaining
+		 */
+		verifier& with_audience(const typename basic_claim_t::set_t& aud) {
+			claims["aud"] = verify_ops::is_subset_claim<json_traits>{aud};
+			return *this;
+		}
+		/**
+		 * Set an audience to check for.
+		 * If the specified audiences is not present in the token the check fails.
+		 * \param aud Audience to check for.
+		 * \return *this to allow chaining
+		 */
+		verifier& with_audience(const typename json_traits::string_type& aud) {
+			typename basic_claim_t::set_t s;
+			s.insert(aud);
+			return with_audience(s);
+		}
+		/**
+		 * Set the audiences a token may be issued for.
+		 * The check succeeds if at least one audience of the token is in the given set. The set is hashed
+		 * once here, so large sets do not slow down verification.
+		 * \param aud Allowed audiences
+		 * \return *this to allow chaining
+		 */
+		verifier& with_any_audience(const typename basic_claim_t::set_t& aud) {
+			claims["aud"] =
+				verify_ops::is_any_of_claim<json_traits>{details::hashed_string_set<typename json_traits::string_type>(
+					aud.begin(), aud.end())};
+			return *this;
+		}
+		/**
+		 * Set an id to check for.
+		 * Check is casesensitive.
+		 * \param id ID to check for.
+		 * \return *this to allow chaining
+		 */
+		verifier& with_id(const typename json_traits::string_type& id) { return with_claim("jti", basic_claim_t(id)); }
+
+		/**
+		 * Specify a claim to check for using the specified operation.
+		 * \param name Name of the claim to check for
+		 * \param fn Function to use for verifying the claim
+		 * \return *this to allow chaining
+		 */
+		verifier& with_claim(const typename json_traits::string_type& name, verify_check_fn_t fn) {
+			claims[name] = fn;
+			return *this;
+		}
+
+		/**
+		 * Specify a claim to check for equality (both type & value).
+		 * \param name Name of the claim to check for
+		 * \param c Claim to check for
+		 * \return *this to allow chaining
+		 */
+		verifier& with_claim(const typename json_traits::string_type& name, basic_claim_t c) {
+			return with_claim(name, verify_ops::equals_claim<json_traits>{c});
+		}
+
+		/**
+		 * Add an algorithm available for checking.
+		 * \param alg Algorithm to allow
+		 * \return *this to allow chaining
+		 */
+		template<typename Algorithm>
+		verifier& allow_algorithm(Algorithm alg) {
+			algs[alg.name()] = std::make_shared<algo<Algorithm>>(alg);
+			return *this;
+		}
+
+		/**
+		 * \brief Select the signature key by the "kid" header
+		 *
+		 * Tokens carrying a key id are checked with the key returned by the lookup, which must be published for
+		 * the token's algorithm. Tokens without a key id still use the algorithms passed to allow_algorithm.
+		 *
+		 * \param fn Function returning the key for a key id, or nullptr if it is unknown
+		 * \return *this to allow chaining
+		 */
+		verifier& with_key_lookup(key_lookup_fn_t fn) {
+			key_lookup = std::move(fn);
+			return *this;
+		}
+
+		/**
+		 * \brief Select the signature key by the "kid" header from a key store
+		 *
+		 * \param store Any type providing `get_key(kid)`, for example a \ref jwks_key_store
+		 * \return *this to allow chaining
+		 */
+		template<typename KeyStore>
+		verifier& with_key_store(std::shared_ptr<KeyStore> store) {
+			return with_key_lookup(
+				[store](const typename json_traits::string_type& kid) { return store->get_key(kid); });
+		}
+
+		/**
+		 * Report the signature check and each claim check to an observer.
+		 * \param obs Observer to report to, must outlive the verifier. Pass nullptr to stop reporting
+		 * \return *this to allow chaining
+		 */
+		verifier& with_observer(Observer* obs) {
+			observer = obs;
+			return *this;
+		}
+
+		/**
+		 * Count verifications per algorithm, failures per error, key lookups and latencies.
+		 * \param m Registry to record into, may be shared by several verifiers. Pass nullptr to stop recording
+		 * \return *this to allow chaining
+		 */
+		verifier& with_metrics(std::shared_ptr<verification_metrics> m) {
+			metrics = std::move(m);
+			return *this;
+		}
+
+		/**
+		 * \brief Reject tokens whose claim is listed in a revocation list
+		 *
+		 * Checked after the signature and the other claims. Tokens without the claim, or with a value that is not
+		 * a string, are not affected. Call it once per claim to check, e.g. for "jti" and "sub".
+		 *
+		 * \param list Revoked values, may be updated and shared while the verifier is in use
+		 * \param claim Payload claim holding the value to look up
+		 * \return *this to allow chaining
+		 */
+		verifier& with_revocation_list(std::shared_ptr<const revocation_list> list,
+									   const typename json_traits::string_type& claim = "jti") {
+			revocations.emplace_back(claim, std::move(list));
+			return *this;
+		}
+
+		/**
+		 * Verify the given token.
+		 * \param jwt Token to check
+		 * \throw token_verification_exception Verification failed
+		 */
+		void verify(const decoded_jwt<json_traits>& jwt) const {
+			std::error_code ec;
+			verify(jwt, ec);
+			error::throw_if_error(ec);
+		}
+		/**
+		 * Verify the given token.
+		 *
+		 * No header extension is understood, so a token listing names other than "b64" in its "crit" header fails
+		 * with error::token_verification_error::unsupported_critical_header. An unencoded payload ("b64" set to
+		 * false) needs verify_detached(), here it fails with error::token_verification_error::invalid_payload_encoding.
+		 *
+		 * \param jwt Token to check
+		 * \param ec error_code filled with details on error
+		 */
+		void verify(const decoded_jwt<json_traits>& jwt, std::error_code& ec) const { verify(jwt, nullptr, ec); }
+
+#ifndef JWT_DISABLE_BASE64
+		/**
+		 * Verify a JWS in JSON serialization.
+		 * \param jws Token to check
+		 * \param policy Number of signatures that must be valid
+		 * \throw token_verification_exception Verification failed
+		 */
+		void verify(const decoded_jws_json<json_traits>& jws, signature_policy policy) const {
+			std::error_code ec;
+			verify(jws, policy, ec);
+			error::throw_if_error(ec);
+		}
+		/**
+		 * Verify a JWS in JSON serialization, checking the signatures on the default thread pool.
+		 * \param jws Token to check
+		 * \param policy Number of signatures that must be valid
+		 * \param ec error_code filled with details on error
+		 */
+		void verify(const decoded_jws_json<json_traits>& jws, signature_policy policy, std::error_code& ec) const {
+			verify(jws, policy, thread_pool::get_default(), ec);
+		}
+		/**
+		 * Verify a JWS in JSON serialization.
+		 *
+		 * The signatures are checked concurrently, each with the algorithm and key selected by its own header,
+		 * and checking stops as soon as the policy is met or can no longer be met. Each key counts once: a valid
+		 * signature made with the same key as another one adds nothing, so a policy that cannot be met by
+		 * distinct keys fails with error::token_verification_error::not_enough_signatures. Header claims are
+		 * checked against the protected header of every signature counted toward the policy, so they must hold
+		 * for each of them, and are never read from a signature that did not verify. On failure `ec` holds the
+		 * error of a signature that did not verify. Critical headers are checked per signature as in
+		 * verify(const decoded_jwt<json_traits>&, std::error_code&), and "crit" must be in the protected header.
+		 *
+		 * \param jws Token to check
+		 * \param policy Number of signatures that must be valid
+		 * \param exec Executor to check the signatures on, the calling thread takes part as well
+		 * \param ec error_code filled with details on error
 		 */
-		explicit verifier(Clock c) : clock(c) {
-			claims["exp"] = [](const verify_ops::verify_context<json_traits>& ctx, std::error_code& ec) {
-				if (!ctx.jwt.has_expires_at()) return;
-				auto exp = ctx.jwt.get_expires_at();
-				if (ctx.current_time > exp + std::chrono::seconds(ctx.default_leeway)) {
-					ec = error::token_verification_error::token_expired;
-				}
-			};
-			claims["iat"] = [](const verify_ops::verify_context<json_traits>& ctx, std::error_code& ec) {
-				if (!ctx.jwt.has_issued_at()) return;
-				auto iat = ctx.jwt.get_issued_at();
-				if (ctx.current_time < iat - std::chrono::seconds(ctx.default_leeway)) {
-					ec = error::token_verification_error::token_expired;
-				}
-			};
-			claims["nbf"] = [](const verify_ops::verify_context<json_traits>& ctx, std::error_code& ec) {
-				if (!ctx.jwt.has_not_before()) return;
-				auto nbf = ctx.jwt.get_not_before();
-				if (ctx.current_time < nbf - std::chrono::seconds(ctx.default_leeway)) {
-					ec = error::token_verification_error::token_expired;
-				}
-			};
+		void verify(const decoded_jws_json<json_traits>& jws, signature_policy policy, executor& exec,
+					std::error_code& ec) const {
+			ec.clear();
+			const auto start = std::chrono::steady_clock::now();
+			const auto& sigs = jws.get_signatures();
+			const auto required = policy.required(sigs.size());
+			std::string algo;
+			read_algorithm(jws, algo);
+			if (required > sigs.size())
+				ec = error::token_verification_error::not_enough_signatures;
+			else {
+				std::vector<std::error_code> results(sigs.size());
+				std::vector<signer_t> signers;
+				// Signatures counted toward the policy, their protected headers are the ones checked
+				std::vector<size_t> counted;
+				std::mutex signers_mutex;
+				std::atomic<size_t> valid{0};
+				// Signatures that did not verify or repeat a key, neither adds to the count
+				std::atomic<size_t> wasted{0};
+				const auto check = [&](size_t begin, size_t end) {
+					for (size_t i = begin; i < end; i++) {
+						if (valid.load() >= required || sigs.size() - wasted.load() < required) return;
+						signer_t signer;
+						verify_json_signature(jws, sigs[i], signer, results[i]);
+						if (results[i]) {
+							wasted++;
+							continue;
+						}
+						std::lock_guard<std::mutex> lock(signers_mutex);
+						if (std::find(signers.begin(), signers.end(), signer) != signers.end()) {
+							wasted++;
+							continue;
+						}
+						signers.push_back(std::move(signer));
+						counted.push_back(i);
+						valid++;
+					}
+				};
+				details::parallel_for(exec, sigs.size(), 1, details::batch_helpers(exec), check);
+				const auto failed =
+					std::find_if(results.begin(), results.end(), [](const std::error_code& e) { return !!e; });
+				if (valid.load() >= required) {
+					std::sort(counted.begin(), counted.end());
+					for (size_t i = 0; i < counted.size() && !ec; i++)
+						verify_claims(jws, sigs[counted[i]].get_protected_claims(), algo, ec);
+				} else if (failed != results.end())
+					ec = *failed;
+				else
+					ec = error::token_verification_error::not_enough_signatures;
+			}
+			if (metrics) metrics->record_verification(algo, ec, std::chrono::steady_clock::now() - start);
 		}
+#endif
 
+#ifndef JWT_DISABLE_BASE64
 		/**
-		 * Set default leeway to use.
-		 * \param leeway Default leeway to use if not specified otherwise
-		 * \return *this to allow chaining
+		 * Verify a token with a detached, unencoded payload read from a stream.
+		 * \param jws Token to check
+		 * \param payload Stream holding the payload, read to its end
+		 * \throw token_verification_exception Verification failed
 		 */
-		verifier& leeway(size_t leeway) {
-			default_leeway = leeway;
-			return *this;
+		void verify_detached(const decoded_detached_jws<json_traits>& jws, std::istream& payload) const {
+			std::error_code ec;
+			verify_detached(jws, payload, ec);
+			error::throw_if_error(ec);
 		}
 		/**
-		 * Set leeway for expires at.
-		 * If not specified the default leeway will be used.
-		 * \param leeway Set leeway to use for expires at.
-		 * \return *this to allow chaining
+		 * Verify a token with a detached, unencoded payload read from a stream.
+		 *
+		 * The token must set "b64" to false and list it in "crit" (RFC 7797), any other critical header fails
+		 * with error::token_verification_error::unsupported_critical_header. The payload is hashed chunk by
+		 * chunk as it is read, so memory use does not grow with its size. Algorithms without `verify_stream`,
+		 * like EdDSA, need the whole payload at once and collect it in memory first. Header claims are checked
+		 * as usual, the token has no payload claims.
+		 *
+		 * \param jws Token to check
+		 * \param payload Stream holding the payload, read to its end
+		 * \param ec error_code filled with details on error
 		 */
-		verifier& expires_at_leeway(size_t leeway) {
-			claims["exp"] = verify_ops::date_before_claim<json_traits>{leeway};
-			return *this;
+		void verify_detached(const decoded_detached_jws<json_traits>& jws, std::istream& payload,
+							 std::error_code& ec) const {
+			verify_detached_source(jws, details::read_stream(payload), ec);
 		}
 		/**
-		 * Set leeway for not before.
-		 * If not specified the default leeway will be used.
-		 * \param leeway Set leeway to use for not before.
-		 * \return *this to allow chaining
+		 * Verify a token with a detached, unencoded payload made of a range of chunks.
+		 * \param jws Token to check
+		 * \param begin Iterator to the first chunk, chunks provide `data()` and `size()`
+		 * \param end Iterator past the last chunk
+		 * \throw token_verification_exception Verification failed
 		 */
-		verifier& not_before_leeway(size_t leeway) {
-			claims["nbf"] = verify_ops::date_after_claim<json_traits>{leeway};
-			return *this;
+		template<typename ChunkIt>
+		void verify_detached(const decoded_detached_jws<json_traits>& jws, ChunkIt begin, ChunkIt end) const {
+			std::error_code ec;
+			verify_detached(jws, begin, end, ec);
+			error::throw_if_error(ec);
 		}
 		/**
-		 * Set leeway for issued at.
-		 * If not specified the default leeway will be used.
-		 * \param leeway Set leeway to use for issued at.
-		 * \return *this to allow chaining
+		 * Verify a token with a detached, unencoded payload made of a range of chunks.
+		 * \param jws Token to check
+		 * \param begin Iterator to the first chunk, chunks provide `data()` and `size()`
+		 * \param end Iterator past the last chunk
+		 * \param ec error_code filled with details on error
+		 * \see verify_detached(const decoded_detached_jws<json_traits>&, std::istream&, std::error_code&) const
 		 */
-		verifier& issued_at_leeway(size_t leeway) {
-			claims["iat"] = verify_ops::date_after_claim<json_traits>{leeway};
-			return *this;
+		template<typename ChunkIt>
+		void verify_detached(const decoded_detached_jws<json_traits>& jws, ChunkIt begin, ChunkIt end,
+							 std::error_code& ec) const {
+			verify_detached_source(jws, details::read_chunks(begin, end), ec);
 		}
+#endif
 
 		/**
-		 * Set an type to check for.
-		 * Check is casesensitive.
-		 * \param iss Issuer to check for.
-		 * \return *this to allow chaining
+		 * Verify a batch of tokens in parallel.
+		 *
+		 * Tokens are grouped by algorithm and key id so that consecutive verifications on a thread use the same
+		 * key. The verifier must not be modified while the batch runs.
+		 *
+		 * \param tokens Tokens to check
+		 * \param ec Resized to the number of tokens and filled with the result of each token, in input order
+		 * \param exec Executor to run the verifications on, the calling thread takes part as well
 		 */
-		verifier& with_type(const typename json_traits::string_type& type, std::locale locale = std::locale{}) {
-			return with_claim("typ", verify_ops::insensitive_string_claim<json_traits, true>{type, std::move(locale)});
+		void verify_batch(const std::vector<decoded_jwt<json_traits>>& tokens, std::vector<std::error_code>& ec,
+						  executor& exec) const {
+			ec.assign(tokens.size(), std::error_code{});
+			std::vector<const decoded_jwt<json_traits>*> ptrs;
+			ptrs.reserve(tokens.size());
+			for (const auto& t : tokens)
+				ptrs.push_back(&t);
+			verify_grouped(ptrs, ec, exec);
 		}
-
 		/**
-		 * Set an issuer to check for.
-		 * Check is casesensitive.
-		 * \param iss Issuer to check for.
-		 * \return *this to allow chaining
+		 * Verify a batch of tokens in parallel on the default thread pool.
+		 * \param tokens Tokens to check
+		 * \param ec Resized to the number of tokens and filled with the result of each token, in input order
 		 */
-		verifier& with_issuer(const typename json_traits::string_type& iss) {
-			return with_claim("iss", basic_claim_t(iss));
+		void verify_batch(const std::vector<decoded_jwt<json_traits>>& tokens,
+						  std::vector<std::error_code>& ec) const {
+			verify_batch(tokens, ec, thread_pool::get_default());
+		}
+#ifndef JWT_DISABLE_BASE64
+		/**
+		 * Decode and verify a batch of tokens in parallel.
+		 *
+		 * Tokens that can not be decoded fail with error::token_verification_error::invalid_token.
+		 *
+		 * \param tokens Encoded tokens to check
+		 * \param ec Resized to the number of tokens and filled with the result of each token, in input order
+		 * \param exec Executor to run the work on, the calling thread takes part as well
+		 */
+		void verify_batch(const std::vector<typename json_traits::string_type>& tokens,
+						  std::vector<std::error_code>& ec, executor& exec) const {
+			ec.assign(tokens.size(), std::error_code{});
+			std::vector<std::unique_ptr<decoded_jwt<json_traits>>> decoded(tokens.size());
+			details::parallel_for(exec, tokens.size(), details::batch_chunk_size, details::batch_helpers(exec),
+								  [&](size_t begin, size_t end) {
+									  for (size_t i = begin; i < end; i++) {
+										  try {
+											  decoded[i].reset(new decoded_jwt<json_traits>(tokens[i]));
+										  } catch (const std::exception&) {
+											  ec[i] = error::token_verification_error::invalid_token;
+										  }
+									  }
+								  });
+
+			std::vector<const decoded_jwt<json_traits>*> ptrs;
+			ptrs.reserve(decoded.size());
+			for (const auto& d : decoded)
+				ptrs.push_back(d.get());
+			verify_grouped(ptrs, ec, exec);
+		}
+		/**
+		 * Decode and verify a batch of tokens in parallel on the default thread pool.
+		 * \param tokens Encoded tokens to check
+		 * \param ec Resized to the number of tokens and filled with the result of each token, in input order
+		 */
+		void verify_batch(const std::vector<typename json_traits::string_type>& tokens,
+						  std::vector<std::error_code>& ec) const {
+			verify_batch(tokens, ec, thread_pool::get_default());
 		}
+#endif
+
+		/// Shared handle to a token that was verified asynchronously
+		using decoded_jwt_ptr = std::shared_ptr<const decoded_jwt<json_traits>>;
+		/// Completion handler of an asynchronous verification
+		using verify_callback_t = std::function<void(std::error_code, decoded_jwt_ptr)>;
 
 		/**
-		 * Set a subject to check for.
-		 * Check is casesensitive.
-		 * \param sub Subject to check for.
-		 * \return *this to allow chaining
+		 * Verify a token on an executor.
+		 *
+		 * The callback runs on the executor once the signature and claims were checked. If the executor
+		 * rejects the job (see bounded_executor) the callback runs immediately on the calling thread with
+		 * error::token_verification_error::verification_rejected. Tokens verify() throws for, like tokens
+		 * without an "alg" header, complete with error::token_verification_error::invalid_token. Exceptions
+		 * thrown by the callback are discarded. The verifier must outlive the job.
+		 *
+		 * \param jwt Token to check
+		 * \param exec Executor to run the verification on
+		 * \param callback Called with the result and the token
 		 */
-		verifier& with_subject(const typename json_traits::string_type& sub) {
-			return with_claim("sub", basic_claim_t(sub));
+		void verify_async(decoded_jwt<json_traits> jwt, executor& exec, verify_callback_t callback) const {
+			verify_async_impl(std::make_shared<const decoded_jwt<json_traits>>(std::move(jwt)), exec,
+							  drop_exception(std::move(callback)));
 		}
+#ifndef JWT_DISABLE_BASE64
 		/**
-		 * Set an audience to check for.
-		 * If any of the specified audiences is not present in the token the check fails.
-		 * \param aud Audience to check for.
-		 * \return *this to allow chaining
+		 * Decode and verify a token on an executor.
+		 *
+		 * Behaves like the overload taking a decoded token; tokens that can not be decoded complete with
+		 * error::token_verification_error::invalid_token and no token.
+		 *
+		 * \param token Encoded token to check
+		 * \param exec Executor to run the work on
+		 * \param callback Called with the result and the decoded token
 		 */
-		verifier& with_audience(const typename basic_claim_t::set_t& aud) {
-			claims["aud"] = verify_ops::is_subset_claim<json_traits>{aud};
-			return *this;
+		void verify_async(typename json_traits::string_type token, executor& exec, verify_callback_t callback) const {
+			verify_async_impl(std::move(token), exec, drop_exception(std::move(callback)));
 		}
 		/**
-		 * Set an audience to check for.
-		 * If the specified audiences is not present in the token the check fails.
-		 * \param aud Audience to check for.
-		 * \return *this to allow chaining
+		 * Decode and verify a token on an executor.
+		 * \param token Encoded token to check
+		 * \param exec Executor to run the work on
+		 * \return Future holding the decoded token, or the exception verify() would have thrown
 		 */
-		verifier& with_audience(const typename json_traits::string_type& aud) {
-			typename basic_claim_t::set_t s;
-			s.insert(aud);
-			return with_audience(s);
+		std::future<decoded_jwt_ptr> verify_async(typename json_traits::string_type token, executor& exec) const {
+			auto promise = std::make_shared<std::promise<decoded_jwt_ptr>>();
+			auto future = promise->get_future();
+			verify_async_impl(std::move(token), exec,
+							  [promise](std::error_code ec, decoded_jwt_ptr decoded, std::exception_ptr error) {
+								  complete(*promise, ec, std::move(decoded), error);
+							  });
+			return future;
 		}
+#endif
 		/**
-		 * Set an id to check for.
-		 * Check is casesensitive.
-		 * \param id ID to check for.
-		 * \return *this to allow chaining
+		 * Verify a token on an executor.
+		 * \param jwt Token to check
+		 * \param exec Executor to run the work on
+		 * \return Future holding the token, or the exception verify() would have thrown
 		 */
-		verifier& with_id(const typename json_traits::string_type& id) { return with_claim("jti", basic_claim_t(id)); }
+		std::future<decoded_jwt_ptr> verify_async(decoded_jwt<json_traits> jwt, executor& exec) const {
+			auto promise = std::make_shared<std::promise<decoded_jwt_ptr>>();
+			auto future = promise->get_future();
+			verify_async_impl(std::make_shared<const decoded_jwt<json_traits>>(std::move(jwt)), exec,
+							  [promise](std::error_code ec, decoded_jwt_ptr decoded, std::exception_ptr error) {
+								  complete(*promise, ec, std::move(decoded), error);
+							  });
+			return future;
+		}
 
+#ifdef JWT_HAS_COROUTINES
 		/**
-		 * Specify a claim to check for using the specified operation.
-		 * \param name Name of the claim to check for
-		 * \param fn Function to use for verifying the claim
-		 * \return *this to allow chaining
+		 * \brief Awaitable returned by verify_co
+		 *
+		 * Resumes the awaiting coroutine on the executor. `co_await` yields the decoded token or throws the
+		 * exception verify() would have thrown.
 		 */
-		verifier& with_claim(const typename json_traits::string_type& name, verify_check_fn_t fn) {
-			claims[name] = fn;
-			return *this;
+		template<typename Token>
+		class verify_awaitable {
+		public:
+			verify_awaitable(const verifier& v, Token token, executor& exec)
+				: v(v), token(std::move(token)), exec(exec) {}
+
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle) {
+				v.verify_async_impl(std::move(token), exec,
+									[this, handle](std::error_code e, decoded_jwt_ptr decoded, std::exception_ptr ex) {
+										ec = e;
+										result = std::move(decoded);
+										thrown = ex;
+										handle.resume();
+									});
+			}
+			decoded_jwt_ptr await_resume() {
+				if (thrown) std::rethrow_exception(thrown);
+				error::throw_if_error(ec);
+				return std::move(result);
+			}
+
+		private:
+			const verifier& v;
+			Token token;
+			executor& exec;
+			std::error_code ec;
+			std::exception_ptr thrown;
+			decoded_jwt_ptr result;
+		};
+
+		/**
+		 * Verify a token from a C++20 coroutine
+		 * \param jwt Token to check
+		 * \param exec Executor to run the work on
+		 * \return Awaitable yielding the token
+		 */
+		verify_awaitable<decoded_jwt<json_traits>> verify_co(decoded_jwt<json_traits> jwt, executor& exec) const {
+			return {*this, std::move(jwt), exec};
+		}
+#ifndef JWT_DISABLE_BASE64
+		/**
+		 * Decode and verify a token from a C++20 coroutine
+		 * \param token Encoded token to check
+		 * \param exec Executor to run the work on
+		 * \return Awaitable yielding the decoded token
+		 */
+		verify_awaitable<typename json_traits::string_type> verify_co(typename json_traits::string_type token,
+																	  executor& exec) const {
+			return {*this, std::move(token), exec};
+		}
+#endif
+#endif
+
+	private:
+		// Verify a token, taking the result of the signature check from signature if it was already done
+		void verify(const decoded_jwt<json_traits>& jwt, const std::error_code* signature, std::error_code& ec) const {
+			ec.clear();
+			const std::string algo = jwt.get_algorithm();
+			if (!metrics) {
+				verify_token(jwt, algo, signature, ec);
+				return;
+			}
+			const auto start = std::chrono::steady_clock::now();
+			verify_token(jwt, algo, signature, ec);
+			metrics->record_verification(algo, ec, std::chrono::steady_clock::now() - start);
+		}
+
+		void verify_token(const decoded_jwt<json_traits>& jwt, const std::string& algo,
+						  const std::error_code* signature, std::error_code& ec) const {
+			check_encoded_payload(jwt, ec);
+			if (ec) return;
+			{
+				details::stage_scope<Observer> scope(observer, stage::signature, algo, jwt.get_token().size());
+				if (signature != nullptr)
+					ec = *signature;
+				else
+					verify_signature(jwt, algo, ec);
+				scope.end(ec);
+			}
+			if (ec) return;
+			verify_claims(jwt, algo, ec);
+		}
+
+		// The payload is part of the token and base64url encoded, so "b64" may not be false (RFC 7797 section 5)
+		static void check_encoded_payload(const header<json_traits>& hdr, std::error_code& ec) {
+			const auto* b64 = hdr.find_header_claim("b64");
+			if (b64 != nullptr && (json_traits::get_type(*b64) != json::type::boolean || !json_traits::as_bool(*b64)))
+				ec = error::token_verification_error::invalid_payload_encoding;
+			else
+				check_critical_headers(hdr, ec);
+		}
+
+		// RFC 7515 section 4.1.11: every name listed in "crit" must be understood, "b64" is the only one
+		static void check_critical_headers(const header<json_traits>& hdr, std::error_code& ec) {
+			const auto* crit = hdr.find_header_claim("crit");
+			if (crit == nullptr) return;
+			if (json_traits::get_type(*crit) != json::type::array || json_traits::as_array(*crit).empty()) {
+				ec = error::token_verification_error::invalid_token;
+				return;
+			}
+			for (const auto& name : json_traits::as_array(*crit)) {
+				if (json_traits::get_type(name) != json::type::string || json_traits::as_string(name) != "b64") {
+					ec = error::token_verification_error::unsupported_critical_header;
+					return;
+				}
+			}
+		}
+
+		void verify_claims(const decoded_jwt<json_traits>& jwt, const std::string& algo, std::error_code& ec) const {
+			verify_claims(jwt, jwt, algo, ec);
+		}
+
+		// Check the claims of jwt, with the header claims read from hdr
+		void verify_claims(const decoded_jwt<json_traits>& jwt, const header<json_traits>& hdr, const std::string& algo,
+						   std::error_code& ec) const {
+			verify_ops::verify_context<json_traits> ctx{clock.now(), jwt, hdr, default_leeway};
+			for (auto& c : claims) {
+				details::stage_scope<Observer> scope(observer, stage::claim, algo, jwt.get_token().size(), &c.first);
+				ctx.claim_key = c.first;
+				c.second(ctx, ec);
+				scope.end(ec);
+				if (ec) return;
+			}
+			for (const auto& r : revocations) {
+				const auto* value = jwt.find_payload_claim(r.first);
+				if (value == nullptr || json_traits::get_type(*value) != json::type::string) continue;
+				details::stage_scope<Observer> scope(observer, stage::claim, algo, jwt.get_token().size(), &r.first);
+				typename json_traits::string_type storage;
+				if (r.second->is_revoked(details::string_ref<json_traits>(*value, storage)))
+					ec = error::token_verification_error::token_revoked;
+				scope.end(ec);
+				if (ec) return;
+			}
+		}
+
+		void verify_signature(const decoded_jwt<json_traits>& jwt, const std::string& algo,
+							  std::error_code& ec) const {
+			const typename json_traits::string_type data = jwt.get_header_base64() + "." + jwt.get_payload_base64();
+			verify_signature(data, jwt.get_signature(), algo, jwt, ec);
+		}
+
+		// Check a signature with the key selected by the "kid" of hdr, or the algorithm allowed for algo
+		void verify_signature(const std::string& data, const std::string& sig, const std::string& algo,
+							  const header<json_traits>& hdr, std::error_code& ec) const {
+			std::shared_ptr<const verification_key> key;
+			algo_base* alg = nullptr;
+			select_key(algo, hdr, key, alg, ec);
+			if (ec) return;
+			if (key)
+				key->verify(data, sig, ec);
+			else
+				alg->verify(data, sig, ec);
+		}
+
+		// Select the key for the "kid" of hdr, or the algorithm allowed for algo. Sets one of them on success
+		void select_key(const std::string& algo, const header<json_traits>& hdr,
+						std::shared_ptr<const verification_key>& key, algo_base*& alg, std::error_code& ec) const {
+			if (key_lookup && hdr.has_key_id()) {
+				key = key_lookup(hdr.get_key_id());
+				if (metrics) metrics->record_key_lookup(key != nullptr);
+				if (!key) {
+					ec = error::token_verification_error::key_not_found;
+					return;
+				}
+				if (key->get_algorithm() != algo) {
+					ec = error::token_verification_error::wrong_algorithm;
+					return;
+				}
+			} else {
+				const auto it = algs.find(algo);
+				if (it == algs.end()) {
+					ec = error::token_verification_error::wrong_algorithm;
+					return;
+				}
+				alg = it->second.get();
+			}
+		}
+
+#ifndef JWT_DISABLE_BASE64
+		// Key a signature was checked with, the one from the key lookup or the algorithm allowed for its "alg"
+		using signer_t = std::pair<std::shared_ptr<const verification_key>, const algo_base*>;
+
+		void verify_json_signature(const decoded_jws_json<json_traits>& jws, const jws_signature<json_traits>& sig,
+								   signer_t& signer, std::error_code& ec) const {
+			std::string algo;
+			// "crit" must be integrity protected
+			if (!read_algorithm(sig, algo) || sig.is_unprotected_header_claim("crit")) {
+				ec = error::token_verification_error::invalid_token;
+				return;
+			}
+			check_encoded_payload(sig, ec);
+			if (ec) return;
+			const auto data = sig.get_protected_header_base64() + "." + jws.get_payload_base64();
+			details::stage_scope<Observer> scope(observer, stage::signature, algo, data.size());
+			try {
+				algo_base* alg = nullptr;
+				select_key(algo, sig, signer.first, alg, ec);
+				signer.second = alg;
+				if (signer.first)
+					signer.first->verify(data, sig.get_signature(), ec);
+				else if (alg != nullptr)
+					alg->verify(data, sig.get_signature(), ec);
+			} catch (const std::exception&) { ec = error::token_verification_error::invalid_token; }
+			scope.end(ec);
+		}
+
+		// Read the "alg" header, false if it is absent or not a string
+		static bool read_algorithm(const header<json_traits>& hdr, std::string& algo) {
+			const auto* alg = hdr.find_header_claim("alg");
+			if (alg == nullptr || json_traits::get_type(*alg) != json::type::string) return false;
+			algo = json_traits::as_string(*alg);
+			return true;
+		}
+
+		void verify_detached_source(const decoded_detached_jws<json_traits>& jws, const details::chunk_source& payload,
+									std::error_code& ec) const {
+			ec.clear();
+			const auto start = std::chrono::steady_clock::now();
+			std::string algo;
+			if (!read_algorithm(jws, algo))
+				ec = error::token_verification_error::invalid_token;
+			else
+				check_unencoded_payload(jws, ec);
+			if (!ec) {
+				details::stage_scope<Observer> scope(observer, stage::signature, algo, jws.get_token().size());
+				std::shared_ptr<const verification_key> key;
+				algo_base* alg = nullptr;
+				select_key(algo, jws, key, alg, ec);
+				if (!ec) {
+					// The signing input is the encoded header, a '.' and the payload as is
+					const auto& prefix = jws.get_header_base64();
+					const details::chunk_source input = [&prefix, &payload](const details::chunk_sink& sink) {
+						return sink(prefix.data(), prefix.size()) && sink(".", 1) && payload(sink);
+					};
+					if (key)
+						key->verify_stream(input, jws.get_signature(), ec);
+					else
+						alg->verify_stream(input, jws.get_signature(), ec);
+				}
+				scope.end(ec);
+			}
+			if (!ec) verify_claims(jws, algo, ec);
+			if (metrics) metrics->record_verification(algo, ec, std::chrono::steady_clock::now() - start);
+		}
+
+		// RFC 7797 section 6: "b64" must be false and listed in "crit", the only critical header understood
+		static void check_unencoded_payload(const decoded_detached_jws<json_traits>& jws, std::error_code& ec) {
+			const auto* crit = jws.find_header_claim("crit");
+			if (!jws.is_payload_unencoded() || crit == nullptr || json_traits::get_type(*crit) != json::type::array ||
+				json_traits::as_array(*crit).empty()) {
+				ec = error::token_verification_error::invalid_payload_encoding;
+				return;
+			}
+			check_critical_headers(jws, ec);
+		}
+#endif
+
+		/// Completion of an asynchronous verification, with the exception verify() threw if any
+		using async_done_t = std::function<void(std::error_code, decoded_jwt_ptr, std::exception_ptr)>;
+
+		static async_done_t drop_exception(verify_callback_t callback) {
+			return [callback](std::error_code ec, decoded_jwt_ptr decoded, std::exception_ptr) {
+				callback(ec, std::move(decoded));
+			};
+		}
+
+		static void submit_async(executor& exec, const async_done_t& done, std::function<void()> task) {
+			if (!exec.try_execute(std::move(task)))
+				done(error::token_verification_error::verification_rejected, nullptr, nullptr);
+		}
+
+		void verify_async_impl(decoded_jwt_ptr token, executor& exec, async_done_t done) const {
+			submit_async(exec, done, [this, token, done]() { finish_async(token, done); });
+		}
+#ifndef JWT_DISABLE_BASE64
+		void verify_async_impl(typename json_traits::string_type token, executor& exec, async_done_t done) const {
+			auto encoded = std::make_shared<typename json_traits::string_type>(std::move(token));
+			submit_async(exec, done, [this, encoded, done]() {
+				decoded_jwt_ptr decoded;
+				try {
+					decoded = std::make_shared<const decoded_jwt<json_traits>>(*encoded);
+				} catch (...) {
+					try {
+						done(error::token_verification_error::invalid_token, nullptr, nullptr);
+					} catch (...) {}
+					return;
+				}
+				finish_async(decoded, done);
+			});
+		}
+#endif
+
+		// Runs on the executor, nothing may escape: a throwing task would end the worker thread
+		void finish_async(const decoded_jwt_ptr& token, const async_done_t& done) const {
+			std::error_code ec;
+			std::exception_ptr thrown;
+			try {
+				verify(*token, ec);
+			} catch (...) {
+				ec = error::token_verification_error::invalid_token;
+				thrown = std::current_exception();
+			}
+			try {
+				done(ec, token, thrown);
+			} catch (...) {}
+		}
+
+		static void complete(std::promise<decoded_jwt_ptr>& promise, std::error_code ec, decoded_jwt_ptr decoded,
+							 std::exception_ptr thrown) {
+			if (thrown) {
+				promise.set_exception(thrown);
+				return;
+			}
+			if (!ec) {
+				promise.set_value(std::move(decoded));
+				return;
+			}
+			try {
+				error::throw_if_error(ec);
+			} catch (...) { promise.set_exception(std::current_exception()); }
+		}
+
+		// Verify all non null tokens, ordered by algorithm and key id; results are written by input position
+		void verify_grouped(const std::vector<const decoded_jwt<json_traits>*>& tokens,
+							std::vector<std::error_code>& ec, executor& exec) const {
+			struct entry {
+				typename json_traits::string_type alg;
+				typename json_traits::string_type kid;
+				size_t index;
+			};
+			std::vector<entry> order;
+			order.reserve(tokens.size());
+			for (size_t i = 0; i < tokens.size(); i++) {
+				const auto* t = tokens[i];
+				if (t == nullptr) continue;
+				try {
+					order.push_back({t->get_algorithm(), t->has_key_id() ? t->get_key_id() : "", i});
+				} catch (const std::exception&) { ec[i] = error::token_verification_error::invalid_token; }
+			}
+			std::stable_sort(order.begin(), order.end(), [](const entry& a, const entry& b) {
+				return a.alg < b.alg || (a.alg == b.alg && a.kid < b.kid);
+			});
+
+			details::parallel_for(exec, order.size(), details::batch_chunk_size, details::batch_helpers(exec),
+								  [&](size_t begin, size_t end) {
+									  while (begin < end) {
+										  auto run = begin + 1;
+										  while (run < end && order[run].alg == order[begin].alg &&
+												 order[run].kid == order[begin].kid)
+											  run++;
+										  std::vector<size_t> indices;
+										  for (size_t i = begin; i < run; i++)
+											  indices.push_back(order[i].index);
+										  verify_run(tokens, indices, ec);
+										  begin = run;
+									  }
+								  });
+		}
+
+		// Verify tokens sharing algorithm and key id. Without a key lookup the signatures are checked together,
+		// which lets the algorithm use its multi-buffer implementation (see hmacsha::verify_batch)
+		void verify_run(const std::vector<const decoded_jwt<json_traits>*>& tokens, const std::vector<size_t>& indices,
+						std::vector<std::error_code>& ec) const {
+			const auto& first = *tokens[indices.front()];
+			const auto it = algs.find(first.get_algorithm());
+			if (indices.size() == 1 || (key_lookup && first.has_key_id()) || it == algs.end()) {
+				for (const auto i : indices)
+					verify_entry(*tokens[i], nullptr, ec[i]);
+				return;
+			}
+			std::vector<std::string> data;
+			std::vector<std::string> sigs;
+			data.reserve(indices.size());
+			sigs.reserve(indices.size());
+			for (const auto i : indices) {
+				data.push_back(tokens[i]->get_header_base64() + "." + tokens[i]->get_payload_base64());
+				sigs.push_back(tokens[i]->get_signature());
+			}
+			std::vector<std::error_code> signatures;
+			it->second->verify_batch(data, sigs, signatures);
+			for (size_t k = 0; k < indices.size(); k++)
+				verify_entry(*tokens[indices[k]], &signatures[k], ec[indices[k]]);
 		}
 
-		/**
-		 * Specify a claim to check for equality (both type & value).
-		 * \param name Name of the claim to check for
-		 * \param c Claim to check for
-		 * \return *this to allow chaining
-		 */
-		verifier& with_claim(const typename json_traits::string_type& name, basic_claim_t c) {
-			return with_claim(name, verify_ops::equals_claim<json_traits>{c});
+		// Verify one token of a batch, a throwing claim check only fails that token as in finish_async
+		void verify_entry(const decoded_jwt<json_traits>& jwt, const std::error_code* signature,
+						  std::error_code& ec) const {
+			try {
+				verify(jwt, signature, ec);
+			} catch (...) { ec = error::token_verification_error::invalid_token; }
 		}
+	};
 
-		/**
-		 * Add an algorithm available for checking.
-		 * \param alg Algorithm to allow
-		 * \return *this to allow chaining
-		 */
-		template<typename Algorithm>
-		verifier& allow_algorithm(Algorithm alg) {
-			algs[alg.name()] = std::make_shared<algo<Algorithm>>(alg);
-			return *this;
-		}
+	/**
+	 * \brief Members kept when parsing a JWK Set
+	 */
+	enum class jwks_retain {
+		/// Parse the whole document and keep every member of every key
+		all,
+		/// Stream over the "keys" array and only keep the members needed to build and look up keys
+		key_material,
+		/// Same as key_material, additionally keeping the first certificate of the "x5c" chain
+		key_material_and_x5c
+	};
 
+	namespace details {
 		/**
-		 * Verify the given token.
-		 * \param jwt Token to check
-		 * \throw token_verification_exception Verification failed
+		 * Check if a JWK member is kept by jwks_retain::key_material, i.e. needed to build and look up keys
+		 * \param name Member name
+		 * \return true for "kty", "kid", "alg", "use", "n", "e", "x", "y", "crv", "k", "x5t" and "x5t#S256"
 		 */
-		void verify(const decoded_jwt<json_traits>& jwt) const {
-			std::error_code ec;
-			verify(jwt, ec);
-			error::throw_if_error(ec);
+		template<typename String>
+		bool is_key_material_member(const String& name) {
+			for (const auto retained : {"kty", "kid", "alg", "use", "n", "e", "x", "y", "crv", "k", "x5t", "x5t#S256"})
+				if (name == retained) return true;
+			return false;
 		}
+
 		/**
-		 * Verify the given token.
-		 * \param jwt Token to check
-		 * \param ec error_code filled with details on error
+		 * \brief Single pass scanner over a JWK Set document
+		 *
+		 * Walks the "keys" array of a JWKS in place and reports the string members needed to build keys (see
+		 * is_key_material_member()), without building a DOM of the document. Everything else is validated and
+		 * skipped without being copied.
 		 */
-		void verify(const decoded_jwt<json_traits>& jwt, std::error_code& ec) const {
-			ec.clear();
-			const typename json_traits::string_type data = jwt.get_header_base64() + "." + jwt.get_payload_base64();
-			const typename json_traits::string_type sig = jwt.get_signature();
-			const std::string algo = jwt.get_algorithm();
-			if (algs.count(algo) == 0) {
-				ec = error::token_verification_error::wrong_algorithm;
-				return;
+		class jwks_scanner : json_reader {
+		public:
+			explicit jwks_scanner(const std::string& doc) : json_reader(doc) {}
+
+			/**
+			 * Scan the document
+			 * \param keep_x5c Also report the first certificate of "x5c"
+			 * \param on_member Called with the name and value of each retained string member of the current key
+			 * \param on_x5c Called with the first certificate of "x5c", or no certificate if the chain is empty
+			 * \param on_key Called after the last member of each key
+			 * \throw error::invalid_json_exception The document is not valid JSON or has no "keys" member
+			 * \throw std::bad_cast "keys" is not an array of objects
+			 */
+			template<typename OnMember, typename OnX5c, typename OnKey>
+			void scan(bool keep_x5c, OnMember on_member, OnX5c on_x5c, OnKey on_key) {
+				pos = 0;
+				bool has_keys = false;
+				expect('{');
+				if (!consume('}')) {
+					do {
+						skip_ws();
+						const auto name = parse_string();
+						expect(':');
+						if (name == "keys") {
+							has_keys = true;
+							scan_keys(keep_x5c, on_member, on_x5c, on_key);
+						} else {
+							skip_value(0);
+						}
+					} while (consume(','));
+					expect('}');
+				}
+				skip_ws();
+				if (pos != doc.size() || !has_keys) fail();
 			}
-			algs.at(algo)->verify(data, sig, ec);
-			if (ec) return;
 
-			verify_ops::verify_context<json_traits> ctx{clock.now(), jwt, default_leeway};
-			for (auto& c : claims) {
-				ctx.claim_key = c.first;
-				c.second(ctx, ec);
-				if (ec) return;
+		private:
+			template<typename OnMember, typename OnX5c, typename OnKey>
+			void scan_keys(bool keep_x5c, OnMember& on_member, OnX5c& on_x5c, OnKey& on_key) {
+				skip_ws();
+				if (peek() != '[') throw std::bad_cast();
+				pos++;
+				if (consume(']')) return;
+				do {
+					skip_ws();
+					if (peek() != '{') throw std::bad_cast();
+					pos++;
+					if (!consume('}')) {
+						do {
+							skip_ws();
+							const auto name = parse_string();
+							expect(':');
+							skip_ws();
+							if (peek() == '"' && is_key_material_member(name))
+								on_member(name, parse_string());
+							else if (keep_x5c && peek() == '[' && name == "x5c")
+								scan_x5c(on_x5c);
+							else
+								skip_value(2);
+						} while (consume(','));
+						expect('}');
+					}
+					on_key();
+				} while (consume(','));
+				expect(']');
 			}
-		}
-	};
+
+			template<typename OnX5c>
+			void scan_x5c(OnX5c& on_x5c) {
+				pos++;
+				std::vector<std::string> first;
+				if (!consume(']')) {
+					skip_ws();
+					if (peek() == '"')
+						first.push_back(parse_string());
+					else
+						skip_value(3);
+					while (consume(','))
+						skip_value(3);
+					expect(']');
+				}
+				on_x5c(std::move(first));
+			}
+		};
+	} // namespace details
 
 	/**
 	 * \brief JSON Web Key
@@ -1540,6 +5260,8 @@ namespace jwt {
 		JWT_CLAIM_EXPLICIT jwk(const typename json_traits::value_type& json)
 			: jwk_claims(json_traits::as_object(json)) {}
 
+		JWT_CLAIM_EXPLICIT jwk(typename json_traits::object_type json) : jwk_claims(std::move(json)) {}
+
 		/**
 		 * Get key type claim
 		 *
@@ -1640,149 +5362,745 @@ namespace jwt {
 		};
 
 		/**
-		 * Check if a key type is present ("kty")
-		 * \return true if present, false otherwise
+		 * Check if a key type is present ("kty")
+		 * \return true if present, false otherwise
+		 */
+		bool has_key_type() const noexcept { return has_jwk_claim("kty"); }
+
+		/**
+		 * Check if a public key usage indication is present ("use")
+		 * \return true if present, false otherwise
+		 */
+		bool has_use() const noexcept { return has_jwk_claim("use"); }
+
+		/**
+		 * Check if a key operations parameter is present ("key_ops")
+		 * \return true if present, false otherwise
+		 */
+		bool has_key_operations() const noexcept { return has_jwk_claim("key_ops"); }
+
+		/**
+		 * Check if algortihm is present ("alg")
+		 * \return true if present, false otherwise
+		 */
+		bool has_algorithm() const noexcept { return has_jwk_claim("alg"); }
+
+		/**
+		 * Check if curve is present ("crv")
+		 * \return true if present, false otherwise
+		 */
+		bool has_curve() const noexcept { return has_jwk_claim("crv"); }
+
+		/**
+		 * Check if key id is present ("kid")
+		 * \return true if present, false otherwise
+		 */
+		bool has_key_id() const noexcept { return has_jwk_claim("kid"); }
+
+		/**
+		 * Check if X509 URL is present ("x5u")
+		 * \return true if present, false otherwise
+		 */
+		bool has_x5u() const noexcept { return has_jwk_claim("x5u"); }
+
+		/**
+		 * Check if X509 Chain is present ("x5c")
+		 * \return true if present, false otherwise
+		 */
+		bool has_x5c() const noexcept { return has_jwk_claim("x5c"); }
+
+		/**
+		 * Check if a X509 thumbprint is present ("x5t")
+		 * \return true if present, false otherwise
+		 */
+		bool has_x5t() const noexcept { return has_jwk_claim("x5t"); }
+
+		/**
+		 * Check if a X509 SHA256 thumbprint is present ("x5t#S256")
+		 * \return true if present, false otherwise
+		 */
+		bool has_x5t_sha256() const noexcept { return has_jwk_claim("x5t#S256"); }
+
+		/**
+		 * Check if a jwks claim is present
+		 * \return true if claim was present, false otherwise
+		 */
+		bool has_jwk_claim(const typename json_traits::string_type& name) const noexcept {
+			return jwk_claims.has_claim(name);
+		}
+
+		/**
+		 * Get jwks claim
+		 * \return Requested claim
+		 * \throw std::runtime_error If claim was not present
+		 */
+		basic_claim_t get_jwk_claim(const typename json_traits::string_type& name) const {
+			return jwk_claims.get_claim(name);
+		}
+
+		bool empty() const noexcept { return jwk_claims.empty(); }
+	};
+
+	/**
+	 * \brief JWK Set
+	 *
+	 * https://tools.ietf.org/html/rfc7517
+	 *
+	 * A JSON object that represents a set of JWKs.  The JSON object MUST
+	 * have a "keys" member, which is an array of JWKs.
+	 *
+	 * This container takes a JWKs and simplifies it to a vector of JWKs. The keys are indexed by their
+	 * "kid", "x5t" and "x5t#S256" members when the set is constructed, so lookups do not scan the set.
+	 * When several keys share the same identifier the first one in document order is returned.
+	 */
+	template<typename json_traits>
+	class jwks {
+	public:
+		using jwk_t = jwk<json_traits>;
+		using jwt_vector_t = std::vector<jwk_t>;
+		using iterator = typename jwt_vector_t::iterator;
+		using const_iterator = typename jwt_vector_t::const_iterator;
+
+		JWT_CLAIM_EXPLICIT jwks(const typename json_traits::string_type& str) : jwks(str, jwks_retain::all) {}
+
+		/**
+		 * \brief Parse a JWK Set
+		 *
+		 * With jwks_retain::key_material the document is scanned in a single pass and each key only holds the
+		 * members needed to build and look it up, which avoids holding a DOM of the whole document and copies
+		 * of members like large certificate chains.
+		 *
+		 * \param str JWK Set in JSON format
+		 * \param retain Members of each key to keep
+		 * \throw error::invalid_json_exception The document is not valid JSON or has no "keys" member
+		 * \throw std::bad_cast "keys" is not an array of objects
+		 */
+		jwks(const typename json_traits::string_type& str, jwks_retain retain) {
+			if (retain == jwks_retain::all)
+				parse_all(str);
+			else
+				parse_key_material(str, retain == jwks_retain::key_material_and_x5c);
+
+			build_index();
+		}
+
+		iterator begin() { return jwk_claims.begin(); }
+		iterator end() { return jwk_claims.end(); }
+		const_iterator cbegin() const { return jwk_claims.begin(); }
+		const_iterator cend() const { return jwk_claims.end(); }
+		const_iterator begin() const { return jwk_claims.begin(); }
+		const_iterator end() const { return jwk_claims.end(); }
+
+		/**
+		 * Check if a jwk with the kid is present
+		 * \return true if jwk was present, false otherwise
+		 */
+		bool has_jwk(const typename json_traits::string_type& key_id) const noexcept {
+			return find_in(kid_index, key_id) != nullptr;
+		}
+
+		/**
+		 * Get jwk
+		 * \return Requested jwk by key_id
+		 * \throw std::runtime_error If jwk was not present
+		 */
+		const jwk_t& get_jwk(const typename json_traits::string_type& key_id) const {
+			return get_from(kid_index, key_id);
+		}
+
+		/**
+		 * Check if a jwk with the X509 thumbprint is present ("x5t")
+		 * \return true if jwk was present, false otherwise
+		 */
+		bool has_jwk_by_x5t(const typename json_traits::string_type& thumbprint) const noexcept {
+			return find_in(x5t_index, thumbprint) != nullptr;
+		}
+
+		/**
+		 * Get jwk by X509 thumbprint ("x5t")
+		 * \return Requested jwk by thumbprint
+		 * \throw std::runtime_error If jwk was not present
+		 */
+		const jwk_t& get_jwk_by_x5t(const typename json_traits::string_type& thumbprint) const {
+			return get_from(x5t_index, thumbprint);
+		}
+
+		/**
+		 * Check if a jwk with the X509 SHA256 thumbprint is present ("x5t#S256")
+		 * \return true if jwk was present, false otherwise
+		 */
+		bool has_jwk_by_x5t_sha256(const typename json_traits::string_type& thumbprint) const noexcept {
+			return find_in(x5t_sha256_index, thumbprint) != nullptr;
+		}
+
+		/**
+		 * Get jwk by X509 SHA256 thumbprint ("x5t#S256")
+		 * \return Requested jwk by thumbprint
+		 * \throw std::runtime_error If jwk was not present
+		 */
+		const jwk_t& get_jwk_by_x5t_sha256(const typename json_traits::string_type& thumbprint) const {
+			return get_from(x5t_sha256_index, thumbprint);
+		}
+
+	private:
+		/// Position of a jwk inside `jwk_claims` by the value of one of its string members
+		using index_t = std::unordered_map<typename json_traits::string_type, size_t>;
+
+		jwt_vector_t jwk_claims;
+		index_t kid_index;
+		index_t x5t_index;
+		index_t x5t_sha256_index;
+
+		void parse_all(const typename json_traits::string_type& str) {
+			typename json_traits::value_type val;
+			if (!json_traits::parse(val, str)) throw error::invalid_json_exception();
+
+			const details::map_of_claims<json_traits> jwks_json = json_traits::as_object(val);
+			if (!jwks_json.has_claim("keys")) throw error::invalid_json_exception();
+
+			auto jwk_list = jwks_json.get_claim("keys").as_array();
+			jwk_claims.reserve(jwk_list.size());
+			std::transform(jwk_list.begin(), jwk_list.end(), std::back_inserter(jwk_claims),
+						   [](const typename json_traits::value_type& val) { return jwk_t{val}; });
+		}
+
+		void parse_key_material(const typename json_traits::string_type& str, bool keep_x5c) {
+			parse_key_material(str, keep_x5c, std::is_same<typename json_traits::string_type, std::string>{});
+		}
+
+		// The scanner works on std::string, documents of other string types are parsed through json_traits
+		void parse_key_material(const std::string& str, bool keep_x5c, std::true_type) {
+			typename json_traits::object_type current;
+			details::jwks_scanner scanner(str);
+			scanner.scan(
+				keep_x5c,
+				[&current](const std::string& name, std::string value) {
+					current[name] = typename json_traits::value_type(std::move(value));
+				},
+				[&current](std::vector<std::string> x5c) {
+					current["x5c"] = typename json_traits::value_type(
+						typename json_traits::array_type(x5c.begin(), x5c.end()));
+				},
+				[this, &current]() {
+					jwk_claims.emplace_back(std::move(current));
+					current = typename json_traits::object_type{};
+				});
+		}
+
+		void parse_key_material(const typename json_traits::string_type& str, bool keep_x5c, std::false_type) {
+			typename json_traits::value_type val;
+			if (!json_traits::parse(val, str)) throw error::invalid_json_exception();
+			const details::map_of_claims<json_traits> jwks_json = json_traits::as_object(val);
+			if (!jwks_json.has_claim("keys")) throw error::invalid_json_exception();
+
+			for (const auto& key : json_traits::as_array(jwks_json.get_claim("keys").to_json())) {
+				typename json_traits::object_type current;
+				for (const auto& member : json_traits::as_object(key)) {
+					if (json_traits::get_type(member.second) == json::type::string &&
+						details::is_key_material_member(member.first)) {
+						current[member.first] = member.second;
+					} else if (keep_x5c && member.first == "x5c" &&
+							   json_traits::get_type(member.second) == json::type::array) {
+						const auto& chain = json_traits::as_array(member.second);
+						typename json_traits::array_type first;
+						if (!chain.empty() && json_traits::get_type(chain.front()) == json::type::string)
+							first.push_back(chain.front());
+						current[member.first] = typename json_traits::value_type(first);
+					}
+				}
+				jwk_claims.emplace_back(std::move(current));
+			}
+		}
+
+		void build_index() {
+			for (size_t i = 0; i < jwk_claims.size(); i++) {
+				add_to_index(kid_index, "kid", i);
+				add_to_index(x5t_index, "x5t", i);
+				add_to_index(x5t_sha256_index, "x5t#S256", i);
+			}
+		}
+
+		void add_to_index(index_t& index, const typename json_traits::string_type& name, size_t pos) {
+			const auto& jwk = jwk_claims[pos];
+			if (!jwk.has_jwk_claim(name)) return;
+			const auto c = jwk.get_jwk_claim(name);
+			if (c.get_type() != json::type::string) return;
+			// emplace keeps the first key, matching the document order lookup
+			index.emplace(c.as_string(), pos);
+		}
+
+		const jwk_t* find_in(const index_t& index, const typename json_traits::string_type& value) const noexcept {
+			const auto it = index.find(value);
+			if (it == index.end()) return nullptr;
+			return &jwk_claims[it->second];
+		}
+
+		const jwk_t& get_from(const index_t& index, const typename json_traits::string_type& value) const {
+			const auto maybe = find_in(index, value);
+			if (maybe == nullptr) throw error::claim_not_present_exception();
+			return *maybe;
+		}
+	};
+
+	/**
+	 * \brief Verification keys built from a JWK Set
+	 *
+	 * Turns the signing keys of a \ref jwks into ready to use verification algorithms, indexed by their "kid".
+	 * The keys are published as an immutable snapshot which is replaced atomically on refresh (RCU-style):
+	 * readers only load the current snapshot and never wait for a refresh, and a snapshot stays valid for as long
+	 * as a reader holds on to it. A refresh builds the next snapshot on the calling thread and reuses the keys of
+	 * the previous one whose material did not change.
+	 *
+	 * Keys are skipped if they can not be used for verification: a "use" other than "sig", no "kid", an unknown
+	 * "kty" or "alg" or invalid key material. The algorithm is taken from the "alg" member, EC keys without one
+	 * use the algorithm matching their curve.
+	 *
+	 * \see verifier::with_key_store
+	 */
+	template<typename json_traits>
+	class jwks_key_store {
+	public:
+		using jwks_t = jwks<json_traits>;
+		using jwk_t = jwk<json_traits>;
+		using key_t = verification_key;
+		/// Callable which pads and base64url decodes a JWK member
+		using decode_fn_t = std::function<std::string(const std::string&)>;
+
+		/**
+		 * \brief Immutable set of keys published by the store
 		 */
-		bool has_key_type() const noexcept { return has_jwk_claim("kty"); }
+		class snapshot {
+		public:
+			/**
+			 * Get a key by key id
+			 * \return the key or nullptr if it is not present
+			 */
+			std::shared_ptr<const key_t> find(const typename json_traits::string_type& key_id) const {
+				const auto it = keys.find(key_id);
+				if (it == keys.end()) return nullptr;
+				return it->second;
+			}
+			/// Number of keys in the snapshot
+			size_t size() const noexcept { return keys.size(); }
 
-		/**
-		 * Check if a public key usage indication is present ("use")
-		 * \return true if present, false otherwise
-		 */
-		bool has_use() const noexcept { return has_jwk_claim("use"); }
+		private:
+			friend class jwks_key_store;
+			std::unordered_map<typename json_traits::string_type, std::shared_ptr<const key_t>> keys;
+		};
 
 		/**
-		 * Check if a key operations parameter is present ("key_ops")
-		 * \return true if present, false otherwise
+		 * Build the keys of a JWK Set
+		 * \param set JWK Set to build the keys from
+		 * \param decode Function to pad and base64url decode the members of a key
 		 */
-		bool has_key_operations() const noexcept { return has_jwk_claim("key_ops"); }
-
+		jwks_key_store(const jwks_t& set, decode_fn_t decode)
+			: decode(std::move(decode)), current(build(set, std::make_shared<const snapshot>())) {}
+#ifndef JWT_DISABLE_BASE64
 		/**
-		 * Check if algortihm is present ("alg")
-		 * \return true if present, false otherwise
+		 * Build the keys of a JWK Set
+		 *
+		 * \note Decodes using the jwt::base64url which supports an std::string
+		 *
+		 * \param set JWK Set to build the keys from
 		 */
-		bool has_algorithm() const noexcept { return has_jwk_claim("alg"); }
+		explicit jwks_key_store(const jwks_t& set)
+			: jwks_key_store(set, [](const std::string& str) {
+				  return base::decode<alphabet::base64url>(base::pad<alphabet::base64url>(str));
+			  }) {}
+#endif
 
 		/**
-		 * Check if curve is present ("crv")
-		 * \return true if present, false otherwise
+		 * Get the current snapshot of keys
+		 * \return keys published by the last refresh
 		 */
-		bool has_curve() const noexcept { return has_jwk_claim("crv"); }
+		std::shared_ptr<const snapshot> get_snapshot() const { return std::atomic_load(&current); }
 
 		/**
-		 * Check if key id is present ("kid")
-		 * \return true if present, false otherwise
+		 * Check if a key with the kid is present
+		 * \return true if key was present, false otherwise
 		 */
-		bool has_key_id() const noexcept { return has_jwk_claim("kid"); }
+		bool has_key(const typename json_traits::string_type& key_id) const { return get_key(key_id) != nullptr; }
 
 		/**
-		 * Check if X509 URL is present ("x5u")
-		 * \return true if present, false otherwise
+		 * Get a key by key id
+		 * \return the key or nullptr if it is not present
 		 */
-		bool has_x5u() const noexcept { return has_jwk_claim("x5u"); }
+		std::shared_ptr<const key_t> get_key(const typename json_traits::string_type& key_id) const {
+			return get_snapshot()->find(key_id);
+		}
 
 		/**
-		 * Check if X509 Chain is present ("x5c")
-		 * \return true if present, false otherwise
+		 * \brief Replace the keys with the ones from a new JWK Set
+		 *
+		 * Keys with the same key id and material as in the current snapshot are reused.
+		 * Concurrent refreshes are serialized, readers keep using the previous snapshot until it is replaced.
+		 *
+		 * \param set JWK Set to build the keys from
 		 */
-		bool has_x5c() const noexcept { return has_jwk_claim("x5c"); }
+		void refresh(const jwks_t& set) {
+			std::lock_guard<std::mutex> lock(refresh_mutex);
+			auto next = build(set, get_snapshot());
+			std::atomic_store(&current, std::move(next));
+		}
 
 		/**
-		 * Check if a X509 thumbprint is present ("x5t")
-		 * \return true if present, false otherwise
+		 * \brief Replace the keys with the ones from a new JWK Set
+		 * \param str JWK Set in JSON format
+		 * \throw std::runtime_error JWK Set is not in correct format
 		 */
-		bool has_x5t() const noexcept { return has_jwk_claim("x5t"); }
+		void refresh(const typename json_traits::string_type& str) {
+			refresh(jwks_t(str, jwks_retain::key_material_and_x5c));
+		}
 
-		/**
-		 * Check if a X509 SHA256 thumbprint is present ("x5t#S256")
-		 * \return true if present, false otherwise
-		 */
-		bool has_x5t_sha256() const noexcept { return has_jwk_claim("x5t#S256"); }
+	private:
+		decode_fn_t decode;
+		std::mutex refresh_mutex;
+		std::shared_ptr<const snapshot> current;
+
+		std::shared_ptr<const snapshot> build(const jwks_t& set,
+											  const std::shared_ptr<const snapshot>& previous) const {
+			auto next = std::make_shared<snapshot>();
+			for (const auto& jwk : set) {
+				const auto kid = member(jwk, "kid");
+				if (kid.empty() || next->keys.count(kid) != 0) continue;
+				if (jwk.has_use() && member(jwk, "use") != "sig") continue;
+
+				const auto alg = algorithm_of(jwk);
+				const auto fingerprint = fingerprint_of(jwk, alg);
+				const auto reused = previous->find(kid);
+				if (reused && !fingerprint.empty() && reused->get_fingerprint() == fingerprint) {
+					next->keys.emplace(kid, reused);
+					continue;
+				}
 
-		/**
-		 * Check if a jwks claim is present
-		 * \return true if claim was present, false otherwise
-		 */
-		bool has_jwk_claim(const typename json_traits::string_type& name) const noexcept {
-			return jwk_claims.has_claim(name);
+				auto key = create_key(jwk, kid, alg, fingerprint);
+				if (key) next->keys.emplace(kid, std::move(key));
+			}
+			return next;
 		}
 
-		/**
-		 * Get jwks claim
-		 * \return Requested claim
-		 * \throw std::runtime_error If claim was not present
-		 */
-		basic_claim_t get_jwk_claim(const typename json_traits::string_type& name) const {
-			return jwk_claims.get_claim(name);
+		static std::string member(const jwk_t& jwk, const typename json_traits::string_type& name) {
+			if (!jwk.has_jwk_claim(name)) return {};
+			const auto c = jwk.get_jwk_claim(name);
+			if (c.get_type() != json::type::string) return {};
+			return c.as_string();
 		}
 
-		bool empty() const noexcept { return jwk_claims.empty(); }
+		static std::string algorithm_of(const jwk_t& jwk) {
+			auto alg = member(jwk, "alg");
+			if (!alg.empty() || member(jwk, "kty") != "EC") return alg;
+			const auto crv = member(jwk, "crv");
+			if (crv == "P-256") return "ES256";
+			if (crv == "P-384") return "ES384";
+			if (crv == "P-521") return "ES512";
+			return {};
+		}
+
+		// HMAC-SHA256 over the length prefixed members, so the secret of "oct" keys never shows in the fingerprint.
+		// Empty if hashing failed, such keys are always rebuilt.
+		static std::string fingerprint_of(const jwk_t& jwk, const std::string& alg) {
+			std::string material;
+			const auto append = [&material](const std::string& value) {
+				material += std::to_string(value.size());
+				material += ':';
+				material += value;
+			};
+			append(alg);
+			for (const auto name : {"kty", "crv", "x", "y", "n", "e", "k"})
+				append(member(jwk, name));
+			if (jwk.has_x5c() && jwk.get_jwk_claim("x5c").get_type() == json::type::array) {
+				const auto x5c = jwk.get_x5c();
+				if (!x5c.empty() && json_traits::get_type(x5c.front()) == json::type::string)
+					append(json_traits::as_string(x5c.front()));
+			}
+			std::error_code ec;
+			const auto digest = crypto::algorithm::hs256("jwt-cpp jwks fingerprint").sign(material, ec);
+			if (ec) return {};
+			static const char hex[] = "0123456789abcdef";
+			std::string res;
+			res.reserve(digest.size() * 2);
+			for (const auto c : digest) {
+				res += hex[static_cast<unsigned char>(c) >> 4];
+				res += hex[static_cast<unsigned char>(c) & 0xf];
+			}
+			return res;
+		}
+
+		std::shared_ptr<const key_t> create_key(const jwk_t& jwk, const std::string& kid, const std::string& alg,
+												const std::string& fingerprint) const {
+			// Any malformed member (bad base64, invalid key material) disqualifies only this key
+			try {
+				const auto kty = member(jwk, "kty");
+				if (kty == "oct") return create_hmac_key(kid, alg, fingerprint, decode(member(jwk, "k")));
+
+				std::error_code ec;
+				std::string pem;
+#ifdef JWT_OPENSSL_CRYPTO
+				if (kty == "EC") {
+					pem = crypto::helper::create_public_key_from_ec_components(
+						member(jwk, "crv"), member(jwk, "x"), member(jwk, "y"), decode, ec);
+					if (ec) return nullptr;
+					return create_public_key(kid, alg, fingerprint, pem);
+				}
+#endif
+				if (kty != "RSA") return nullptr;
+#ifdef JWT_OPENSSL_CRYPTO
+				if (jwk.has_jwk_claim("n") && jwk.has_jwk_claim("e")) {
+					pem = crypto::helper::create_public_key_from_rsa_components(member(jwk, "n"), member(jwk, "e"),
+																				decode, ec);
+					if (ec) return nullptr;
+					return create_public_key(kid, alg, fingerprint, pem);
+				}
+#endif
+#ifndef JWT_DISABLE_BASE64
+				if (jwk.has_x5c()) {
+					pem = crypto::helper::convert_base64_der_to_pem(jwk.get_x5c_key_value(), ec);
+					if (ec) return nullptr;
+					return create_public_key(kid, alg, fingerprint, pem);
+				}
+#endif
+				return nullptr;
+			} catch (const std::exception&) { return nullptr; }
+		}
+
+		static std::shared_ptr<const key_t> create_hmac_key(const std::string& kid, const std::string& alg,
+															const std::string& fingerprint, const std::string& secret) {
+			if (secret.empty()) return nullptr;
+			if (alg == "HS256") return key_t::create(kid, fingerprint, crypto::algorithm::hs256(secret));
+			if (alg == "HS384") return key_t::create(kid, fingerprint, crypto::algorithm::hs384(secret));
+			if (alg == "HS512") return key_t::create(kid, fingerprint, crypto::algorithm::hs512(secret));
+			return nullptr;
+		}
+
+		static std::shared_ptr<const key_t> create_public_key(const std::string& kid, const std::string& alg,
+															  const std::string& fingerprint, const std::string& pem) {
+			if (alg == "RS256") return key_t::create(kid, fingerprint, crypto::algorithm::rs256(pem));
+			if (alg == "RS384") return key_t::create(kid, fingerprint, crypto::algorithm::rs384(pem));
+			if (alg == "RS512") return key_t::create(kid, fingerprint, crypto::algorithm::rs512(pem));
+#ifdef JWT_OPENSSL_CRYPTO
+			if (alg == "PS256") return key_t::create(kid, fingerprint, crypto::algorithm::ps256(pem));
+			if (alg == "PS384") return key_t::create(kid, fingerprint, crypto::algorithm::ps384(pem));
+			if (alg == "PS512") return key_t::create(kid, fingerprint, crypto::algorithm::ps512(pem));
+			if (alg == "ES256") return key_t::create(kid, fingerprint, crypto::algorithm::es256(pem));
+			if (alg == "ES384") return key_t::create(kid, fingerprint, crypto::algorithm::es384(pem));
+			if (alg == "ES512") return key_t::create(kid, fingerprint, crypto::algorithm::es512(pem));
+#endif
+			return nullptr;
+		}
 	};
 
 	/**
-	 * \brief JWK Set
-	 *
-	 * https://tools.ietf.org/html/rfc7517
+	 * \brief Settings of a \ref jwks_refresh_manager
+	 */
+	struct jwks_refresh_options {
+		/// Time between two background refreshes
+		std::chrono::milliseconds refresh_interval{std::chrono::minutes(15)};
+		/// Maximum random offset applied to every background refresh, to spread out the load on the endpoint
+		std::chrono::milliseconds refresh_jitter{std::chrono::seconds(30)};
+		/// Minimum time between two refreshes forced by an unknown key id
+		std::chrono::milliseconds min_refresh_interval{std::chrono::seconds(30)};
+		/// Time an unknown key id is remembered before it can force a refresh again
+		std::chrono::milliseconds negative_cache_ttl{std::chrono::minutes(5)};
+		/// Maximum number of unknown key ids that are remembered
+		size_t negative_cache_size{1024};
+	};
+
+	/**
+	 * \brief Keeps a \ref jwks_key_store up to date with a JWKS endpoint
 	 *
-	 * A JSON object that represents a set of JWKs.  The JSON object MUST
-	 * have a "keys" member, which is an array of JWKs.
+	 * The JWKS document is obtained through a user supplied fetch function, for example a HTTP GET on the
+	 * endpoint. It is fetched again periodically by a background thread (see start()), and on demand when a token
+	 * references an unknown key id. On demand refreshes are guarded against floods of unknown key ids:
+	 * - concurrent misses wait for the same fetch instead of starting their own,
+	 * - an unknown key id is remembered for `negative_cache_ttl` and does not trigger another fetch meanwhile,
+	 *   once a document fetched after the miss was seen lacks it,
+	 * - at most one on demand fetch happens every `min_refresh_interval`.
 	 *
-	 * This container takes a JWKs and simplifies it to a vector of JWKs
+	 * Lookups of known keys never take a lock, they are served by the snapshot of the key store.
+	 * A failed fetch keeps the current keys.
 	 */
 	template<typename json_traits>
-	class jwks {
+	class jwks_refresh_manager {
 	public:
-		using jwk_t = jwk<json_traits>;
-		using jwt_vector_t = std::vector<jwk_t>;
-		using iterator = typename jwt_vector_t::iterator;
-		using const_iterator = typename jwt_vector_t::const_iterator;
+		using key_store_t = jwks_key_store<json_traits>;
+		using key_t = typename key_store_t::key_t;
+		/// Returns the JWKS document in JSON format, throws on failure
+		using fetch_fn_t = std::function<typename json_traits::string_type()>;
+		using clock_t = std::chrono::steady_clock;
 
-		JWT_CLAIM_EXPLICIT jwks(const typename json_traits::string_type& str) {
-			typename json_traits::value_type val;
-			if (!json_traits::parse(val, str)) throw error::invalid_json_exception();
+		/**
+		 * Create a manager for an existing key store
+		 * \param fetch Function returning the JWKS document
+		 * \param store Key store to update
+		 * \param opts Refresh settings
+		 */
+		jwks_refresh_manager(fetch_fn_t fetch, std::shared_ptr<key_store_t> store,
+							 jwks_refresh_options opts = jwks_refresh_options{})
+			: fetch(std::move(fetch)), store(std::move(store)), opts(opts), random(std::random_device{}()) {}
+#ifndef JWT_DISABLE_BASE64
+		/**
+		 * Create a manager and fetch the JWKS document once
+		 * \param fetch Function returning the JWKS document
+		 * \param opts Refresh settings
+		 * \throw any exception thrown by the initial fetch or std::runtime_error if the document is invalid
+		 */
+		explicit jwks_refresh_manager(fetch_fn_t fetch, jwks_refresh_options opts = jwks_refresh_options{})
+			: jwks_refresh_manager(fetch, nullptr, opts) {
+			store = std::make_shared<key_store_t>(
+				typename key_store_t::jwks_t(this->fetch(), jwks_retain::key_material_and_x5c));
+			last_fetch = clock_t::now();
+		}
+#endif
+		jwks_refresh_manager(const jwks_refresh_manager&) = delete;
+		jwks_refresh_manager& operator=(const jwks_refresh_manager&) = delete;
+		~jwks_refresh_manager() { stop(); }
 
-			const details::map_of_claims<json_traits> jwks_json = json_traits::as_object(val);
-			if (!jwks_json.has_claim("keys")) throw error::invalid_json_exception();
+		/**
+		 * Get the key store kept up to date by this manager
+		 */
+		std::shared_ptr<key_store_t> get_key_store() const noexcept { return store; }
 
-			auto jwk_list = jwks_json.get_claim("keys").as_array();
-			std::transform(jwk_list.begin(), jwk_list.end(), std::back_inserter(jwk_claims),
-						   [](const typename json_traits::value_type& val) { return jwk_t{val}; });
+		/**
+		 * \brief Get a key by key id
+		 *
+		 * Unknown key ids force a refresh, subject to the limits described on the class.
+		 * \return the key or nullptr if it is not present
+		 */
+		std::shared_ptr<const key_t> get_key(const typename json_traits::string_type& key_id) {
+			auto key = store->get_key(key_id);
+			if (key) return key;
+
+			std::unique_lock<std::mutex> lock(mutex);
+			auto now = clock_t::now();
+			const auto known_miss = negative_cache.find(key_id);
+			if (known_miss != negative_cache.end()) {
+				if (known_miss->second > now) return nullptr;
+				negative_cache.erase(known_miss);
+			}
+
+			const auto generation = fetch_generation;
+			if (fetching) {
+				// coalesce with the fetch in flight
+				fetch_done.wait(lock, [this]() { return !fetching; });
+			} else if (now - last_fetch >= opts.min_refresh_interval) {
+				fetch_locked(lock);
+			}
+
+			key = store->get_key(key_id);
+			// Only a document fetched since the miss proves the key unknown, a rate limited miss is not remembered
+			if (!key && generation != fetch_generation && last_fetch_succeeded)
+				remember_miss(key_id, clock_t::now());
+			return key;
 		}
 
-		iterator begin() { return jwk_claims.begin(); }
-		iterator end() { return jwk_claims.end(); }
-		const_iterator cbegin() const { return jwk_claims.begin(); }
-		const_iterator cend() const { return jwk_claims.end(); }
-		const_iterator begin() const { return jwk_claims.begin(); }
-		const_iterator end() const { return jwk_claims.end(); }
+		/**
+		 * \brief Fetch the JWKS document now
+		 *
+		 * Waits for a fetch already in flight instead of starting another one.
+		 * \return true if the key store was updated
+		 */
+		bool refresh() {
+			std::unique_lock<std::mutex> lock(mutex);
+			if (fetching) {
+				const auto generation = fetch_generation;
+				fetch_done.wait(lock, [&]() { return !fetching; });
+				return generation != fetch_generation && last_fetch_succeeded;
+			}
+			return fetch_locked(lock);
+		}
 
 		/**
-		 * Check if a jwk with the kid is present
-		 * \return true if jwk was present, false otherwise
+		 * \brief Start refreshing in the background
+		 *
+		 * The document is fetched every `refresh_interval`, plus or minus a random jitter of up to `refresh_jitter`.
 		 */
-		bool has_jwk(const typename json_traits::string_type& key_id) const noexcept {
-			return find_by_kid(key_id) != end();
+		void start() {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (worker.joinable()) return;
+			stopping = false;
+			worker = std::thread([this]() { run(); });
 		}
 
 		/**
-		 * Get jwk
-		 * \return Requested jwk by key_id
-		 * \throw std::runtime_error If jwk was not present
+		 * Stop refreshing in the background and wait for the background thread to exit
 		 */
-		jwk_t get_jwk(const typename json_traits::string_type& key_id) const {
-			const auto maybe = find_by_kid(key_id);
-			if (maybe == end()) throw error::claim_not_present_exception();
-			return *maybe;
+		void stop() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!worker.joinable()) return;
+				stopping = true;
+			}
+			wakeup.notify_all();
+			worker.join();
 		}
 
 	private:
-		jwt_vector_t jwk_claims;
+		const fetch_fn_t fetch;
+		std::shared_ptr<key_store_t> store;
+		const jwks_refresh_options opts;
+
+		std::mutex mutex;
+		std::condition_variable fetch_done;
+		std::condition_variable wakeup;
+		bool fetching{false};
+		bool last_fetch_succeeded{false};
+		size_t fetch_generation{0};
+		clock_t::time_point last_fetch{};
+		std::unordered_map<typename json_traits::string_type, clock_t::time_point> negative_cache;
+
+		std::thread worker;
+		bool stopping{false};
+		std::mt19937 random;
+
+		/// Fetches with `mutex` released, the lock is held again on return
+		bool fetch_locked(std::unique_lock<std::mutex>& lock) {
+			fetching = true;
+			lock.unlock();
+			bool updated = false;
+			// The fetch function is user code and may fail in any way, the current keys stay in place
+			try {
+				store->refresh(fetch());
+				updated = true;
+			} catch (...) {}
+			lock.lock();
+			fetching = false;
+			last_fetch = clock_t::now();
+			last_fetch_succeeded = updated;
+			fetch_generation++;
+			fetch_done.notify_all();
+			return updated;
+		}
 
-		const_iterator find_by_kid(const typename json_traits::string_type& key_id) const noexcept {
-			return std::find_if(cbegin(), cend(), [key_id](const jwk_t& jwk) {
-				if (!jwk.has_key_id()) { return false; }
-				return jwk.get_key_id() == key_id;
-			});
+		void remember_miss(const typename json_traits::string_type& key_id, clock_t::time_point now) {
+			if (negative_cache.size() >= opts.negative_cache_size) {
+				for (auto it = negative_cache.begin(); it != negative_cache.end();) {
+					if (it->second <= now)
+						it = negative_cache.erase(it);
+					else
+						++it;
+				}
+				if (negative_cache.size() >= opts.negative_cache_size) {
+					if (negative_cache.empty()) return;
+					negative_cache.erase(negative_cache.begin());
+				}
+			}
+			negative_cache[key_id] = now + opts.negative_cache_ttl;
+		}
+
+		clock_t::duration next_delay() {
+			const auto jitter = opts.refresh_jitter.count();
+			std::uniform_int_distribution<decltype(jitter)> offset(-jitter, jitter);
+			const auto delay = opts.refresh_interval + std::chrono::milliseconds(offset(random));
+			return std::max<clock_t::duration>(delay, std::chrono::milliseconds(0));
+		}
+
+		void run() {
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!stopping) {
+				const auto deadline = clock_t::now() + next_delay();
+				if (wakeup.wait_until(lock, deadline, [this]() { return stopping; })) break;
+				if (!fetching) fetch_locked(lock);
+			}
 		}
 	};
 
@@ -1803,6 +6121,116 @@ namespace jwt {
 		date now() const { return date::clock::now(); }
 	};
 
+	/**
+	 * \brief Clock returning a cached timestamp that is refreshed at a fixed granularity
+	 *
+	 * `now()` is a single relaxed atomic load, which makes it suitable for verifying tokens at very high rates.
+	 * The cached time is refreshed by a background thread every `granularity`, or only when `tick()` is called
+	 * if the clock was created without a ticker (for example to drive it from an existing event loop).
+	 *
+	 * The returned time lags behind std::chrono::system_clock by up to one granularity plus scheduling delay.
+	 * Tokens may therefore be accepted for up to that long after they expired, and tokens issued within that
+	 * window may be rejected by the "iat" and "nbf" checks. Use a leeway of at least the granularity (rounded up
+	 * to seconds) when verifying with this clock.
+	 *
+	 * Copies share the same timestamp. Ticking clocks reading std::chrono::system_clock also share one
+	 * background thread per granularity, which stops once the last clock using it is destroyed.
+	 */
+	class coarse_clock {
+	public:
+		/// Function the cached time is read from on every refresh
+		using time_source_fn_t = std::function<date()>;
+
+		/**
+		 * Create a new clock reading std::chrono::system_clock
+		 * \param granularity Interval at which the cached time is refreshed
+		 * \param start_ticker Refresh from a background thread, otherwise only `tick()` updates the time
+		 */
+		explicit coarse_clock(std::chrono::milliseconds granularity = std::chrono::milliseconds(100),
+							  bool start_ticker = true)
+			: state(start_ticker ? shared_ticker(granularity)
+								 : std::make_shared<shared_state>(granularity, &date::clock::now)) {}
+
+		/**
+		 * Create a new clock reading the time from a custom source, for example to control time in tests
+		 * \param granularity Interval at which the cached time is refreshed
+		 * \param start_ticker Refresh from a background thread of its own, otherwise only `tick()` updates the time
+		 * \param source Function returning the current time
+		 */
+		coarse_clock(std::chrono::milliseconds granularity, bool start_ticker, time_source_fn_t source)
+			: state(std::make_shared<shared_state>(granularity, std::move(source))) {
+			if (start_ticker) state->start();
+		}
+
+		/**
+		 * Get the cached time
+		 * \return Time of the last refresh
+		 */
+		date now() const { return date(date::duration(state->current.load(std::memory_order_relaxed))); }
+
+		/**
+		 * Refresh the cached time from the time source
+		 */
+		void tick() { state->tick(); }
+
+		/**
+		 * Get the refresh interval
+		 * \return Interval at which the cached time is refreshed
+		 */
+		std::chrono::milliseconds get_granularity() const { return state->granularity; }
+
+	private:
+		struct shared_state {
+			const time_source_fn_t source;
+			std::atomic<date::rep> current;
+			const std::chrono::milliseconds granularity;
+			std::mutex mutex;
+			std::condition_variable wakeup;
+			bool stopping{false};
+			std::thread ticker;
+
+			shared_state(std::chrono::milliseconds g, time_source_fn_t src)
+				: source(std::move(src)), current(source().time_since_epoch().count()), granularity(g) {}
+			shared_state(const shared_state&) = delete;
+			shared_state& operator=(const shared_state&) = delete;
+
+			~shared_state() {
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					stopping = true;
+				}
+				wakeup.notify_all();
+				if (ticker.joinable()) ticker.join();
+			}
+
+			void tick() { current.store(source().time_since_epoch().count(), std::memory_order_relaxed); }
+
+			void start() {
+				ticker = std::thread([this]() {
+					std::unique_lock<std::mutex> lock(mutex);
+					while (!wakeup.wait_for(lock, granularity, [this]() { return stopping; }))
+						tick();
+				});
+			}
+		};
+
+		std::shared_ptr<shared_state> state;
+
+		// The ticking state of this granularity still in use by another clock, or a new one
+		static std::shared_ptr<shared_state> shared_ticker(std::chrono::milliseconds granularity) {
+			static std::mutex registry_mutex;
+			static std::map<std::chrono::milliseconds::rep, std::weak_ptr<shared_state>> registry;
+			std::lock_guard<std::mutex> lock(registry_mutex);
+			auto& entry = registry[granularity.count()];
+			auto res = entry.lock();
+			if (res) return res;
+			res = std::make_shared<shared_state>(granularity, &date::clock::now);
+			res->start();
+			entry = res;
+			return res;
+		}
+	};
+
 	/**
 	 * Return a builder instance to create a new token
 	 */
@@ -1836,6 +6264,46 @@ namespace jwt {
 		return decoded_jwt<json_traits>(token);
 	}
 
+#ifndef JWT_DISABLE_BASE64
+	/**
+	 * Decode a token (JWS) in flattened or general JSON serialization
+	 * \param document Document to decode
+	 * \return Decoded token, check it with verifier::verify() and a signature_policy
+	 * \throw std::invalid_argument Document is not in correct format
+	 * \throw std::runtime_error Base64 decoding failed or invalid json
+	 */
+	template<typename json_traits>
+	decoded_jws_json<json_traits> decode_jws_json(const typename json_traits::string_type& document) {
+		return decoded_jws_json<json_traits>(document);
+	}
+
+	/**
+	 * Decode a token (JWS) with a detached payload
+	 * \param token Token to decode, with an empty payload part
+	 * \return Decoded token, check it with verifier::verify_detached()
+	 * \throw std::invalid_argument Token is not in correct format
+	 * \throw std::runtime_error Base64 decoding failed or invalid json
+	 */
+	template<typename json_traits>
+	decoded_detached_jws<json_traits> decode_detached(const typename json_traits::string_type& token) {
+		return decoded_detached_jws<json_traits>(token);
+	}
+#endif
+
+#if !defined(JWT_DISABLE_BASE64) && defined(JWT_OPENSSL_CRYPTO)
+	/**
+	 * Decode an encrypted token (JWE) in compact serialization
+	 * \param token Token to decode
+	 * \return Decoded token, decrypt it with decoded_jwe::decrypt()
+	 * \throw std::invalid_argument Token is not in correct format
+	 * \throw std::runtime_error Base64 decoding failed or invalid json
+	 */
+	template<typename json_traits>
+	decoded_jwe<json_traits> decode_jwe(const typename json_traits::string_type& token) {
+		return decoded_jwe<json_traits>(token);
+	}
+#endif
+
 	template<typename json_traits>
 	jwk<json_traits> parse_jwk(const typename json_traits::string_type& token) {
 		return jwk<json_traits>(token);
@@ -1846,6 +6314,11 @@ namespace jwt {
 		return jwks<json_traits>(token);
 	}
 
+	template<typename json_traits>
+	jwks<json_traits> parse_jwks(const typename json_traits::string_type& token, jwks_retain retain) {
+		return jwks<json_traits>(token, retain);
+	}
+
 #ifndef JWT_DISABLE_PICOJSON
 	struct picojson_traits {
 		using value_type = picojson::value;
@@ -1883,6 +6356,16 @@ namespace jwt {
 			return val.get<picojson::array>();
 		}
 
+		static const std::string& as_string_ref(const picojson::value& val) {
+			if (!val.is<std::string>()) throw std::bad_cast();
+			return val.get<std::string>();
+		}
+
+		static const picojson::array& as_array_ref(const picojson::value& val) {
+			if (!val.is<picojson::array>()) throw std::bad_cast();
+			return val.get<picojson::array>();
+		}
+
 		static int64_t as_int(const picojson::value& val) {
 			if (!val.is<int64_t>()) throw std::bad_cast();
 			return val.get<int64_t>();
@@ -1901,6 +6384,8 @@ namespace jwt {
 		static bool parse(picojson::value& val, const std::string& str) { return picojson::parse(val, str).empty(); }
 
 		static std::string serialize(const picojson::value& val) { return val.serialize(); }
+
+		static bool equals(const picojson::value& lhs, const picojson::value& rhs) { return lhs == rhs; }
 	};
 
 	/**
@@ -1931,6 +6416,38 @@ namespace jwt {
 	 * \throw std::runtime_error Base64 decoding failed or invalid json
 	 */
 	inline decoded_jwt<picojson_traits> decode(const std::string& token) { return decoded_jwt<picojson_traits>(token); }
+	/**
+	 * Decode a token (JWS) in flattened or general JSON serialization
+	 * \param document Document to decode
+	 * \return Decoded token, check it with verifier::verify() and a signature_policy
+	 * \throw std::invalid_argument Document is not in correct format
+	 * \throw std::runtime_error Base64 decoding failed or invalid json
+	 */
+	inline decoded_jws_json<picojson_traits> decode_jws_json(const std::string& document) {
+		return decoded_jws_json<picojson_traits>(document);
+	}
+	/**
+	 * Decode a token (JWS) with a detached payload
+	 * \param token Token to decode, with an empty payload part
+	 * \return Decoded token, check it with verifier::verify_detached()
+	 * \throw std::invalid_argument Token is not in correct format
+	 * \throw std::runtime_error Base64 decoding failed or invalid json
+	 */
+	inline decoded_detached_jws<picojson_traits> decode_detached(const std::string& token) {
+		return decoded_detached_jws<picojson_traits>(token);
+	}
+#endif
+#if !defined(JWT_DISABLE_BASE64) && defined(JWT_OPENSSL_CRYPTO)
+	/**
+	 * Decode an encrypted token (JWE) in compact serialization
+	 * \param token Token to decode
+	 * \return Decoded token, decrypt it with decoded_jwe::decrypt()
+	 * \throw std::invalid_argument Token is not in correct format
+	 * \throw std::runtime_error Base64 decoding failed or invalid json
+	 */
+	inline decoded_jwe<picojson_traits> decode_jwe(const std::string& token) {
+		return decoded_jwe<picojson_traits>(token);
+	}
 #endif
 	/**
 	 * Decode a token
@@ -1966,6 +6483,17 @@ namespace jwt {
 	inline jwks<picojson_traits> parse_jwks(const picojson_traits::string_type& token) {
 		return jwks<picojson_traits>(token);
 	}
+
+	/**
+	 * Parse a jwks
+	 * \param token JWKs Token to parse
+	 * \param retain Members of each key to keep
+	 * \return Parsed JWKs
+	 * \throw std::runtime_error Token is not in correct format
+	 */
+	inline jwks<picojson_traits> parse_jwks(const picojson_traits::string_type& token, jwks_retain retain) {
+		return jwks<picojson_traits>(token, retain);
+	}
 #endif
 } // namespace jwt
 
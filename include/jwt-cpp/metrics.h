@@ -0,0 +1,301 @@
+#ifndef JWT_CPP_METRICS_H
+#define JWT_CPP_METRICS_H
+
+#include "error.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace jwt {
+	/**
+	 * \brief Point in time copy of a verification_metrics registry
+	 */
+	struct metrics_snapshot {
+		/// Verifications per algorithm, unknown algorithms are counted as "other"
+		std::map<std::string, uint64_t> verifications;
+		/// Failed verifications per error, keyed by category and error name
+		std::map<std::pair<std::string, std::string>, uint64_t> failures;
+		/// Tokens whose key was found by the key lookup
+		uint64_t key_lookup_hits{0};
+		/// Tokens whose key id did not match any key
+		uint64_t key_lookup_misses{0};
+		/// Number of latency samples
+		uint64_t latency_count{0};
+		/// Sum of all latency samples in nanoseconds
+		uint64_t latency_sum_ns{0};
+		/// Every latency bucket in order as (upper bound in nanoseconds, count), not cumulative. The last one also
+		/// counts the latencies beyond its bound
+		std::vector<std::pair<uint64_t, uint64_t>> latency_buckets;
+
+		/**
+		 * Write the snapshot in the plain text exposition format used by Prometheus
+		 * \param os Stream to write to
+		 * \param prefix Prefix for all metric names
+		 */
+		void write_text(std::ostream& os, const std::string& prefix = "jwt_") const {
+			os << "# TYPE " << prefix << "verifications_total counter\n";
+			for (const auto& e : verifications)
+				os << prefix << "verifications_total{alg=\"" << e.first << "\"} " << e.second << "\n";
+			os << "# TYPE " << prefix << "verification_failures_total counter\n";
+			for (const auto& e : failures)
+				os << prefix << "verification_failures_total{category=\"" << e.first.first << "\",error=\""
+				   << e.first.second << "\"} " << e.second << "\n";
+			os << "# TYPE " << prefix << "key_lookups_total counter\n";
+			os << prefix << "key_lookups_total{result=\"hit\"} " << key_lookup_hits << "\n";
+			os << prefix << "key_lookups_total{result=\"miss\"} " << key_lookup_misses << "\n";
+			os << "# TYPE " << prefix << "verification_duration_ns histogram\n";
+			// Every bound is written on each scrape so the series stay the same, the open ended last bucket is +Inf
+			uint64_t cumulative = 0;
+			for (size_t i = 0; i + 1 < latency_buckets.size(); i++) {
+				cumulative += latency_buckets[i].second;
+				os << prefix << "verification_duration_ns_bucket{le=\"" << latency_buckets[i].first << "\"} "
+				   << cumulative << "\n";
+			}
+			os << prefix << "verification_duration_ns_bucket{le=\"+Inf\"} " << latency_count << "\n";
+			os << prefix << "verification_duration_ns_sum " << latency_sum_ns << "\n";
+			os << prefix << "verification_duration_ns_count " << latency_count << "\n";
+		}
+	};
+
+	/**
+	 * \brief Always-on counters and latency histogram for token verification
+	 *
+	 * Counters are sharded per thread: every thread records into one of a fixed set of cache line padded shards
+	 * with relaxed atomic increments, so recording never locks or allocates. Latencies go into a log-linear
+	 * histogram with four linear sub-buckets per power of two. `snapshot()` sums all shards.
+	 *
+	 * Attach an instance to a verifier with `verifier::with_metrics`.
+	 */
+	class verification_metrics {
+	public:
+		/// Algorithms counted separately, everything else is counted as "other"
+		static constexpr size_t algorithm_count = 15;
+		/// Number of linear sub-buckets per power of two
+		static constexpr size_t sub_buckets = 4;
+		/// Number of latency buckets, the last one also holds all latencies beyond its range (about 2^46 ns)
+		static constexpr size_t latency_bucket_count = 46 * sub_buckets;
+
+		/**
+		 * Create a new registry
+		 * \param shards Number of shards threads are spread over, defaults to twice the hardware threads
+		 */
+		explicit verification_metrics(size_t shards = 0)
+			: shard_count(shards != 0 ? shards : std::max<size_t>(2, 2 * std::thread::hardware_concurrency())),
+			  shard_data(new shard[shard_count]) {}
+		verification_metrics(const verification_metrics&) = delete;
+		verification_metrics& operator=(const verification_metrics&) = delete;
+
+		/**
+		 * Record the outcome of one verification
+		 * \param alg Algorithm of the token
+		 * \param ec Result of the verification
+		 * \param duration Time spent verifying
+		 */
+		void record_verification(const std::string& alg, const std::error_code& ec,
+								 std::chrono::nanoseconds duration) noexcept {
+			auto& s = local_shard();
+			s.algorithms[algorithm_index(alg)].fetch_add(1, std::memory_order_relaxed);
+			if (ec) {
+				const auto idx = failure_index(ec);
+				s.failures[idx].fetch_add(1, std::memory_order_relaxed);
+			}
+			const auto ns = duration.count() < 0 ? uint64_t{0} : static_cast<uint64_t>(duration.count());
+			s.latency[latency_index(ns)].fetch_add(1, std::memory_order_relaxed);
+			s.latency_sum.fetch_add(ns, std::memory_order_relaxed);
+		}
+
+		/**
+		 * Record the result of looking up the key of a token by its key id
+		 * \param found Whether a key was found
+		 */
+		void record_key_lookup(bool found) noexcept {
+			auto& s = local_shard();
+			(found ? s.key_hits : s.key_misses).fetch_add(1, std::memory_order_relaxed);
+		}
+
+		/**
+		 * Sum all shards. Samples recorded concurrently may or may not be included.
+		 * \return Current values
+		 */
+		metrics_snapshot snapshot() const {
+			metrics_snapshot res;
+			std::array<uint64_t, algorithm_count + 1> algs{};
+			std::array<uint64_t, failure_count> failures{};
+			std::array<uint64_t, latency_bucket_count> latency{};
+			for (size_t i = 0; i < shard_count; i++) {
+				const auto& s = shard_data[i];
+				for (size_t a = 0; a < algs.size(); a++)
+					algs[a] += s.algorithms[a].load(std::memory_order_relaxed);
+				for (size_t f = 0; f < failures.size(); f++)
+					failures[f] += s.failures[f].load(std::memory_order_relaxed);
+				for (size_t b = 0; b < latency.size(); b++)
+					latency[b] += s.latency[b].load(std::memory_order_relaxed);
+				res.latency_sum_ns += s.latency_sum.load(std::memory_order_relaxed);
+				res.key_lookup_hits += s.key_hits.load(std::memory_order_relaxed);
+				res.key_lookup_misses += s.key_misses.load(std::memory_order_relaxed);
+			}
+			for (size_t a = 0; a < algs.size(); a++) {
+				if (algs[a] == 0) continue;
+				const char* name = a < algorithm_count ? algorithm_names()[a] : "other";
+				res.verifications[name] = algs[a];
+			}
+			for (size_t f = 0; f < failures.size(); f++)
+				if (failures[f] != 0) res.failures[failure_name(f)] = failures[f];
+			res.latency_buckets.reserve(latency.size());
+			for (size_t b = 0; b < latency.size(); b++) {
+				res.latency_count += latency[b];
+				res.latency_buckets.emplace_back(bucket_upper_bound(b), latency[b]);
+			}
+			return res;
+		}
+
+		/**
+		 * Write a snapshot in the plain text exposition format
+		 * \param os Stream to write to
+		 */
+		void write_text(std::ostream& os) const { snapshot().write_text(os); }
+
+		/**
+		 * Get the bucket a latency falls into
+		 * \param ns Latency in nanoseconds
+		 * \return Index of the bucket
+		 */
+		static size_t latency_index(uint64_t ns) noexcept {
+			if (ns < sub_buckets) return static_cast<size_t>(ns);
+			size_t msb = 0;
+			for (auto v = ns; v > 1; v >>= 1)
+				msb++;
+			// msb >= 2 here; the two bits below the top one select the linear sub-bucket
+			const auto sub = static_cast<size_t>((ns >> (msb - 2)) & (sub_buckets - 1));
+			return std::min(latency_bucket_count - 1, (msb - 1) * sub_buckets + sub);
+		}
+
+		/**
+		 * Get the largest latency stored in a bucket
+		 * \param index Index of the bucket
+		 * \return Inclusive upper bound in nanoseconds
+		 */
+		static uint64_t bucket_upper_bound(size_t index) noexcept {
+			if (index < sub_buckets) return index;
+			const auto msb = index / sub_buckets + 1;
+			const auto sub = index % sub_buckets;
+			return ((uint64_t{sub_buckets} + sub + 1) << (msb - 2)) - 1;
+		}
+
+	private:
+		// Token verification errors start at 10, signature verification errors follow them
+		static constexpr size_t token_error_count = 16;
+		static constexpr size_t signature_error_count = 8;
+		static constexpr size_t failure_count = token_error_count + signature_error_count + 1;
+
+		// Not alignas(64): new[] only honours it from C++17 on. The padding keeps the next shard off the cache lines
+		// of this one wherever the array starts
+		struct shard {
+			std::array<std::atomic<uint64_t>, algorithm_count + 1> algorithms;
+			std::array<std::atomic<uint64_t>, failure_count> failures;
+			std::array<std::atomic<uint64_t>, latency_bucket_count> latency;
+			std::atomic<uint64_t> latency_sum;
+			std::atomic<uint64_t> key_hits;
+			std::atomic<uint64_t> key_misses;
+			char padding[64];
+
+			shard() : latency_sum(0), key_hits(0), key_misses(0) {
+				for (auto& a : algorithms)
+					a.store(0, std::memory_order_relaxed);
+				for (auto& a : failures)
+					a.store(0, std::memory_order_relaxed);
+				for (auto& a : latency)
+					a.store(0, std::memory_order_relaxed);
+			}
+		};
+
+		const size_t shard_count;
+		std::unique_ptr<shard[]> shard_data;
+
+		shard& local_shard() noexcept {
+			static std::atomic<size_t> next_thread{0};
+			static thread_local const size_t thread_index = next_thread++;
+			return shard_data[thread_index % shard_count];
+		}
+
+		static const std::array<const char*, algorithm_count>& algorithm_names() noexcept {
+			static const std::array<const char*, algorithm_count> names{{"HS256", "HS384", "HS512", "RS256", "RS384",
+																		 "RS512", "ES256", "ES384", "ES512", "ES256K",
+																		 "PS256", "PS384", "PS512", "EdDSA", "none"}};
+			return names;
+		}
+
+		static size_t algorithm_index(const std::string& alg) noexcept {
+			const auto& names = algorithm_names();
+			for (size_t i = 0; i < names.size(); i++)
+				if (std::strcmp(alg.c_str(), names[i]) == 0) return i;
+			return algorithm_count;
+		}
+
+		static size_t failure_index(const std::error_code& ec) noexcept {
+			const auto value = static_cast<size_t>(ec.value());
+			if (ec.category() == error::token_verification_error_category() && value >= 10 &&
+				value < 10 + token_error_count)
+				return value - 10;
+			if (ec.category() == error::signature_verification_error_category() && value >= 10 &&
+				value < 10 + signature_error_count)
+				return token_error_count + value - 10;
+			return failure_count - 1;
+		}
+
+		static std::pair<std::string, std::string> failure_name(size_t index) {
+			if (index < token_error_count)
+				return {"token_verification_error",
+						token_error_name(static_cast<error::token_verification_error>(index + 10))};
+			if (index < token_error_count + signature_error_count)
+				return {"signature_verification_error",
+						signature_error_name(
+							static_cast<error::signature_verification_error>(index - token_error_count + 10))};
+			return {"other", "other"};
+		}
+
+		static std::string token_error_name(error::token_verification_error e) {
+			switch (e) {
+			case error::token_verification_error::wrong_algorithm: return "wrong_algorithm";
+			case error::token_verification_error::missing_claim: return "missing_claim";
+			case error::token_verification_error::claim_type_missmatch: return "claim_type_missmatch";
+			case error::token_verification_error::claim_value_missmatch: return "claim_value_missmatch";
+			case error::token_verification_error::token_expired: return "token_expired";
+			case error::token_verification_error::audience_missmatch: return "audience_missmatch";
+			case error::token_verification_error::key_not_found: return "key_not_found";
+			case error::token_verification_error::invalid_token: return "invalid_token";
+			case error::token_verification_error::verification_rejected: return "verification_rejected";
+			case error::token_verification_error::not_enough_signatures: return "not_enough_signatures";
+			case error::token_verification_error::invalid_payload_encoding: return "invalid_payload_encoding";
+			case error::token_verification_error::unsupported_critical_header: return "unsupported_critical_header";
+			case error::token_verification_error::token_revoked: return "token_revoked";
+			default: return std::to_string(static_cast<int>(e));
+			}
+		}
+
+		static std::string signature_error_name(error::signature_verification_error e) {
+			switch (e) {
+			case error::signature_verification_error::invalid_signature: return "invalid_signature";
+			case error::signature_verification_error::create_context_failed: return "create_context_failed";
+			case error::signature_verification_error::verifyinit_failed: return "verifyinit_failed";
+			case error::signature_verification_error::verifyupdate_failed: return "verifyupdate_failed";
+			case error::signature_verification_error::verifyfinal_failed: return "verifyfinal_failed";
+			case error::signature_verification_error::get_key_failed: return "get_key_failed";
+			default: return std::to_string(static_cast<int>(e));
+			}
+		}
+	};
+} // namespace jwt
+
+#endif
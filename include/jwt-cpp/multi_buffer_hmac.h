@@ -0,0 +1,412 @@
+#ifndef JWT_CPP_MULTI_BUFFER_HMAC_H
+#define JWT_CPP_MULTI_BUFFER_HMAC_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace jwt {
+	namespace crypto {
+		namespace details {
+			/// Parameters of SHA-256
+			struct sha256_traits {
+				using word = uint32_t;
+				static constexpr size_t block_size = 64;
+				static constexpr size_t digest_size = 32;
+				static constexpr size_t rounds = 64;
+
+				static const word* round_constants() noexcept {
+					static const word k[rounds] = {
+						0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+						0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+						0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+						0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+						0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+						0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+						0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+						0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+					return k;
+				}
+				static std::array<word, 8> initial_state() noexcept {
+					return {{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab,
+							 0x5be0cd19}};
+				}
+				// The functions are applied to all lanes at once, T is a vector of words
+				template<typename T>
+				static T rotr(const T& x, unsigned n) noexcept {
+					return (x >> n) | (x << (32 - n));
+				}
+				template<typename T>
+				static T big_sigma0(const T& x) noexcept {
+					return rotr(x, 2) ^ rotr(x, 13) ^ rotr(x, 22);
+				}
+				template<typename T>
+				static T big_sigma1(const T& x) noexcept {
+					return rotr(x, 6) ^ rotr(x, 11) ^ rotr(x, 25);
+				}
+				template<typename T>
+				static T small_sigma0(const T& x) noexcept {
+					return rotr(x, 7) ^ rotr(x, 18) ^ (x >> 3);
+				}
+				template<typename T>
+				static T small_sigma1(const T& x) noexcept {
+					return rotr(x, 17) ^ rotr(x, 19) ^ (x >> 10);
+				}
+			};
+
+			/// Parameters of SHA-512
+			struct sha512_traits {
+				using word = uint64_t;
+				static constexpr size_t block_size = 128;
+				static constexpr size_t digest_size = 64;
+				static constexpr size_t rounds = 80;
+
+				static const word* round_constants() noexcept {
+					static const word k[rounds] = {
+						0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc,
+						0x3956c25bf348b538, 0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118,
+						0xd807aa98a3030242, 0x12835b0145706fbe, 0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2,
+						0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235, 0xc19bf174cf692694,
+						0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+						0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5,
+						0x983e5152ee66dfab, 0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4,
+						0xc6e00bf33da88fc2, 0xd5a79147930aa725, 0x06ca6351e003826f, 0x142929670a0e6e70,
+						0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed, 0x53380d139d95b3df,
+						0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+						0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30,
+						0xd192e819d6ef5218, 0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8,
+						0x19a4c116b8d2d0c8, 0x1e376c085141ab53, 0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8,
+						0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373, 0x682e6ff3d6b2b8a3,
+						0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+						0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b,
+						0xca273eceea26619c, 0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178,
+						0x06f067aa72176fba, 0x0a637dc5a2c898a6, 0x113f9804bef90dae, 0x1b710b35131c471b,
+						0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc, 0x431d67c49c100d4c,
+						0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817};
+					return k;
+				}
+				static std::array<word, 8> initial_state() noexcept {
+					return {{0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+							 0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179}};
+				}
+				template<typename T>
+				static T rotr(const T& x, unsigned n) noexcept {
+					return (x >> n) | (x << (64 - n));
+				}
+				template<typename T>
+				static T big_sigma0(const T& x) noexcept {
+					return rotr(x, 28) ^ rotr(x, 34) ^ rotr(x, 39);
+				}
+				template<typename T>
+				static T big_sigma1(const T& x) noexcept {
+					return rotr(x, 14) ^ rotr(x, 18) ^ rotr(x, 41);
+				}
+				template<typename T>
+				static T small_sigma0(const T& x) noexcept {
+					return rotr(x, 1) ^ rotr(x, 8) ^ (x >> 7);
+				}
+				template<typename T>
+				static T small_sigma1(const T& x) noexcept {
+					return rotr(x, 19) ^ rotr(x, 61) ^ (x >> 6);
+				}
+			};
+
+			/// Parameters of SHA-384, SHA-512 with another initial state and a truncated digest
+			struct sha384_traits : sha512_traits {
+				static constexpr size_t digest_size = 48;
+
+				static std::array<word, 8> initial_state() noexcept {
+					return {{0xcbbb9d5dc1059ed8, 0x629a292a367cd507, 0x9159015a3070dd17, 0x152fecd8f70e5939,
+							 0x67332667ffc00b31, 0x8eb44a8768581511, 0xdb0c2e0d64f98fa7, 0x47b5481dbefa4fa4}};
+				}
+			};
+
+// The engine is used from inline functions, so all translation units of a program must agree on the lane count.
+// It therefore does not follow the -m flags of the translation unit, define JWT_MULTI_BUFFER_BYTES for the whole
+// program (the CMake option of the same name adds it to the jwt-cpp target) to use wider vectors.
+#ifndef JWT_MULTI_BUFFER_BYTES
+#define JWT_MULTI_BUFFER_BYTES 16
+#endif
+			static_assert(JWT_MULTI_BUFFER_BYTES == 16 || JWT_MULTI_BUFFER_BYTES == 32 || JWT_MULTI_BUFFER_BYTES == 64,
+						  "JWT_MULTI_BUFFER_BYTES must be 16, 32 or 64");
+
+			/**
+			 * \brief One word per lane, every operator applies to all lanes
+			 *
+			 * Portable stand-in for the vector types of GCC and Clang.
+			 */
+			template<typename Word, size_t Lanes>
+			struct lane_array {
+				Word v[Lanes];
+
+				Word& operator[](size_t l) noexcept { return v[l]; }
+				Word operator[](size_t l) const noexcept { return v[l]; }
+
+				template<typename Op>
+				friend lane_array apply(lane_array a, const lane_array& b, Op op) noexcept {
+					for (size_t l = 0; l < Lanes; l++)
+						a.v[l] = op(a.v[l], b.v[l]);
+					return a;
+				}
+				friend lane_array operator+(const lane_array& a, const lane_array& b) noexcept {
+					return apply(a, b, [](Word x, Word y) { return static_cast<Word>(x + y); });
+				}
+				friend lane_array operator+(const lane_array& a, Word b) noexcept {
+					return apply(a, a, [b](Word x, Word) { return static_cast<Word>(x + b); });
+				}
+				friend lane_array operator^(const lane_array& a, const lane_array& b) noexcept {
+					return apply(a, b, [](Word x, Word y) { return static_cast<Word>(x ^ y); });
+				}
+				friend lane_array operator&(const lane_array& a, const lane_array& b) noexcept {
+					return apply(a, b, [](Word x, Word y) { return static_cast<Word>(x & y); });
+				}
+				friend lane_array operator|(const lane_array& a, const lane_array& b) noexcept {
+					return apply(a, b, [](Word x, Word y) { return static_cast<Word>(x | y); });
+				}
+				friend lane_array operator~(const lane_array& a) noexcept {
+					return apply(a, a, [](Word x, Word) { return static_cast<Word>(~x); });
+				}
+				friend lane_array operator>>(const lane_array& a, unsigned n) noexcept {
+					return apply(a, a, [n](Word x, Word) { return static_cast<Word>(x >> n); });
+				}
+				friend lane_array operator<<(const lane_array& a, unsigned n) noexcept {
+					return apply(a, a, [n](Word x, Word) { return static_cast<Word>(x << n); });
+				}
+				lane_array& operator+=(const lane_array& b) noexcept { return *this = *this + b; }
+			};
+
+			/// Type holding one word per lane, a native vector where the compiler offers one
+			template<typename Word, size_t Lanes>
+			struct lane_vector {
+#if defined(__GNUC__)
+				typedef Word type __attribute__((vector_size(sizeof(Word) * Lanes)));
+#else
+				using type = lane_array<Word, Lanes>;
+#endif
+			};
+
+			/**
+			 * \brief Computes the HMAC of many messages with one key
+			 */
+			class batch_hmac {
+			public:
+				virtual ~batch_hmac() = default;
+
+				/**
+				 * Compute the HMAC of every message
+				 * \param messages Messages to authenticate
+				 * \param macs Resized to the number of messages and filled with the raw HMAC of each message
+				 */
+				virtual void compute(const std::vector<const std::string*>& messages,
+									 std::vector<std::string>& macs) const = 0;
+			};
+
+			/**
+			 * \brief HMAC-SHA2 over several messages at once, one message per lane
+			 *
+			 * Every word of the hash state holds the words of all lanes in one vector, so each step of the
+			 * compression function is a single SIMD instruction for all messages. By default there are as many
+			 * lanes as fit into `JWT_MULTI_BUFFER_BYTES` (16 bytes unless defined for the whole program, 32 suits
+			 * AVX2 and 64 AVX-512). Messages are sorted by length and processed in groups of `Lanes`, lanes whose
+			 * message already ended are masked out.
+			 *
+			 * The inner and outer states after absorbing the padded key are computed once on construction.
+			 */
+			template<typename Hash, size_t Lanes = JWT_MULTI_BUFFER_BYTES / sizeof(typename Hash::word)>
+			class multi_buffer_hmac : public batch_hmac {
+			public:
+				using word = typename Hash::word;
+
+				/**
+				 * Precompute the keyed states
+				 * \param key HMAC key
+				 */
+				explicit multi_buffer_hmac(const std::string& key) {
+					std::string block = key;
+					if (block.size() > Hash::block_size) {
+						const auto* ptr = &key;
+						hash(Hash::initial_state(), 0, &ptr, 1, &block);
+					}
+					block.resize(Hash::block_size, '\0');
+					std::string inner_block = block;
+					std::string outer_block = block;
+					for (size_t i = 0; i < block.size(); i++) {
+						inner_block[i] = static_cast<char>(inner_block[i] ^ 0x36);
+						outer_block[i] = static_cast<char>(outer_block[i] ^ 0x5c);
+					}
+					const auto* inner_ptr = &inner_block;
+					const auto* outer_ptr = &outer_block;
+					inner = absorb(inner_ptr);
+					outer = absorb(outer_ptr);
+				}
+
+				void compute(const std::vector<const std::string*>& messages,
+							 std::vector<std::string>& macs) const override {
+					macs.resize(messages.size());
+					// Similar lengths in one group keep the lanes busy for the same number of blocks
+					std::vector<size_t> order(messages.size());
+					std::iota(order.begin(), order.end(), size_t{0});
+					std::sort(order.begin(), order.end(),
+							  [&](size_t a, size_t b) { return messages[a]->size() < messages[b]->size(); });
+
+					std::array<const std::string*, Lanes> group{};
+					std::array<std::string, Lanes> digests;
+					std::array<const std::string*, Lanes> digest_ptrs{};
+					for (size_t l = 0; l < Lanes; l++)
+						digest_ptrs[l] = &digests[l];
+					for (size_t begin = 0; begin < order.size(); begin += Lanes) {
+						const auto count = std::min(Lanes, order.size() - begin);
+						for (size_t l = 0; l < count; l++)
+							group[l] = messages[order[begin + l]];
+						hash(inner, Hash::block_size, group.data(), count, digests.data());
+						hash(outer, Hash::block_size, digest_ptrs.data(), count, digests.data());
+						for (size_t l = 0; l < count; l++)
+							macs[order[begin + l]].assign(digests[l]);
+					}
+				}
+
+			private:
+				using state = std::array<word, 8>;
+				using lanes = typename lane_vector<word, Lanes>::type;
+
+				/// Size of the message length at the end of the padding
+				static constexpr size_t length_size = 2 * sizeof(word);
+
+				state inner{};
+				state outer{};
+
+				// Hash a single full block from the initial state without padding
+				static state absorb(const std::string* block) {
+					std::array<lanes, 8> st;
+					const auto iv = Hash::initial_state();
+					for (size_t i = 0; i < 8; i++)
+						st[i] = lanes{} + iv[i];
+					std::array<lanes, 16> words{};
+					load(reinterpret_cast<const unsigned char*>(block->data()), words, 0);
+					lanes mask{};
+					mask[0] = ~word{0};
+					compress(st, words, mask);
+					state res;
+					for (size_t i = 0; i < 8; i++)
+						res[i] = st[i][0];
+					return res;
+				}
+
+				/**
+				 * Hash up to `Lanes` messages, continuing from a state that already absorbed `prefix` bytes
+				 * \param start State to continue from
+				 * \param prefix Number of bytes absorbed by start, counted in the message length
+				 * \param messages Messages to hash
+				 * \param count Number of messages
+				 * \param digests Receives the digest of each message, may alias the messages
+				 */
+				static void hash(const state& start, size_t prefix, const std::string* const* messages, size_t count,
+								 std::string* digests) {
+					std::array<lanes, 8> st;
+					for (size_t i = 0; i < 8; i++)
+						st[i] = lanes{} + start[i];
+					std::array<size_t, Lanes> blocks{};
+					size_t max_blocks = 0;
+					for (size_t l = 0; l < count; l++) {
+						blocks[l] = (messages[l]->size() + 1 + length_size + Hash::block_size - 1) / Hash::block_size;
+						max_blocks = std::max(max_blocks, blocks[l]);
+					}
+
+					std::array<lanes, 16> words{};
+					lanes mask{};
+					unsigned char buffer[Hash::block_size];
+					for (size_t b = 0; b < max_blocks; b++) {
+						for (size_t l = 0; l < count; l++) {
+							mask[l] = b < blocks[l] ? ~word{0} : word{0};
+							if (b >= blocks[l]) continue;
+							const auto& msg = *messages[l];
+							const auto begin = b * Hash::block_size;
+							if (begin + Hash::block_size <= msg.size()) {
+								load(reinterpret_cast<const unsigned char*>(msg.data()) + begin, words, l);
+							} else {
+								pad_block(buffer, msg, begin, b + 1 == blocks[l], prefix + msg.size());
+								load(buffer, words, l);
+							}
+						}
+						compress(st, words, mask);
+					}
+
+					for (size_t l = 0; l < count; l++) {
+						auto& out = digests[l];
+						out.resize(Hash::digest_size);
+						for (size_t i = 0; i < Hash::digest_size; i++) {
+							const word w = st[i / sizeof(word)][l];
+							out[i] = static_cast<char>((w >> (8 * (sizeof(word) - 1 - i % sizeof(word)))) & 0xff);
+						}
+					}
+				}
+
+				// Build the block starting at begin of a padded message whose total length is total bytes
+				static void pad_block(unsigned char* buffer, const std::string& msg, size_t begin, bool last,
+									  size_t total) {
+					std::memset(buffer, 0, Hash::block_size);
+					if (begin < msg.size()) std::memcpy(buffer, msg.data() + begin, msg.size() - begin);
+					if (msg.size() >= begin) buffer[msg.size() - begin] = 0x80;
+					if (!last) return;
+					const auto bits = static_cast<uint64_t>(total) * 8;
+					for (size_t i = 0; i < 8; i++)
+						buffer[Hash::block_size - 1 - i] = static_cast<unsigned char>((bits >> (8 * i)) & 0xff);
+				}
+
+				// Load a big endian block into lane l
+				static void load(const unsigned char* buffer, std::array<lanes, 16>& words, size_t l) {
+					for (size_t i = 0; i < 16; i++) {
+						word w = 0;
+						for (size_t j = 0; j < sizeof(word); j++)
+							w = static_cast<word>((w << 8) | buffer[i * sizeof(word) + j]);
+						words[i][l] = w;
+					}
+				}
+
+				// One round on all lanes; instead of moving the working variables the caller rotates their roles
+				static void round(const lanes& a, const lanes& b, const lanes& c, lanes& d, const lanes& e,
+								  const lanes& f, const lanes& g, lanes& h, word k, const lanes& w) {
+					const lanes t1 = h + Hash::big_sigma1(e) + ((e & f) ^ (~e & g)) + k + w;
+					const lanes t2 = Hash::big_sigma0(a) + ((a & b) ^ (a & c) ^ (b & c));
+					d += t1;
+					h = t1 + t2;
+				}
+
+				// Compress one block per lane, only lanes with a set mask update their state
+				static void compress(std::array<lanes, 8>& st, std::array<lanes, 16>& w, const lanes& mask) {
+					lanes a = st[0], b = st[1], c = st[2], d = st[3], e = st[4], f = st[5], g = st[6], h = st[7];
+					const word* k = Hash::round_constants();
+					for (size_t t = 0; t < Hash::rounds; t += 8) {
+						if (t >= 16) {
+							for (size_t i = t; i < t + 8; i++)
+								w[i % 16] += Hash::small_sigma1(w[(i - 2) % 16]) + w[(i - 7) % 16] +
+											 Hash::small_sigma0(w[(i - 15) % 16]);
+						}
+						round(a, b, c, d, e, f, g, h, k[t], w[t % 16]);
+						round(h, a, b, c, d, e, f, g, k[t + 1], w[(t + 1) % 16]);
+						round(g, h, a, b, c, d, e, f, k[t + 2], w[(t + 2) % 16]);
+						round(f, g, h, a, b, c, d, e, k[t + 3], w[(t + 3) % 16]);
+						round(e, f, g, h, a, b, c, d, k[t + 4], w[(t + 4) % 16]);
+						round(d, e, f, g, h, a, b, c, k[t + 5], w[(t + 5) % 16]);
+						round(c, d, e, f, g, h, a, b, k[t + 6], w[(t + 6) % 16]);
+						round(b, c, d, e, f, g, h, a, k[t + 7], w[(t + 7) % 16]);
+					}
+					st[0] += a & mask;
+					st[1] += b & mask;
+					st[2] += c & mask;
+					st[3] += d & mask;
+					st[4] += e & mask;
+					st[5] += f & mask;
+					st[6] += g & mask;
+					st[7] += h & mask;
+				}
+			};
+		} // namespace details
+	} // namespace crypto
+} // namespace jwt
+
+#endif
@@ -1,15 +1,23 @@
 #ifndef JWT_CPP_OPENSSL_CRYPTO_H
 #define JWT_CPP_OPENSSL_CRYPTO_H
 
+#include <atomic>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
 #include <openssl/ec.h>
 #include <openssl/err.h>
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
 #include <openssl/pem.h>
+#include <openssl/rand.h>
 
 #include "error.h"
+#ifndef JWT_DISABLE_MULTI_BUFFER_HMAC
+#include "multi_buffer_hmac.h"
+#endif
 
 // If openssl version less than 1.1
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L // 3.0.0
@@ -26,6 +34,24 @@
 #define JWT_OPENSSL_1_0_0
 #endif
 
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L && !defined(LIBRESSL_VERSION_NUMBER) && !defined(OPENSSL_NO_ASYNC)
+#define JWT_OPENSSL_ASYNC
+#include <exception>
+#include <functional>
+#include <thread>
+#include <openssl/async.h>
+#ifndef _WIN32
+#include <cerrno>
+#include <poll.h>
+#endif
+#endif
+
+#ifdef JWT_OPENSSL_3_0
+#include <openssl/core_names.h>
+#include <openssl/param_build.h>
+#include <openssl/params.h>
+#endif
+
 // If openssl version less than 1.1.1
 #if OPENSSL_VERSION_NUMBER < 0x10101000L
 #define OPENSSL110
@@ -271,8 +297,451 @@ namespace jwt {
 					BN_free);
 			}
 
+			/**
+			 * \brief Create a public key from the modulus and exponent of an RSA JWK
+			 *
+			 * This is useful when working with JWKs that only contain the "n" and "e" members. More info
+			 * (here)[https://tools.ietf.org/html/rfc7518#section-6.3.1]
+			 *
+			 * \tparam Decode is callabled, taking a string_type and returns a string_type.
+			 * It should ensure the padding of the input and then base64url decode and return
+			 * the results.
+			 *
+			 * \param modulus	base64url encoded modulus ("n")
+			 * \param exponent	base64url encoded exponent ("e")
+			 * \param decode	The function to decode the components
+			 * \param ec		error_code for error_detection (gets cleared if no error occures)
+			 * \return public key encoded as pem
+			 */
+			template<typename Decode>
+			std::string create_public_key_from_rsa_components(const std::string& modulus, const std::string& exponent,
+															  Decode decode, std::error_code& ec) {
+				ec.clear();
+				auto n = helper::raw2bn(decode(modulus));
+				auto e = helper::raw2bn(decode(exponent));
+				if (!n || !e) {
+					ec = error::rsa_error::set_rsa_failed;
+					return {};
+				}
+
+				std::unique_ptr<BIO, decltype(&BIO_free_all)> keybio(BIO_new(BIO_s_mem()), BIO_free_all);
+				if (!keybio) {
+					ec = error::rsa_error::create_mem_bio_failed;
+					return {};
+				}
+
+#ifdef JWT_OPENSSL_3_0
+				std::unique_ptr<OSSL_PARAM_BLD, decltype(&OSSL_PARAM_BLD_free)> param_bld(OSSL_PARAM_BLD_new(),
+																						   OSSL_PARAM_BLD_free);
+				if (!param_bld || OSSL_PARAM_BLD_push_BN(param_bld.get(), OSSL_PKEY_PARAM_RSA_N, n.get()) != 1 ||
+					OSSL_PARAM_BLD_push_BN(param_bld.get(), OSSL_PKEY_PARAM_RSA_E, e.get()) != 1) {
+					ec = error::rsa_error::set_rsa_failed;
+					return {};
+				}
+				std::unique_ptr<OSSL_PARAM, decltype(&OSSL_PARAM_free)> params(OSSL_PARAM_BLD_to_param(param_bld.get()),
+																			   OSSL_PARAM_free);
+				std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> ctx(
+					EVP_PKEY_CTX_new_from_name(nullptr, "RSA", nullptr), EVP_PKEY_CTX_free);
+				if (!params || !ctx) {
+					ec = error::rsa_error::create_context_failed;
+					return {};
+				}
+				EVP_PKEY* raw = nullptr;
+				if (EVP_PKEY_fromdata_init(ctx.get()) <= 0 ||
+					EVP_PKEY_fromdata(ctx.get(), &raw, EVP_PKEY_PUBLIC_KEY, params.get()) <= 0) {
+					ec = error::rsa_error::set_rsa_failed;
+					return {};
+				}
+				std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> pkey(raw, EVP_PKEY_free);
+				if (PEM_write_bio_PUBKEY(keybio.get(), pkey.get()) != 1) {
+					ec = error::rsa_error::write_key_failed;
+					return {};
+				}
+#else
+				std::unique_ptr<RSA, decltype(&RSA_free)> rsa(RSA_new(), RSA_free);
+				if (!rsa) {
+					ec = error::rsa_error::create_context_failed;
+					return {};
+				}
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+				rsa->n = n.release();
+				rsa->e = e.release();
+#else
+				if (RSA_set0_key(rsa.get(), n.get(), e.get(), nullptr) != 1) {
+					ec = error::rsa_error::set_rsa_failed;
+					return {};
+				}
+				// ownership was transferred to rsa
+				n.release();
+				e.release();
+#endif
+				if (PEM_write_bio_RSA_PUBKEY(keybio.get(), rsa.get()) != 1) {
+					ec = error::rsa_error::write_key_failed;
+					return {};
+				}
+#endif
+
+				char* ptr = nullptr;
+				const auto len = BIO_get_mem_data(keybio.get(), &ptr);
+				if (len <= 0 || ptr == nullptr) {
+					ec = error::rsa_error::convert_to_pem_failed;
+					return {};
+				}
+				return {ptr, static_cast<size_t>(len)};
+			}
+
+			/**
+			 * \brief Create a public key from the coordinates of an EC JWK
+			 *
+			 * This is useful when working with JWKs that only contain the "crv", "x" and "y" members. More info
+			 * (here)[https://tools.ietf.org/html/rfc7518#section-6.2.1]
+			 *
+			 * \tparam Decode is callabled, taking a string_type and returns a string_type.
+			 * It should ensure the padding of the input and then base64url decode and return
+			 * the results.
+			 *
+			 * \param curve	JWA curve name ("P-256", "P-384" or "P-521")
+			 * \param x		base64url encoded x coordinate
+			 * \param y		base64url encoded y coordinate
+			 * \param decode	The function to decode the coordinates
+			 * \param ec		error_code for error_detection (gets cleared if no error occures)
+			 * \return public key encoded as pem
+			 */
+			template<typename Decode>
+			std::string create_public_key_from_ec_components(const std::string& curve, const std::string& x,
+															 const std::string& y, Decode decode,
+															 std::error_code& ec) {
+				ec.clear();
+				int nid = NID_undef;
+				if (curve == "P-256")
+					nid = NID_X9_62_prime256v1;
+				else if (curve == "P-384")
+					nid = NID_secp384r1;
+				else if (curve == "P-521")
+					nid = NID_secp521r1;
+				if (nid == NID_undef) {
+					ec = error::ecdsa_error::unknown_curve;
+					return {};
+				}
+
+				std::unique_ptr<BIO, decltype(&BIO_free_all)> keybio(BIO_new(BIO_s_mem()), BIO_free_all);
+				if (!keybio) {
+					ec = error::ecdsa_error::create_mem_bio_failed;
+					return {};
+				}
+
+#ifdef JWT_OPENSSL_3_0
+				// uncompressed point encoding, 0x04 || x || y
+				const std::string point = '\x04' + decode(x) + decode(y);
+				std::unique_ptr<OSSL_PARAM_BLD, decltype(&OSSL_PARAM_BLD_free)> param_bld(OSSL_PARAM_BLD_new(),
+																						   OSSL_PARAM_BLD_free);
+				const char* group = OBJ_nid2sn(nid);
+				if (!param_bld ||
+					OSSL_PARAM_BLD_push_utf8_string(param_bld.get(), OSSL_PKEY_PARAM_GROUP_NAME, group, 0) != 1 ||
+					OSSL_PARAM_BLD_push_octet_string(param_bld.get(), OSSL_PKEY_PARAM_PUB_KEY, point.data(),
+													 point.size()) != 1) {
+					ec = error::ecdsa_error::set_ecdsa_failed;
+					return {};
+				}
+				std::unique_ptr<OSSL_PARAM, decltype(&OSSL_PARAM_free)> params(OSSL_PARAM_BLD_to_param(param_bld.get()),
+																			   OSSL_PARAM_free);
+				std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> ctx(
+					EVP_PKEY_CTX_new_from_name(nullptr, "EC", nullptr), EVP_PKEY_CTX_free);
+				if (!params || !ctx) {
+					ec = error::ecdsa_error::create_context_failed;
+					return {};
+				}
+				EVP_PKEY* raw = nullptr;
+				if (EVP_PKEY_fromdata_init(ctx.get()) <= 0 ||
+					EVP_PKEY_fromdata(ctx.get(), &raw, EVP_PKEY_PUBLIC_KEY, params.get()) <= 0) {
+					ec = error::ecdsa_error::set_ecdsa_failed;
+					return {};
+				}
+				std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> pkey(raw, EVP_PKEY_free);
+				if (PEM_write_bio_PUBKEY(keybio.get(), pkey.get()) != 1) {
+					ec = error::ecdsa_error::write_key_failed;
+					return {};
+				}
+#else
+				std::unique_ptr<EC_KEY, decltype(&EC_KEY_free)> key(EC_KEY_new_by_curve_name(nid), EC_KEY_free);
+				if (!key) {
+					ec = error::ecdsa_error::create_context_failed;
+					return {};
+				}
+				auto qx = helper::raw2bn(decode(x));
+				auto qy = helper::raw2bn(decode(y));
+				if (!qx || !qy || EC_KEY_set_public_key_affine_coordinates(key.get(), qx.get(), qy.get()) != 1) {
+					ec = error::ecdsa_error::set_ecdsa_failed;
+					return {};
+				}
+				if (PEM_write_bio_EC_PUBKEY(keybio.get(), key.get()) != 1) {
+					ec = error::ecdsa_error::write_key_failed;
+					return {};
+				}
+#endif
+
+				char* ptr = nullptr;
+				const auto len = BIO_get_mem_data(keybio.get(), &ptr);
+				if (len <= 0 || ptr == nullptr) {
+					ec = error::ecdsa_error::write_key_failed;
+					return {};
+				}
+				return {ptr, static_cast<size_t>(len)};
+			}
+
 		} // namespace helper
 
+		namespace details {
+			/// Owning handle and copy operation for EVP_MD_CTX digest states
+			struct digest_state {
+				using type = EVP_MD_CTX;
+#ifdef OPENSSL10
+				static type* create() { return EVP_MD_CTX_create(); }
+				static void destroy(type* ctx) { EVP_MD_CTX_destroy(ctx); }
+#else
+				static type* create() { return EVP_MD_CTX_new(); }
+				static void destroy(type* ctx) { EVP_MD_CTX_free(ctx); }
+#endif
+				static bool copy(type* to, type* from) { return EVP_MD_CTX_copy_ex(to, from) == 1; }
+			};
+
+#if defined(JWT_OPENSSL_3_0)
+			/// Owning handle and copy operation for keyed EVP_MAC_CTX states
+			struct hmac_state {
+				struct type {
+					EVP_MAC_CTX* ctx;
+				};
+				static type* create() { return new (std::nothrow) type{nullptr}; }
+				static void destroy(type* state) {
+					if (state == nullptr) return;
+					EVP_MAC_CTX_free(state->ctx);
+					delete state;
+				}
+				static bool copy(type* to, type* from) {
+					auto* dup = EVP_MAC_CTX_dup(from->ctx);
+					if (dup == nullptr) return false;
+					EVP_MAC_CTX_free(to->ctx);
+					to->ctx = dup;
+					return true;
+				}
+			};
+#elif !defined(OPENSSL10)
+			/// Owning handle and copy operation for keyed HMAC_CTX states
+			struct hmac_state {
+				using type = HMAC_CTX;
+				static type* create() { return HMAC_CTX_new(); }
+				static void destroy(type* ctx) { HMAC_CTX_free(ctx); }
+				static bool copy(type* to, type* from) { return HMAC_CTX_copy(to, from) == 1; }
+			};
+#endif
+
+			/// Outcome of prefix_state_cache::resume
+			enum class resume_result { ok, init_failed, update_failed };
+
+			/**
+			 * \brief Bounded cache of hash states after absorbing a constant prefix
+			 *
+			 * Tokens of one issuer share a byte identical encoded header, so every signing input starts with the
+			 * same bytes. The state after hashing the block aligned part of the header (up to and including the
+			 * first '.') is stored keyed by those exact bytes, and later inputs with the same prefix resume from a
+			 * copy of it instead of hashing the prefix again.
+			 *
+			 * Only signing stores states, verification merely resumes from them. Headers of verified tokens are
+			 * chosen by whoever sent them and must not be able to take over the cache. Entries are never
+			 * replaced, once full the cache keeps the first headers signed, so lookups need no lock.
+			 *
+			 * Copies of an algorithm share one cache, all methods are thread safe.
+			 */
+			template<typename State>
+			class prefix_state_cache {
+			public:
+				/**
+				 * \param capacity Maximum number of prefixes kept
+				 * \param cache_unaligned Also keep states for prefixes shorter than one block. Worth it when
+				 * initializing the state does work of its own, like keying an HMAC.
+				 */
+				explicit prefix_state_cache(size_t capacity = 8, bool cache_unaligned = false)
+					: capacity(capacity), cache_unaligned(cache_unaligned), slots(new std::atomic<entry*>[capacity]) {
+					for (size_t i = 0; i < capacity; i++)
+						slots[i].store(nullptr, std::memory_order_relaxed);
+				}
+				prefix_state_cache(const prefix_state_cache&) = delete;
+				prefix_state_cache& operator=(const prefix_state_cache&) = delete;
+				~prefix_state_cache() {
+					for (size_t i = 0; i < capacity; i++)
+						delete slots[i].load(std::memory_order_relaxed);
+				}
+
+				/**
+				 * Initialize a state and absorb the start of the data, from the cache where possible
+				 * \param state Fresh state to initialize
+				 * \param data Input about to be hashed
+				 * \param block_size Block size of the hash function
+				 * \param init Callable initializing a state, returns false on failure
+				 * \param update Callable absorbing `(state, data, size)`, returns false on failure
+				 * \param consumed Set to the number of leading bytes of data absorbed into the state
+				 * \param remember Store the state for the prefix if it is not cached yet, only pass true when signing
+				 * \return Whether initializing or absorbing the prefix failed
+				 */
+				template<typename Init, typename Update>
+				resume_result resume(typename State::type* state, const std::string& data, size_t block_size,
+									 Init init, Update update, size_t& consumed, bool remember) {
+					consumed = 0;
+					const auto dot = data.find('.');
+					const auto length = dot == std::string::npos || block_size == 0
+											? 0
+											: (dot + 1) / block_size * block_size;
+					if (dot == std::string::npos || (length == 0 && !cache_unaligned) || capacity == 0)
+						return init(state) ? resume_result::ok : resume_result::init_failed;
+
+					if (const auto* e = find(data, length)) {
+						if (!State::copy(state, e->state.get())) return resume_result::init_failed;
+						consumed = length;
+						return resume_result::ok;
+					}
+
+					if (!init(state)) return resume_result::init_failed;
+					if (length != 0 && !update(state, data.data(), length)) return resume_result::update_failed;
+					consumed = length;
+					if (remember) store(state, data, length);
+					return resume_result::ok;
+				}
+
+			private:
+				using state_ptr = std::unique_ptr<typename State::type, decltype(&State::destroy)>;
+				struct entry {
+					std::string prefix;
+					state_ptr state;
+				};
+
+				const size_t capacity;
+				const bool cache_unaligned;
+				// Filled front to back, an entry is immutable once published
+				std::unique_ptr<std::atomic<entry*>[]> slots;
+				std::mutex store_mutex;
+
+				const entry* find(const std::string& data, size_t length) const {
+					for (size_t i = 0; i < capacity; i++) {
+						const auto* e = slots[i].load(std::memory_order_acquire);
+						if (e == nullptr) break;
+						if (e->prefix.size() == length && data.compare(0, length, e->prefix) == 0) return e;
+					}
+					return nullptr;
+				}
+
+				void store(typename State::type* state, const std::string& data, size_t length) {
+					std::lock_guard<std::mutex> lock(store_mutex);
+					size_t free = 0;
+					while (free < capacity && slots[free].load(std::memory_order_relaxed) != nullptr)
+						free++;
+					if (free == capacity || find(data, length) != nullptr) return;
+					state_ptr copy(State::create(), &State::destroy);
+					if (!copy || !State::copy(copy.get(), state)) return;
+					slots[free].store(new entry{data.substr(0, length), std::move(copy)}, std::memory_order_release);
+				}
+			};
+
+			using digest_prefix_cache = prefix_state_cache<digest_state>;
+
+			/**
+			 * Initialize a digest state for hashing data, resuming from a cached prefix state where possible
+			 * \param cache Cache to use
+			 * \param ctx Fresh digest state
+			 * \param md Hash function
+			 * \param data Input about to be hashed
+			 * \param consumed Set to the number of leading bytes of data absorbed into the state
+			 * \param remember Store the state after the prefix, only true when signing
+			 * \return Whether initializing or absorbing the prefix failed
+			 */
+			inline resume_result resume_digest(digest_prefix_cache& cache, EVP_MD_CTX* ctx, const EVP_MD* md,
+											   const std::string& data, size_t& consumed, bool remember) {
+				return cache.resume(
+					ctx, data, static_cast<size_t>(EVP_MD_block_size(md)),
+					[md](EVP_MD_CTX* c) { return EVP_DigestInit(c, md) != 0; },
+					[](EVP_MD_CTX* c, const char* ptr, size_t size) { return EVP_DigestUpdate(c, ptr, size) != 0; },
+					consumed, remember);
+			}
+
+			/**
+			 * Hash data handed over in chunks
+			 * \param md Hash function
+			 * \param source Callable passing every chunk of the data to the `bool(const char*, size_t)` sink it is
+			 * given, returns false if reading the data or the sink failed
+			 * \param ec Filled with details on error
+			 * \return Hash of the data
+			 */
+			template<typename Source>
+			std::string hash_stream(const EVP_MD* md, const Source& source, std::error_code& ec) {
+				std::unique_ptr<EVP_MD_CTX, decltype(&digest_state::destroy)> ctx(digest_state::create(),
+																				  digest_state::destroy);
+				if (!ctx) {
+					ec = error::signature_generation_error::create_context_failed;
+					return {};
+				}
+				if (EVP_DigestInit_ex(ctx.get(), md, nullptr) == 0) {
+					ec = error::signature_generation_error::digestinit_failed;
+					return {};
+				}
+				const auto update = [&ctx](const char* ptr, size_t size) {
+					return EVP_DigestUpdate(ctx.get(), ptr, size) != 0;
+				};
+				if (!source(update)) {
+					ec = error::signature_generation_error::digestupdate_failed;
+					return {};
+				}
+				std::string res(static_cast<size_t>(EVP_MAX_MD_SIZE), '\0');
+				unsigned int len = 0;
+				if (EVP_DigestFinal_ex(ctx.get(), reinterpret_cast<unsigned char*>(&res[0]), &len) == 0) {
+					ec = error::signature_generation_error::digestfinal_failed;
+					return {};
+				}
+				res.resize(len);
+				return res;
+			}
+
+#ifndef JWT_DISABLE_MULTI_BUFFER_HMAC
+			/**
+			 * Create the multi-buffer HMAC engine for a hash function
+			 * \param key HMAC key
+			 * \param md Hash function
+			 * \return Engine, or nullptr if the hash function is not SHA-256, SHA-384 or SHA-512
+			 */
+			inline std::shared_ptr<const batch_hmac> make_batch_hmac(const std::string& key, const EVP_MD* md) {
+				switch (EVP_MD_type(md)) {
+				case NID_sha256: return std::make_shared<multi_buffer_hmac<sha256_traits>>(key);
+				case NID_sha384: return std::make_shared<multi_buffer_hmac<sha384_traits>>(key);
+				case NID_sha512: return std::make_shared<multi_buffer_hmac<sha512_traits>>(key);
+				default: return nullptr;
+				}
+			}
+#endif
+
+			/**
+			 * Fill a string with random bytes
+			 * \param size Number of bytes
+			 * \param out Replaced by the random bytes
+			 * \return false if the random number generator failed
+			 */
+			inline bool random_bytes(size_t size, std::string& out) {
+				out.assign(size, '\0');
+				return size == 0 ||
+					   RAND_bytes(reinterpret_cast<unsigned char*>(&out[0]), static_cast<int>(size)) == 1;
+			}
+
+			/**
+			 * Encode an unsigned integer big endian
+			 * \param value Value to encode
+			 * \param bytes Number of bytes to produce
+			 * \return Encoded value
+			 */
+			inline std::string big_endian(uint64_t value, size_t bytes) {
+				std::string res(bytes, '\0');
+				for (size_t i = bytes; i > 0; i--, value >>= 8)
+					res[i - 1] = static_cast<char>(value & 0xFFU);
+				return res;
+			}
+		} // namespace details
+
 		/**
 		 * \brief Various cryptographic algorithms when working with JWT
 		 *
@@ -295,7 +764,14 @@ namespace jwt {
 				 * \param name Name of the algorithm
 				 */
 				hmacsha(std::string key, const EVP_MD* (*md)(), std::string name)
-					: secret(std::move(key)), md(md), alg_name(std::move(name)) {}
+					: secret(std::move(key)), md(md), alg_name(std::move(name)) {
+#ifdef JWT_OPENSSL_3_0
+					mac = std::shared_ptr<EVP_MAC>(EVP_MAC_fetch(nullptr, OSSL_MAC_NAME_HMAC, nullptr), EVP_MAC_free);
+#endif
+#ifndef JWT_DISABLE_MULTI_BUFFER_HMAC
+					batch_engine = details::make_batch_hmac(secret, md());
+#endif
+				}
 				/**
 				 * Sign jwt data
 				 * \param data The data to sign
@@ -304,12 +780,51 @@ namespace jwt {
 				 */
 				std::string sign(const std::string& data, std::error_code& ec) const {
 					ec.clear();
+					return compute(data, ec, true);
+				}
+
+				/**
+				 * Check if signature is valid
+				 * \param data The data to check signature against
+				 * \param signature Signature provided by the jwt
+				 * \param ec Filled with details about failure.
+				 */
+				void verify(const std::string& data, const std::string& signature, std::error_code& ec) const {
+					ec.clear();
+					auto res = compute(data, ec, false);
+					if (ec) return;
+
+					if (!matches(res, signature)) {
+						ec = error::signature_verification_error::invalid_signature;
+						return;
+					}
+				}
+
+				/**
+				 * Sign data handed over in chunks, without holding it in memory at once
+				 * \param source Callable passing every chunk of the data to the `bool(const char*, size_t)` sink it
+				 * is given, returns false if reading the data or the sink failed
+				 * \param ec error_code filled with details on error
+				 * \return HMAC signature for the data
+				 */
+				template<typename Source>
+				std::string sign_stream(const Source& source, std::error_code& ec) const {
+					ec.clear();
+					std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(
+						EVP_PKEY_new_mac_key(EVP_PKEY_HMAC, nullptr,
+											 reinterpret_cast<const unsigned char*>(secret.data()),
+											 static_cast<int>(secret.size())),
+						EVP_PKEY_free);
+					std::unique_ptr<EVP_MD_CTX, decltype(&details::digest_state::destroy)> ctx(
+						details::digest_state::create(), details::digest_state::destroy);
+					const auto update = [&ctx](const char* ptr, size_t size) {
+						return EVP_DigestSignUpdate(ctx.get(), ptr, size) == 1;
+					};
 					std::string res(static_cast<size_t>(EVP_MAX_MD_SIZE), '\0');
-					auto len = static_cast<unsigned int>(res.size());
-					if (HMAC(md(), secret.data(), static_cast<int>(secret.size()),
-							 reinterpret_cast<const unsigned char*>(data.data()), static_cast<int>(data.size()),
-							 (unsigned char*)res.data(), // NOLINT(google-readability-casting) requires `const_cast`
-							 &len) == nullptr) {
+					size_t len = res.size();
+					if (!key || !ctx || EVP_DigestSignInit(ctx.get(), nullptr, md(), nullptr, key.get()) != 1 ||
+						!source(update) ||
+						EVP_DigestSignFinal(ctx.get(), reinterpret_cast<unsigned char*>(&res[0]), &len) != 1) {
 						ec = error::signature_generation_error::hmac_failed;
 						return {};
 					}
@@ -318,24 +833,53 @@ namespace jwt {
 				}
 
 				/**
-				 * Check if signature is valid
-				 * \param data The data to check signature against
+				 * Check if the signature of data handed over in chunks is valid
+				 * \param source Callable passing every chunk of the data to the `bool(const char*, size_t)` sink it
+				 * is given, returns false if reading the data or the sink failed
 				 * \param signature Signature provided by the jwt
 				 * \param ec Filled with details about failure.
 				 */
-				void verify(const std::string& data, const std::string& signature, std::error_code& ec) const {
-					ec.clear();
-					auto res = sign(data, ec);
+				template<typename Source>
+				void verify_stream(const Source& source, const std::string& signature, std::error_code& ec) const {
+					auto res = sign_stream(source, ec);
 					if (ec) return;
+					if (!matches(res, signature)) ec = error::signature_verification_error::invalid_signature;
+				}
 
-					bool matched = true;
-					for (size_t i = 0; i < std::min<size_t>(res.size(), signature.size()); i++)
-						if (res[i] != signature[i]) matched = false;
-					if (res.size() != signature.size()) matched = false;
-					if (!matched) {
-						ec = error::signature_verification_error::invalid_signature;
+				/**
+				 * Check the signatures of many tokens signed with this key
+				 *
+				 * For SHA-256, SHA-384 and SHA-512 the signing inputs are hashed several at a time by a built-in
+				 * multi-buffer engine, starting from keyed states computed once per key. Other hash functions, or
+				 * builds defining `JWT_DISABLE_MULTI_BUFFER_HMAC`, check every token with OpenSSL through verify().
+				 *
+				 * \param data Signing inputs of the tokens
+				 * \param signatures Signature of each token, tokens without a signature fail
+				 * \param ec Resized to the number of signing inputs and filled with the result of each token
+				 */
+				void verify_batch(const std::vector<std::string>& data, const std::vector<std::string>& signatures,
+								  std::vector<std::error_code>& ec) const {
+					ec.assign(data.size(), std::error_code{});
+#ifndef JWT_DISABLE_MULTI_BUFFER_HMAC
+					if (batch_engine) {
+						std::vector<const std::string*> inputs;
+						inputs.reserve(data.size());
+						for (const auto& d : data)
+							inputs.push_back(&d);
+						std::vector<std::string> macs;
+						batch_engine->compute(inputs, macs);
+						for (size_t i = 0; i < data.size(); i++)
+							if (i >= signatures.size() || !matches(macs[i], signatures[i]))
+								ec[i] = error::signature_verification_error::invalid_signature;
 						return;
 					}
+#endif
+					for (size_t i = 0; i < data.size(); i++) {
+						if (i < signatures.size())
+							verify(data[i], signatures[i], ec[i]);
+						else
+							ec[i] = error::signature_verification_error::invalid_signature;
+					}
 				}
 
 				/**
@@ -351,6 +895,90 @@ namespace jwt {
 				const EVP_MD* (*md)();
 				/// algorithm's name
 				const std::string alg_name;
+#ifndef JWT_DISABLE_MULTI_BUFFER_HMAC
+				/// Multi-buffer engine used by verify_batch, nullptr if not available for the hash function
+				std::shared_ptr<const details::batch_hmac> batch_engine;
+#endif
+#ifdef JWT_OPENSSL_3_0
+				/// HMAC implementation, fetched once
+				std::shared_ptr<EVP_MAC> mac;
+#endif
+#ifndef OPENSSL10
+				/// Keyed HMAC states after absorbing the headers signed so far
+				std::shared_ptr<details::prefix_state_cache<details::hmac_state>> prefix_cache{
+					std::make_shared<details::prefix_state_cache<details::hmac_state>>(8, true)};
+#endif
+
+				// Resumes from the keyed state that already absorbed the header, remember is only set when signing
+				std::string compute(const std::string& data, std::error_code& ec, bool remember) const {
+					std::string res(static_cast<size_t>(EVP_MAX_MD_SIZE), '\0');
+#if defined(OPENSSL10)
+					auto len = static_cast<unsigned int>(res.size());
+					if (HMAC(md(), secret.data(), static_cast<int>(secret.size()),
+							 reinterpret_cast<const unsigned char*>(data.data()), static_cast<int>(data.size()),
+							 (unsigned char*)res.data(), // NOLINT(google-readability-casting) requires `const_cast`
+							 &len) == nullptr) {
+						ec = error::signature_generation_error::hmac_failed;
+						return {};
+					}
+#elif defined(JWT_OPENSSL_3_0)
+					using state_type = details::hmac_state::type;
+					std::unique_ptr<state_type, decltype(&details::hmac_state::destroy)> state(
+						details::hmac_state::create(), details::hmac_state::destroy);
+					const auto init = [this](state_type* c) {
+						if (!mac) return false;
+						c->ctx = EVP_MAC_CTX_new(mac.get());
+						const auto* key = reinterpret_cast<const unsigned char*>(secret.data());
+						const OSSL_PARAM params[] = {
+							OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+															 const_cast<char*>(EVP_MD_get0_name(md())), 0),
+							OSSL_PARAM_construct_end()};
+						return c->ctx != nullptr && EVP_MAC_init(c->ctx, key, secret.size(), params) == 1;
+					};
+					const auto update = [](state_type* c, const char* ptr, size_t size) {
+						return EVP_MAC_update(c->ctx, reinterpret_cast<const unsigned char*>(ptr), size) == 1;
+					};
+					size_t consumed = 0;
+					size_t len = 0;
+					if (!state ||
+						prefix_cache->resume(state.get(), data, static_cast<size_t>(EVP_MD_block_size(md())), init,
+											 update, consumed, remember) != details::resume_result::ok ||
+						!update(state.get(), data.data() + consumed, data.size() - consumed) ||
+						EVP_MAC_final(state->ctx, reinterpret_cast<unsigned char*>(&res[0]), &len, res.size()) != 1) {
+						ec = error::signature_generation_error::hmac_failed;
+						return {};
+					}
+#else
+					auto len = static_cast<unsigned int>(res.size());
+					std::unique_ptr<HMAC_CTX, decltype(&HMAC_CTX_free)> ctx(HMAC_CTX_new(), HMAC_CTX_free);
+					const auto init = [this](HMAC_CTX* c) {
+						return HMAC_Init_ex(c, secret.data(), static_cast<int>(secret.size()), md(), nullptr) == 1;
+					};
+					const auto update = [](HMAC_CTX* c, const char* ptr, size_t size) {
+						return HMAC_Update(c, reinterpret_cast<const unsigned char*>(ptr), size) == 1;
+					};
+					size_t consumed = 0;
+					if (!ctx ||
+						prefix_cache->resume(ctx.get(), data, static_cast<size_t>(EVP_MD_block_size(md())), init,
+											 update, consumed, remember) != details::resume_result::ok ||
+						!update(ctx.get(), data.data() + consumed, data.size() - consumed) ||
+						HMAC_Final(ctx.get(), reinterpret_cast<unsigned char*>(&res[0]), &len) != 1) {
+						ec = error::signature_generation_error::hmac_failed;
+						return {};
+					}
+#endif
+					res.resize(len);
+					return res;
+				}
+
+				// Compare without returning early on the first difference
+				static bool matches(const std::string& res, const std::string& signature) {
+					bool matched = true;
+					for (size_t i = 0; i < std::min<size_t>(res.size(), signature.size()); i++)
+						if (res[i] != signature[i]) matched = false;
+					if (res.size() != signature.size()) matched = false;
+					return matched;
+				}
 			};
 
 			/**
@@ -396,7 +1024,9 @@ namespace jwt {
 						ec = error::signature_generation_error::create_context_failed;
 						return {};
 					}
-					if (!EVP_SignInit(ctx.get(), md())) {
+					size_t consumed = 0;
+					const auto resumed = details::resume_digest(*prefix_cache, ctx.get(), md(), data, consumed, true);
+					if (resumed == details::resume_result::init_failed) {
 						ec = error::signature_generation_error::signinit_failed;
 						return {};
 					}
@@ -404,7 +1034,8 @@ namespace jwt {
 					std::string res(EVP_PKEY_size(pkey.get()), '\0');
 					unsigned int len = 0;
 
-					if (!EVP_SignUpdate(ctx.get(), data.data(), data.size())) {
+					if (resumed == details::resume_result::update_failed ||
+						!EVP_SignUpdate(ctx.get(), data.data() + consumed, data.size() - consumed)) {
 						ec = error::signature_generation_error::signupdate_failed;
 						return {};
 					}
@@ -435,11 +1066,14 @@ namespace jwt {
 						ec = error::signature_verification_error::create_context_failed;
 						return;
 					}
-					if (!EVP_VerifyInit(ctx.get(), md())) {
+					size_t consumed = 0;
+					const auto resumed = details::resume_digest(*prefix_cache, ctx.get(), md(), data, consumed, false);
+					if (resumed == details::resume_result::init_failed) {
 						ec = error::signature_verification_error::verifyinit_failed;
 						return;
 					}
-					if (!EVP_VerifyUpdate(ctx.get(), data.data(), data.size())) {
+					if (resumed == details::resume_result::update_failed ||
+						!EVP_VerifyUpdate(ctx.get(), data.data() + consumed, data.size() - consumed)) {
 						ec = error::signature_verification_error::verifyupdate_failed;
 						return;
 					}
@@ -452,24 +1086,96 @@ namespace jwt {
 				}
 
 				/**
-				 * Returns the algorithm name provided to the constructor
-				 * \return algorithm's name
+				 * Sign data handed over in chunks, without holding it in memory at once
+				 * \param source Callable passing every chunk of the data to the `bool(const char*, size_t)` sink it
+				 * is given, returns false if reading the data or the sink failed
+				 * \param ec error_code filled with details on error
+				 * \return RSA signature for the data
 				 */
-				std::string name() const { return alg_name; }
-
-			private:
-				/// OpenSSL structure containing converted keys
-				std::shared_ptr<EVP_PKEY> pkey;
-				/// Hash generator
-				const EVP_MD* (*md)();
-				/// algorithm's name
-				const std::string alg_name;
-			};
-
-			/**
-			 * \brief Base class for ECDSA family of algorithms
-			 */
-			struct ecdsa {
+				template<typename Source>
+				std::string sign_stream(const Source& source, std::error_code& ec) const {
+					ec.clear();
+					std::unique_ptr<EVP_MD_CTX, decltype(&details::digest_state::destroy)> ctx(
+						details::digest_state::create(), details::digest_state::destroy);
+					if (!ctx) {
+						ec = error::signature_generation_error::create_context_failed;
+						return {};
+					}
+					if (!EVP_SignInit_ex(ctx.get(), md(), nullptr)) {
+						ec = error::signature_generation_error::signinit_failed;
+						return {};
+					}
+					const auto update = [&ctx](const char* ptr, size_t size) {
+						return EVP_SignUpdate(ctx.get(), ptr, size) != 0;
+					};
+					if (!source(update)) {
+						ec = error::signature_generation_error::signupdate_failed;
+						return {};
+					}
+					std::string res(EVP_PKEY_size(pkey.get()), '\0');
+					unsigned int len = 0;
+					if (EVP_SignFinal(ctx.get(), reinterpret_cast<unsigned char*>(&res[0]), &len, pkey.get()) == 0) {
+						ec = error::signature_generation_error::signfinal_failed;
+						return {};
+					}
+					res.resize(len);
+					return res;
+				}
+
+				/**
+				 * Check if the signature of data handed over in chunks is valid
+				 * \param source Callable passing every chunk of the data to the `bool(const char*, size_t)` sink it
+				 * is given, returns false if reading the data or the sink failed
+				 * \param signature Signature provided by the jwt
+				 * \param ec Filled with details on failure
+				 */
+				template<typename Source>
+				void verify_stream(const Source& source, const std::string& signature, std::error_code& ec) const {
+					ec.clear();
+					std::unique_ptr<EVP_MD_CTX, decltype(&details::digest_state::destroy)> ctx(
+						details::digest_state::create(), details::digest_state::destroy);
+					if (!ctx) {
+						ec = error::signature_verification_error::create_context_failed;
+						return;
+					}
+					if (!EVP_VerifyInit_ex(ctx.get(), md(), nullptr)) {
+						ec = error::signature_verification_error::verifyinit_failed;
+						return;
+					}
+					const auto update = [&ctx](const char* ptr, size_t size) {
+						return EVP_VerifyUpdate(ctx.get(), ptr, size) != 0;
+					};
+					if (!source(update)) {
+						ec = error::signature_verification_error::verifyupdate_failed;
+						return;
+					}
+					if (EVP_VerifyFinal(ctx.get(), reinterpret_cast<const unsigned char*>(signature.data()),
+										static_cast<unsigned int>(signature.size()), pkey.get()) != 1)
+						ec = error::signature_verification_error::verifyfinal_failed;
+				}
+
+				/**
+				 * Returns the algorithm name provided to the constructor
+				 * \return algorithm's name
+				 */
+				std::string name() const { return alg_name; }
+
+			private:
+				/// OpenSSL structure containing converted keys
+				std::shared_ptr<EVP_PKEY> pkey;
+				/// Hash generator
+				const EVP_MD* (*md)();
+				/// algorithm's name
+				const std::string alg_name;
+				/// Digest states after absorbing the headers seen so far
+				std::shared_ptr<details::digest_prefix_cache> prefix_cache{
+					std::make_shared<details::digest_prefix_cache>()};
+			};
+
+			/**
+			 * \brief Base class for ECDSA family of algorithms
+			 */
+			struct ecdsa {
 				/**
 				 * Construct new ecdsa algorithm
 				 * \param public_key ECDSA public key in PEM format
@@ -533,9 +1239,63 @@ namespace jwt {
 				 */
 				std::string sign(const std::string& data, std::error_code& ec) const {
 					ec.clear();
-					const std::string hash = generate_hash(data, ec);
+					const std::string hash = generate_hash(data, ec, true);
+					if (ec) return {};
+					return sign_hash(hash, ec);
+				}
+
+				/**
+				 * Check if signature is valid
+				 * \param data The data to check signature against
+				 * \param signature Signature provided by the jwt
+				 * \param ec Filled with details on error
+				 */
+				void verify(const std::string& data, const std::string& signature, std::error_code& ec) const {
+					ec.clear();
+					const std::string hash = generate_hash(data, ec, false);
+					if (ec) return;
+					verify_hash(hash, signature, ec);
+				}
+
+				/**
+				 * Sign data handed over in chunks, without holding it in memory at once
+				 * \param source Callable passing every chunk of the data to the `bool(const char*, size_t)` sink it
+				 * is given, returns false if reading the data or the sink failed
+				 * \param ec error_code filled with details on error
+				 * \return ECDSA signature for the data
+				 */
+				template<typename Source>
+				std::string sign_stream(const Source& source, std::error_code& ec) const {
+					ec.clear();
+					const auto hash = details::hash_stream(md(), source, ec);
 					if (ec) return {};
+					return sign_hash(hash, ec);
+				}
+
+				/**
+				 * Check if the signature of data handed over in chunks is valid
+				 * \param source Callable passing every chunk of the data to the `bool(const char*, size_t)` sink it
+				 * is given, returns false if reading the data or the sink failed
+				 * \param signature Signature provided by the jwt
+				 * \param ec Filled with details on error
+				 */
+				template<typename Source>
+				void verify_stream(const Source& source, const std::string& signature, std::error_code& ec) const {
+					ec.clear();
+					const auto hash = details::hash_stream(md(), source, ec);
+					if (ec) return;
+					verify_hash(hash, signature, ec);
+				}
+
+				/**
+				 * Returns the algorithm name provided to the constructor
+				 * \return algorithm's name
+				 */
+				std::string name() const { return alg_name; }
 
+			private:
+				// Sign the hash of the data
+				std::string sign_hash(const std::string& hash, std::error_code& ec) const {
 					std::unique_ptr<ECDSA_SIG, decltype(&ECDSA_SIG_free)> sig(
 						ECDSA_do_sign(reinterpret_cast<const unsigned char*>(hash.data()),
 									  static_cast<int>(hash.size()), pkey.get()),
@@ -562,16 +1322,8 @@ namespace jwt {
 					return rr + rs;
 				}
 
-				/**
-				 * Check if signature is valid
-				 * \param data The data to check signature against
-				 * \param signature Signature provided by the jwt
-				 * \param ec Filled with details on error
-				 */
-				void verify(const std::string& data, const std::string& signature, std::error_code& ec) const {
-					ec.clear();
-					const std::string hash = generate_hash(data, ec);
-					if (ec) return;
+				// Check the signature against the hash of the data
+				void verify_hash(const std::string& hash, const std::string& signature, std::error_code& ec) const {
 					auto r = helper::raw2bn(signature.substr(0, signature.size() / 2));
 					auto s = helper::raw2bn(signature.substr(signature.size() / 2));
 
@@ -602,19 +1354,13 @@ namespace jwt {
 #endif
 				}
 
-				/**
-				 * Returns the algorithm name provided to the constructor
-				 * \return algorithm's name
-				 */
-				std::string name() const { return alg_name; }
-
-			private:
 				/**
 				 * Hash the provided data using the hash function specified in constructor
 				 * \param data Data to hash
+				 * \param remember Cache the state after the header, only true when signing
 				 * \return Hash of data
 				 */
-				std::string generate_hash(const std::string& data, std::error_code& ec) const {
+				std::string generate_hash(const std::string& data, std::error_code& ec, bool remember) const {
 #ifdef OPENSSL10
 					std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_destroy)> ctx(EVP_MD_CTX_create(),
 																				   &EVP_MD_CTX_destroy);
@@ -625,11 +1371,15 @@ namespace jwt {
 						ec = error::signature_generation_error::create_context_failed;
 						return {};
 					}
-					if (EVP_DigestInit(ctx.get(), md()) == 0) {
+					size_t consumed = 0;
+					const auto resumed =
+						details::resume_digest(*prefix_cache, ctx.get(), md(), data, consumed, remember);
+					if (resumed == details::resume_result::init_failed) {
 						ec = error::signature_generation_error::digestinit_failed;
 						return {};
 					}
-					if (EVP_DigestUpdate(ctx.get(), data.data(), data.size()) == 0) {
+					if (resumed == details::resume_result::update_failed ||
+						EVP_DigestUpdate(ctx.get(), data.data() + consumed, data.size() - consumed) == 0) {
 						ec = error::signature_generation_error::digestupdate_failed;
 						return {};
 					}
@@ -654,6 +1404,9 @@ namespace jwt {
 				const std::string alg_name;
 				/// Length of the resulting signature
 				const size_t signature_length;
+				/// Digest states after absorbing the headers seen so far
+				std::shared_ptr<details::digest_prefix_cache> prefix_cache{
+					std::make_shared<details::digest_prefix_cache>()};
 			};
 
 #ifndef OPENSSL110
@@ -825,9 +1578,63 @@ namespace jwt {
 				 */
 				std::string sign(const std::string& data, std::error_code& ec) const {
 					ec.clear();
-					auto hash = this->generate_hash(data, ec);
+					auto hash = this->generate_hash(data, ec, true);
+					if (ec) return {};
+					return sign_hash(hash, ec);
+				}
+
+				/**
+				 * Check if signature is valid
+				 * \param data The data to check signature against
+				 * \param signature Signature provided by the jwt
+				 * \param ec Filled with error details
+				 */
+				void verify(const std::string& data, const std::string& signature, std::error_code& ec) const {
+					ec.clear();
+					auto hash = this->generate_hash(data, ec, false);
+					if (ec) return;
+					verify_hash(hash, signature, ec);
+				}
+
+				/**
+				 * Sign data handed over in chunks, without holding it in memory at once
+				 * \param source Callable passing every chunk of the data to the `bool(const char*, size_t)` sink it
+				 * is given, returns false if reading the data or the sink failed
+				 * \param ec error_code filled with details on error
+				 * \return PSS signature for the data
+				 */
+				template<typename Source>
+				std::string sign_stream(const Source& source, std::error_code& ec) const {
+					ec.clear();
+					const auto hash = details::hash_stream(md(), source, ec);
 					if (ec) return {};
+					return sign_hash(hash, ec);
+				}
+
+				/**
+				 * Check if the signature of data handed over in chunks is valid
+				 * \param source Callable passing every chunk of the data to the `bool(const char*, size_t)` sink it
+				 * is given, returns false if reading the data or the sink failed
+				 * \param signature Signature provided by the jwt
+				 * \param ec Filled with details on error
+				 */
+				template<typename Source>
+				void verify_stream(const Source& source, const std::string& signature, std::error_code& ec) const {
+					ec.clear();
+					const auto hash = details::hash_stream(md(), source, ec);
+					if (ec) return;
+					verify_hash(hash, signature, ec);
+				}
+
+				/**
+				 * Returns the algorithm name provided to the constructor
+				 * \return algorithm's name
+				 */
+				std::string name() const { return alg_name; }
 
+			private:
+				// Sign the hash of the data
+				std::string sign_hash(const std::string& hash, std::error_code& ec) const {
 					std::unique_ptr<RSA, decltype(&RSA_free)> key(EVP_PKEY_get1_RSA(pkey.get()), RSA_free);
 					if (!key) {
 						ec = error::signature_generation_error::get_key_failed;
@@ -854,17 +1661,8 @@ namespace jwt {
 					return res;
 				}
 
-				/**
-				 * Check if signature is valid
-				 * \param data The data to check signature against
-				 * \param signature Signature provided by the jwt
-				 * \param ec Filled with error details
-				 */
-				void verify(const std::string& data, const std::string& signature, std::error_code& ec) const {
-					ec.clear();
-					auto hash = this->generate_hash(data, ec);
-					if (ec) return;
-
+				// Check the signature against the hash of the data
+				void verify_hash(const std::string& hash, const std::string& signature, std::error_code& ec) const {
 					std::unique_ptr<RSA, decltype(&RSA_free)> key(EVP_PKEY_get1_RSA(pkey.get()), RSA_free);
 					if (!key) {
 						ec = error::signature_verification_error::get_key_failed;
@@ -889,19 +1687,13 @@ namespace jwt {
 					}
 				}
 
-				/**
-				 * Returns the algorithm name provided to the constructor
-				 * \return algorithm's name
-				 */
-				std::string name() const { return alg_name; }
-
-			private:
 				/**
 				 * Hash the provided data using the hash function specified in constructor
 				 * \param data Data to hash
+				 * \param remember Cache the state after the header, only true when signing
 				 * \return Hash of data
 				 */
-				std::string generate_hash(const std::string& data, std::error_code& ec) const {
+				std::string generate_hash(const std::string& data, std::error_code& ec, bool remember) const {
 #ifdef OPENSSL10
 					std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_destroy)> ctx(EVP_MD_CTX_create(),
 																				   &EVP_MD_CTX_destroy);
@@ -912,11 +1704,15 @@ namespace jwt {
 						ec = error::signature_generation_error::create_context_failed;
 						return {};
 					}
-					if (EVP_DigestInit(ctx.get(), md()) == 0) {
+					size_t consumed = 0;
+					const auto resumed =
+						details::resume_digest(*prefix_cache, ctx.get(), md(), data, consumed, remember);
+					if (resumed == details::resume_result::init_failed) {
 						ec = error::signature_generation_error::digestinit_failed;
 						return {};
 					}
-					if (EVP_DigestUpdate(ctx.get(), data.data(), data.size()) == 0) {
+					if (resumed == details::resume_result::update_failed ||
+						EVP_DigestUpdate(ctx.get(), data.data() + consumed, data.size() - consumed) == 0) {
 						ec = error::signature_generation_error::digestupdate_failed;
 						return {};
 					}
@@ -937,6 +1733,9 @@ namespace jwt {
 				const EVP_MD* (*md)();
 				/// algorithm's name
 				const std::string alg_name;
+				/// Digest states after absorbing the headers seen so far
+				std::shared_ptr<details::digest_prefix_cache> prefix_cache{
+					std::make_shared<details::digest_prefix_cache>()};
 			};
 
 			/**
@@ -1182,7 +1981,1030 @@ namespace jwt {
 					: pss(public_key, private_key, public_key_password, private_key_password, EVP_sha512, "PS512") {}
 			};
 
-		} // namespace algorithm
+			/**
+			 * \brief Header parameters of the ECDH-ES key agreement
+			 *
+			 * Set by ecdh_es when encrypting and read by it when decrypting, the other key management algorithms
+			 * ignore them. All members hold the raw bytes, the header contains them base64url encoded.
+			 */
+			struct key_agreement_parameters {
+				/// Curve of the ephemeral public key ("crv" member of "epk")
+				std::string curve;
+				/// x coordinate of the ephemeral public key
+				std::string x;
+				/// y coordinate of the ephemeral public key
+				std::string y;
+				/// Agreement PartyUInfo ("apu")
+				std::string party_u_info;
+				/// Agreement PartyVInfo ("apv")
+				std::string party_v_info;
+			};
+
+			/**
+			 * \brief "dir" key management, the shared symmetric key is the content encryption key
+			 *
+			 * Key management algorithms determine the content encryption key (CEK) of a JWE. encrypt_key() creates
+			 * the CEK and returns the JWE Encrypted Key, decrypt_key() recovers the CEK from it.
+			 */
+			struct dir {
+				/**
+				 * Construct new dir algorithm
+				 * \param key Shared key, its size must match the content encryption algorithm
+				 */
+				explicit dir(std::string key) : secret(std::move(key)) {}
+				/**
+				 * Determine the content encryption key
+				 * \param enc Name of the content encryption algorithm
+				 * \param cek_size Key size of the content encryption algorithm
+				 * \param cek Set to the content encryption key
+				 * \param params Header parameters of the key agreement, unused
+				 * \param ec error_code filled with details on error
+				 * \return Encrypted key, always empty
+				 */
+				std::string encrypt_key(const std::string& /*enc*/, size_t cek_size, std::string& cek,
+										key_agreement_parameters& /*params*/, std::error_code& ec) const {
+					ec.clear();
+					if (secret.size() != cek_size) {
+						ec = error::encryption_error::invalid_key_size;
+						return {};
+					}
+					cek = secret;
+					return {};
+				}
+				/**
+				 * Recover the content encryption key
+				 * \param enc Name of the content encryption algorithm
+				 * \param cek_size Key size of the content encryption algorithm
+				 * \param encrypted_key Encrypted key of the token, must be empty
+				 * \param params Header parameters of the key agreement, unused
+				 * \param ec error_code filled with details on error
+				 * \return Content encryption key
+				 */
+				std::string decrypt_key(const std::string& /*enc*/, size_t cek_size, const std::string& encrypted_key,
+										const key_agreement_parameters& /*params*/, std::error_code& ec) const {
+					ec.clear();
+					if (!encrypted_key.empty()) {
+						ec = error::decryption_error::invalid_token;
+						return {};
+					}
+					if (secret.size() != cek_size) {
+						ec = error::decryption_error::invalid_key_size;
+						return {};
+					}
+					return secret;
+				}
+				/**
+				 * Returns the algorithm name
+				 * \return algorithm's name
+				 */
+				std::string name() const { return "dir"; }
+
+			private:
+				/// Shared key
+				const std::string secret;
+			};
+
+#ifndef OPENSSL10
+			/**
+			 * \brief Base class for AES Key Wrap family of key management algorithms
+			 *
+			 * A random content encryption key is wrapped with the shared key encryption key (RFC 3394).
+			 */
+			struct aes_kw {
+				/**
+				 * Construct new AES Key Wrap algorithm
+				 * \param key Key encryption key
+				 * \param cipher Pointer to the wrap cipher
+				 * \param name Name of the algorithm
+				 * \throw encryption_exception The key does not fit the cipher
+				 */
+				aes_kw(std::string key, const EVP_CIPHER* (*cipher)(), std::string name)
+					: kek(std::move(key)), cipher(cipher), alg_name(std::move(name)) {
+					if (kek.size() != static_cast<size_t>(EVP_CIPHER_key_length(cipher())))
+						throw error::encryption_exception(error::encryption_error::invalid_key_size);
+				}
+				/**
+				 * Generate and wrap a content encryption key
+				 * \param enc Name of the content encryption algorithm
+				 * \param cek_size Key size of the content encryption algorithm
+				 * \param cek Set to the random content encryption key
+				 * \param params Header parameters of the key agreement, unused
+				 * \param ec error_code filled with details on error
+				 * \return Wrapped key
+				 */
+				std::string encrypt_key(const std::string& /*enc*/, size_t cek_size, std::string& cek,
+										key_agreement_parameters& /*params*/, std::error_code& ec) const {
+					ec.clear();
+					if (!details::random_bytes(cek_size, cek)) {
+						ec = error::encryption_error::random_failed;
+						return {};
+					}
+					std::string res;
+					if (!transform(cek, true, res)) {
+						ec = error::encryption_error::key_wrap_failed;
+						return {};
+					}
+					return res;
+				}
+				/**
+				 * Unwrap the content encryption key
+				 * \param enc Name of the content encryption algorithm
+				 * \param cek_size Key size of the content encryption algorithm
+				 * \param encrypted_key Wrapped key of the token
+				 * \param params Header parameters of the key agreement, unused
+				 * \param ec error_code filled with details on error
+				 * \return Content encryption key
+				 */
+				std::string decrypt_key(const std::string& /*enc*/, size_t cek_size, const std::string& encrypted_key,
+										const key_agreement_parameters& /*params*/, std::error_code& ec) const {
+					ec.clear();
+					std::string res;
+					if (encrypted_key.size() != cek_size + 8 || !transform(encrypted_key, false, res)) {
+						ec = error::decryption_error::key_unwrap_failed;
+						return {};
+					}
+					return res;
+				}
+				/**
+				 * Returns the algorithm name provided to the constructor
+				 * \return algorithm's name
+				 */
+				std::string name() const { return alg_name; }
+
+			private:
+				/// Key encryption key
+				const std::string kek;
+				/// Wrap cipher
+				const EVP_CIPHER* (*cipher)();
+				/// algorithm's name
+				const std::string alg_name;
+
+				bool transform(const std::string& in, bool wrap, std::string& out) const {
+					std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)> ctx(EVP_CIPHER_CTX_new(),
+																						EVP_CIPHER_CTX_free);
+					if (!ctx) return false;
+					EVP_CIPHER_CTX_set_flags(ctx.get(), EVP_CIPHER_CTX_FLAG_WRAP_ALLOW);
+					out.assign(in.size() + 8, '\0');
+					int len = 0;
+					const auto* key = reinterpret_cast<const unsigned char*>(kek.data());
+					if (EVP_CipherInit_ex(ctx.get(), cipher(), nullptr, key, nullptr, wrap ? 1 : 0) != 1 ||
+						EVP_CipherUpdate(ctx.get(), reinterpret_cast<unsigned char*>(&out[0]), &len,
+										 reinterpret_cast<const unsigned char*>(in.data()),
+										 static_cast<int>(in.size())) != 1 ||
+						len != static_cast<int>(wrap ? in.size() + 8 : in.size() - 8))
+						return false;
+					out.resize(static_cast<size_t>(len));
+					return true;
+				}
+			};
+
+			/**
+			 * \brief Base class for RSAES-OAEP family of key management algorithms
+			 *
+			 * A random content encryption key is encrypted with the RSA public key of the recipient.
+			 */
+			struct rsa_oaep {
+				/**
+				 * Construct new RSAES-OAEP algorithm
+				 * \param public_key RSA public key in PEM format
+				 * \param private_key RSA private key or empty string if not available. If empty, decrypting will
+				 * always fail.
+				 * \param public_key_password Password to decrypt public key pem.
+				 * \param private_key_password Password to decrypt private key pem.
+				 * \param md Pointer to hash function used by OAEP and MGF1
+				 * \param name Name of the algorithm
+				 */
+				rsa_oaep(const std::string& public_key, const std::string& private_key,
+						 const std::string& public_key_password, const std::string& private_key_password,
+						 const EVP_MD* (*md)(), std::string name)
+					: md(md), alg_name(std::move(name)) {
+					if (!private_key.empty()) {
+						pkey = helper::load_private_key_from_string(private_key, private_key_password);
+					} else if (!public_key.empty()) {
+						pkey = helper::load_public_key_from_string(public_key, public_key_password);
+					} else
+						throw rsa_exception(error::rsa_error::no_key_provided);
+				}
+				/**
+				 * Generate and encrypt a content encryption key
+				 * \param enc Name of the content encryption algorithm
+				 * \param cek_size Key size of the content encryption algorithm
+				 * \param cek Set to the random content encryption key
+				 * \param params Header parameters of the key agreement, unused
+				 * \param ec error_code filled with details on error
+				 * \return Encrypted key
+				 */
+				std::string encrypt_key(const std::string& /*enc*/, size_t cek_size, std::string& cek,
+										key_agreement_parameters& /*params*/, std::error_code& ec) const {
+					ec.clear();
+					if (!details::random_bytes(cek_size, cek)) {
+						ec = error::encryption_error::random_failed;
+						return {};
+					}
+					std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> ctx(
+						EVP_PKEY_CTX_new(pkey.get(), nullptr), EVP_PKEY_CTX_free);
+					if (!ctx || EVP_PKEY_encrypt_init(ctx.get()) != 1 || !set_padding(ctx.get())) {
+						ec = error::encryption_error::create_context_failed;
+						return {};
+					}
+					const auto* in = reinterpret_cast<const unsigned char*>(cek.data());
+					size_t len = 0;
+					if (EVP_PKEY_encrypt(ctx.get(), nullptr, &len, in, cek.size()) != 1) {
+						ec = error::encryption_error::key_encrypt_failed;
+						return {};
+					}
+					std::string res(len, '\0');
+					if (EVP_PKEY_encrypt(ctx.get(), reinterpret_cast<unsigned char*>(&res[0]), &len, in, cek.size()) !=
+						1) {
+						ec = error::encryption_error::key_encrypt_failed;
+						return {};
+					}
+					res.resize(len);
+					return res;
+				}
+				/**
+				 * Decrypt the content encryption key
+				 *
+				 * If the key can not be decrypted a random key is returned, so the token fails on its authentication
+				 * tag. Failing here would tell an attacker which part of a forged token was wrong (RFC 7516,
+				 * section 11.5).
+				 *
+				 * \param enc Name of the content encryption algorithm
+				 * \param cek_size Key size of the content encryption algorithm
+				 * \param encrypted_key Encrypted key of the token
+				 * \param params Header parameters of the key agreement, unused
+				 * \param ec error_code filled with details on error
+				 * \return Content encryption key
+				 */
+				std::string decrypt_key(const std::string& /*enc*/, size_t cek_size, const std::string& encrypted_key,
+										const key_agreement_parameters& /*params*/, std::error_code& ec) const {
+					ec.clear();
+					std::string fallback;
+					std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> ctx(
+						EVP_PKEY_CTX_new(pkey.get(), nullptr), EVP_PKEY_CTX_free);
+					if (!details::random_bytes(cek_size, fallback) || !ctx || EVP_PKEY_decrypt_init(ctx.get()) != 1 ||
+						!set_padding(ctx.get())) {
+						ec = error::decryption_error::create_context_failed;
+						return {};
+					}
+					const auto* in = reinterpret_cast<const unsigned char*>(encrypted_key.data());
+					size_t len = 0;
+					std::string res;
+					if (EVP_PKEY_decrypt(ctx.get(), nullptr, &len, in, encrypted_key.size()) == 1) {
+						res.assign(len, '\0');
+						if (EVP_PKEY_decrypt(ctx.get(), reinterpret_cast<unsigned char*>(&res[0]), &len, in,
+											 encrypted_key.size()) != 1)
+							len = 0;
+						res.resize(len);
+					}
+					return res.size() == cek_size ? res : fallback;
+				}
+				/**
+				 * Returns the algorithm name provided to the constructor
+				 * \return algorithm's name
+				 */
+				std::string name() const { return alg_name; }
+
+			private:
+				/// OpenSSL structure containing converted keys
+				std::shared_ptr<EVP_PKEY> pkey;
+				/// Hash generator
+				const EVP_MD* (*md)();
+				/// algorithm's name
+				const std::string alg_name;
+
+				bool set_padding(EVP_PKEY_CTX* ctx) const {
+					return EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_OAEP_PADDING) > 0 &&
+						   EVP_PKEY_CTX_set_rsa_oaep_md(ctx, md()) > 0 && EVP_PKEY_CTX_set_rsa_mgf1_md(ctx, md()) > 0;
+				}
+			};
+#endif
+
+			/**
+			 * \brief "ECDH-ES" key management, Elliptic Curve Diffie-Hellman Ephemeral Static key agreement
+			 *
+			 * The content encryption key is derived with the Concat KDF from the secret agreed between an ephemeral
+			 * key and the key of the recipient. The public part of the ephemeral key is sent in the "epk" header.
+			 */
+			struct ecdh_es {
+				/**
+				 * Construct new ECDH-ES algorithm
+				 * \param public_key EC public key of the recipient in PEM format, P-256, P-384 or P-521
+				 * \param private_key EC private key or empty string if not available. If empty, decrypting will
+				 * always fail.
+				 * \param public_key_password Password to decrypt public key pem.
+				 * \param private_key_password Password to decrypt private key pem.
+				 */
+				explicit ecdh_es(const std::string& public_key, const std::string& private_key = "",
+								 const std::string& public_key_password = "",
+								 const std::string& private_key_password = "") {
+					if (!private_key.empty()) {
+						pkey = helper::load_private_key_from_string(private_key, private_key_password);
+					} else if (!public_key.empty()) {
+						pkey = helper::load_public_key_from_string(public_key, public_key_password);
+					} else
+						throw ecdsa_exception(error::ecdsa_error::no_key_provided);
+					curve = curve_name(pkey.get());
+					if (curve.empty()) throw ecdsa_exception(error::ecdsa_error::unknown_curve);
+					coordinate_size = static_cast<size_t>(EVP_PKEY_bits(pkey.get()) + 7) / 8;
+				}
+				/**
+				 * Generate an ephemeral key and derive the content encryption key
+				 * \param enc Name of the content encryption algorithm, input to the key derivation
+				 * \param cek_size Key size of the content encryption algorithm
+				 * \param cek Set to the derived content encryption key
+				 * \param params Receives the ephemeral public key, "apu" and "apv" are read from it
+				 * \param ec error_code filled with details on error
+				 * \return Encrypted key, always empty
+				 */
+				std::string encrypt_key(const std::string& enc, size_t cek_size, std::string& cek,
+										key_agreement_parameters& params, std::error_code& ec) const {
+					ec.clear();
+					std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> ctx(
+						EVP_PKEY_CTX_new(pkey.get(), nullptr), EVP_PKEY_CTX_free);
+					if (!ctx) {
+						ec = error::encryption_error::create_context_failed;
+						return {};
+					}
+					EVP_PKEY* raw = nullptr;
+					if (EVP_PKEY_keygen_init(ctx.get()) != 1 || EVP_PKEY_keygen(ctx.get(), &raw) != 1) {
+						ec = error::encryption_error::key_agreement_failed;
+						return {};
+					}
+					std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> ephemeral(raw, EVP_PKEY_free);
+					std::string secret;
+					params.curve = curve;
+					if (!public_coordinates(ephemeral.get(), params.x, params.y) ||
+						!derive(ephemeral.get(), pkey.get(), secret) ||
+						!concat_kdf(secret, enc, params, cek_size, cek)) {
+						ec = error::encryption_error::key_agreement_failed;
+						return {};
+					}
+					return {};
+				}
+				/**
+				 * Derive the content encryption key from the ephemeral public key of the token
+				 * \param enc Name of the content encryption algorithm, input to the key derivation
+				 * \param cek_size Key size of the content encryption algorithm
+				 * \param encrypted_key Encrypted key of the token, must be empty
+				 * \param params Ephemeral public key, "apu" and "apv" of the token
+				 * \param ec error_code filled with details on error
+				 * \return Content encryption key
+				 */
+				std::string decrypt_key(const std::string& enc, size_t cek_size, const std::string& encrypted_key,
+										const key_agreement_parameters& params, std::error_code& ec) const {
+					ec.clear();
+					if (!encrypted_key.empty()) {
+						ec = error::decryption_error::invalid_token;
+						return {};
+					}
+					if (params.curve != curve || params.x.size() != coordinate_size ||
+						params.y.size() != coordinate_size) {
+						ec = error::decryption_error::key_agreement_failed;
+						return {};
+					}
+					// Loading the point checks that it is on the curve
+					const auto pem = helper::create_public_key_from_ec_components(
+						params.curve, params.x, params.y, [](const std::string& raw) { return raw; }, ec);
+					std::shared_ptr<EVP_PKEY> peer;
+					if (!ec) peer = helper::load_public_key_from_string(pem, "", ec);
+					std::string secret;
+					std::string res;
+					if (ec || !derive(pkey.get(), peer.get(), secret) ||
+						!concat_kdf(secret, enc, params, cek_size, res)) {
+						ec = error::decryption_error::key_agreement_failed;
+						return {};
+					}
+					return res;
+				}
+				/**
+				 * Returns the algorithm name
+				 * \return algorithm's name
+				 */
+				std::string name() const { return "ECDH-ES"; }
+
+			private:
+				/// OpenSSL structure containing converted keys
+				std::shared_ptr<EVP_PKEY> pkey;
+				/// JWA name of the curve
+				std::string curve;
+				/// Size of a coordinate in bytes
+				size_t coordinate_size;
+
+				static std::string curve_name(EVP_PKEY* key) {
+					int nid = NID_undef;
+#ifdef JWT_OPENSSL_3_0
+					char group[64] = {};
+					if (EVP_PKEY_get_group_name(key, group, sizeof(group), nullptr) == 1) nid = OBJ_sn2nid(group);
+#else
+					const EC_KEY* ec = EVP_PKEY_get0_EC_KEY(key);
+					if (ec != nullptr) nid = EC_GROUP_get_curve_name(EC_KEY_get0_group(ec));
+#endif
+					switch (nid) {
+					case NID_X9_62_prime256v1: return "P-256";
+					case NID_secp384r1: return "P-384";
+					case NID_secp521r1: return "P-521";
+					default: return {};
+					}
+				}
+
+				bool public_coordinates(EVP_PKEY* key, std::string& x, std::string& y) const {
+#ifdef JWT_OPENSSL_3_0
+					BIGNUM* raw_x = nullptr;
+					BIGNUM* raw_y = nullptr;
+					const bool found = EVP_PKEY_get_bn_param(key, OSSL_PKEY_PARAM_EC_PUB_X, &raw_x) == 1 &&
+									   EVP_PKEY_get_bn_param(key, OSSL_PKEY_PARAM_EC_PUB_Y, &raw_y) == 1;
+					std::unique_ptr<BIGNUM, decltype(&BN_free)> qx(raw_x, BN_free);
+					std::unique_ptr<BIGNUM, decltype(&BN_free)> qy(raw_y, BN_free);
+					if (!found) return false;
+#else
+					const EC_KEY* ec = EVP_PKEY_get0_EC_KEY(key);
+					std::unique_ptr<BIGNUM, decltype(&BN_free)> qx(BN_new(), BN_free);
+					std::unique_ptr<BIGNUM, decltype(&BN_free)> qy(BN_new(), BN_free);
+					if (ec == nullptr || !qx || !qy ||
+						EC_POINT_get_affine_coordinates_GFp(EC_KEY_get0_group(ec), EC_KEY_get0_public_key(ec), qx.get(),
+															qy.get(), nullptr) != 1)
+						return false;
+#endif
+					x = helper::bn2raw(qx.get());
+					y = helper::bn2raw(qy.get());
+					if (x.size() > coordinate_size || y.size() > coordinate_size) return false;
+					x.insert(0, coordinate_size - x.size(), '\0');
+					y.insert(0, coordinate_size - y.size(), '\0');
+					return true;
+				}
+
+				static bool derive(EVP_PKEY* own, EVP_PKEY* peer, std::string& secret) {
+					std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> ctx(EVP_PKEY_CTX_new(own, nullptr),
+																					EVP_PKEY_CTX_free);
+					size_t len = 0;
+					if (!ctx || EVP_PKEY_derive_init(ctx.get()) != 1 ||
+						EVP_PKEY_derive_set_peer(ctx.get(), peer) != 1 ||
+						EVP_PKEY_derive(ctx.get(), nullptr, &len) != 1)
+						return false;
+					secret.assign(len, '\0');
+					if (EVP_PKEY_derive(ctx.get(), reinterpret_cast<unsigned char*>(&secret[0]), &len) != 1)
+						return false;
+					secret.resize(len);
+					return true;
+				}
+
+				// Concat KDF with SHA-256 (RFC 7518, section 4.6.2), AlgorithmID is the content encryption algorithm
+				static bool concat_kdf(const std::string& secret, const std::string& algorithm_id,
+									   const key_agreement_parameters& params, size_t key_size, std::string& key) {
+					const auto prefixed = [](const std::string& value) {
+						return details::big_endian(value.size(), 4) + value;
+					};
+					const std::string other_info = prefixed(algorithm_id) + prefixed(params.party_u_info) +
+												   prefixed(params.party_v_info) +
+												   details::big_endian(key_size * 8, 4);
+					std::unique_ptr<EVP_MD_CTX, decltype(&details::digest_state::destroy)> ctx(
+						details::digest_state::create(), details::digest_state::destroy);
+					if (!ctx) return false;
+					key.clear();
+					unsigned char hash[EVP_MAX_MD_SIZE];
+					for (uint32_t counter = 1; key.size() < key_size; counter++) {
+						const auto round = details::big_endian(counter, 4);
+						unsigned int len = 0;
+						if (EVP_DigestInit_ex(ctx.get(), EVP_sha256(), nullptr) != 1 ||
+							EVP_DigestUpdate(ctx.get(), round.data(), round.size()) != 1 ||
+							EVP_DigestUpdate(ctx.get(), secret.data(), secret.size()) != 1 ||
+							EVP_DigestUpdate(ctx.get(), other_info.data(), other_info.size()) != 1 ||
+							EVP_DigestFinal_ex(ctx.get(), hash, &len) != 1)
+							return false;
+						key.append(reinterpret_cast<const char*>(hash), len);
+					}
+					key.resize(key_size);
+					return true;
+				}
+			};
+
+			/**
+			 * \brief Base class for AES GCM family of content encryption algorithms
+			 *
+			 * Content encryption algorithms encrypt and decrypt the content of a JWE in place. OpenSSL uses the
+			 * AES-NI and carry-less multiplication instructions for GCM where the CPU supports them.
+			 */
+			struct aes_gcm {
+				/**
+				 * Construct new AES GCM algorithm
+				 * \param cipher Pointer to the GCM cipher
+				 * \param name Name of the algorithm
+				 */
+				aes_gcm(const EVP_CIPHER* (*cipher)(), std::string name) : cipher(cipher), alg_name(std::move(name)) {}
+				/**
+				 * Get the size of the content encryption key
+				 * \return key size in bytes
+				 */
+				size_t key_size() const { return static_cast<size_t>(EVP_CIPHER_key_length(cipher())); }
+				/**
+				 * Encrypt content in place
+				 * \param cek Content encryption key
+				 * \param aad Additional authenticated data, the encoded header of the token
+				 * \param data Plaintext, replaced by the ciphertext
+				 * \param iv Set to the random initialization vector
+				 * \param ec error_code filled with details on error
+				 * \return Authentication tag
+				 */
+				std::string encrypt(const std::string& cek, const std::string& aad, std::string& data, std::string& iv,
+									std::error_code& ec) const {
+					ec.clear();
+					if (cek.size() != key_size()) {
+						ec = error::encryption_error::invalid_key_size;
+						return {};
+					}
+					if (!details::random_bytes(iv_size, iv)) {
+						ec = error::encryption_error::random_failed;
+						return {};
+					}
+					std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)> ctx(EVP_CIPHER_CTX_new(),
+																						EVP_CIPHER_CTX_free);
+					if (!ctx) {
+						ec = error::encryption_error::create_context_failed;
+						return {};
+					}
+					std::string tag(tag_size, '\0');
+					const auto* key = reinterpret_cast<const unsigned char*>(cek.data());
+					const auto* nonce = reinterpret_cast<const unsigned char*>(iv.data());
+					if (EVP_EncryptInit_ex(ctx.get(), cipher(), nullptr, key, nonce) != 1 ||
+						!process(ctx.get(), aad, data, true) ||
+						EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, static_cast<int>(tag_size), &tag[0]) !=
+							1) {
+						ec = error::encryption_error::encrypt_failed;
+						return {};
+					}
+					return tag;
+				}
+				/**
+				 * Decrypt content in place
+				 * \param cek Content encryption key
+				 * \param iv Initialization vector of the token
+				 * \param aad Additional authenticated data, the encoded header of the token
+				 * \param data Ciphertext, replaced by the plaintext. Cleared if the tag does not match.
+				 * \param tag Authentication tag of the token
+				 * \param ec error_code filled with details on error
+				 */
+				void decrypt(const std::string& cek, const std::string& iv, const std::string& aad, std::string& data,
+							 const std::string& tag, std::error_code& ec) const {
+					ec.clear();
+					if (cek.size() != key_size()) {
+						ec = error::decryption_error::invalid_key_size;
+						return;
+					}
+					if (iv.size() != iv_size || tag.size() != tag_size) {
+						ec = error::decryption_error::invalid_token;
+						return;
+					}
+					std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)> ctx(EVP_CIPHER_CTX_new(),
+																						EVP_CIPHER_CTX_free);
+					if (!ctx) {
+						ec = error::decryption_error::create_context_failed;
+						return;
+					}
+					const auto* key = reinterpret_cast<const unsigned char*>(cek.data());
+					const auto* nonce = reinterpret_cast<const unsigned char*>(iv.data());
+					if (EVP_DecryptInit_ex(ctx.get(), cipher(), nullptr, key, nonce) != 1 ||
+						EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, static_cast<int>(tag_size),
+											const_cast<char*>(tag.data())) != 1) {
+						ec = error::decryption_error::decrypt_failed;
+						return;
+					}
+					if (!process(ctx.get(), aad, data, false)) {
+						data.clear();
+						ec = error::decryption_error::invalid_tag;
+					}
+				}
+				/**
+				 * Returns the algorithm name provided to the constructor
+				 * \return algorithm's name
+				 */
+				std::string name() const { return alg_name; }
+
+			private:
+				static constexpr size_t iv_size = 12;
+				static constexpr size_t tag_size = 16;
+				/// GCM cipher
+				const EVP_CIPHER* (*cipher)();
+				/// algorithm's name
+				const std::string alg_name;
+
+				static bool process(EVP_CIPHER_CTX* ctx, const std::string& aad, std::string& data, bool encrypt) {
+					int len = 0;
+					unsigned char final_block[16];
+					const auto update = encrypt ? EVP_EncryptUpdate : EVP_DecryptUpdate;
+					if (update(ctx, nullptr, &len, reinterpret_cast<const unsigned char*>(aad.data()),
+							   static_cast<int>(aad.size())) != 1)
+						return false;
+					if (!data.empty()) {
+						auto* buffer = reinterpret_cast<unsigned char*>(&data[0]);
+						if (update(ctx, buffer, &len, buffer, static_cast<int>(data.size())) != 1) return false;
+					}
+					return (encrypt ? EVP_EncryptFinal_ex(ctx, final_block, &len)
+									: EVP_DecryptFinal_ex(ctx, final_block, &len)) == 1;
+				}
+			};
+
+			/**
+			 * \brief Base class for AES CBC with HMAC SHA-2 family of content encryption algorithms
+			 *
+			 * The first half of the key authenticates the content with HMAC, the second half encrypts it with AES in
+			 * CBC mode (RFC 7518, section 5.2). The tag is checked before anything is decrypted.
+			 */
+			struct aes_cbc_hmac_sha2 {
+				/**
+				 * Construct new AES CBC HMAC SHA-2 algorithm
+				 * \param cipher Pointer to the CBC cipher
+				 * \param md Pointer to hash function
+				 * \param name Name of the algorithm
+				 */
+				aes_cbc_hmac_sha2(const EVP_CIPHER* (*cipher)(), const EVP_MD* (*md)(), std::string name)
+					: cipher(cipher), md(md), alg_name(std::move(name)) {}
+				/**
+				 * Get the size of the content encryption key
+				 * \return key size in bytes, the MAC key and encryption key together
+				 */
+				size_t key_size() const { return 2 * static_cast<size_t>(EVP_CIPHER_key_length(cipher())); }
+				/**
+				 * Encrypt content in place
+				 * \param cek Content encryption key
+				 * \param aad Additional authenticated data, the encoded header of the token
+				 * \param data Plaintext, replaced by the ciphertext
+				 * \param iv Set to the random initialization vector
+				 * \param ec error_code filled with details on error
+				 * \return Authentication tag
+				 */
+				std::string encrypt(const std::string& cek, const std::string& aad, std::string& data, std::string& iv,
+									std::error_code& ec) const {
+					ec.clear();
+					if (cek.size() != key_size()) {
+						ec = error::encryption_error::invalid_key_size;
+						return {};
+					}
+					if (!details::random_bytes(block_size, iv)) {
+						ec = error::encryption_error::random_failed;
+						return {};
+					}
+					std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)> ctx(EVP_CIPHER_CTX_new(),
+																						EVP_CIPHER_CTX_free);
+					if (!ctx) {
+						ec = error::encryption_error::create_context_failed;
+						return {};
+					}
+					// Padding adds at most one block
+					const auto size = data.size();
+					data.resize(size + block_size);
+					auto* buffer = reinterpret_cast<unsigned char*>(&data[0]);
+					int len = 0;
+					int final_len = 0;
+					if (EVP_EncryptInit_ex(ctx.get(), cipher(), nullptr, enc_key(cek),
+										   reinterpret_cast<const unsigned char*>(iv.data())) != 1 ||
+						EVP_EncryptUpdate(ctx.get(), buffer, &len, buffer, static_cast<int>(size)) != 1 ||
+						EVP_EncryptFinal_ex(ctx.get(), buffer + len, &final_len) != 1) {
+						data.resize(size);
+						ec = error::encryption_error::encrypt_failed;
+						return {};
+					}
+					data.resize(static_cast<size_t>(len + final_len));
+					std::string tag;
+					if (!compute_tag(cek, aad, iv, data, tag)) {
+						ec = error::encryption_error::encrypt_failed;
+						return {};
+					}
+					return tag;
+				}
+				/**
+				 * Decrypt content in place
+				 * \param cek Content encryption key
+				 * \param iv Initialization vector of the token
+				 * \param aad Additional authenticated data, the encoded header of the token
+				 * \param data Ciphertext, replaced by the plaintext. Left unchanged if the tag does not match.
+				 * \param tag Authentication tag of the token
+				 * \param ec error_code filled with details on error
+				 */
+				void decrypt(const std::string& cek, const std::string& iv, const std::string& aad, std::string& data,
+							 const std::string& tag, std::error_code& ec) const {
+					ec.clear();
+					if (cek.size() != key_size()) {
+						ec = error::decryption_error::invalid_key_size;
+						return;
+					}
+					if (iv.size() != block_size || data.empty() || data.size() % block_size != 0) {
+						ec = error::decryption_error::invalid_token;
+						return;
+					}
+					std::string expected;
+					if (!compute_tag(cek, aad, iv, data, expected)) {
+						ec = error::decryption_error::decrypt_failed;
+						return;
+					}
+					if (tag.size() != expected.size() || CRYPTO_memcmp(tag.data(), expected.data(), tag.size()) != 0) {
+						ec = error::decryption_error::invalid_tag;
+						return;
+					}
+					std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)> ctx(EVP_CIPHER_CTX_new(),
+																						EVP_CIPHER_CTX_free);
+					if (!ctx) {
+						ec = error::decryption_error::create_context_failed;
+						return;
+					}
+					auto* buffer = reinterpret_cast<unsigned char*>(&data[0]);
+					int len = 0;
+					int final_len = 0;
+					if (EVP_DecryptInit_ex(ctx.get(), cipher(), nullptr, enc_key(cek),
+										   reinterpret_cast<const unsigned char*>(iv.data())) != 1 ||
+						EVP_DecryptUpdate(ctx.get(), buffer, &len, buffer, static_cast<int>(data.size())) != 1 ||
+						EVP_DecryptFinal_ex(ctx.get(), buffer + len, &final_len) != 1) {
+						ec = error::decryption_error::decrypt_failed;
+						return;
+					}
+					data.resize(static_cast<size_t>(len + final_len));
+				}
+				/**
+				 * Returns the algorithm name provided to the constructor
+				 * \return algorithm's name
+				 */
+				std::string name() const { return alg_name; }
+
+			private:
+				static constexpr size_t block_size = 16;
+				/// CBC cipher
+				const EVP_CIPHER* (*cipher)();
+				/// HMAC hash generator
+				const EVP_MD* (*md)();
+				/// algorithm's name
+				const std::string alg_name;
+
+				static const unsigned char* enc_key(const std::string& cek) {
+					return reinterpret_cast<const unsigned char*>(cek.data()) + cek.size() / 2;
+				}
+
+				// HMAC over AAD || IV || ciphertext || AL, truncated to the size of the MAC key
+				bool compute_tag(const std::string& cek, const std::string& aad, const std::string& iv,
+								 const std::string& ciphertext, std::string& tag) const {
+					const auto mac_key_size = cek.size() / 2;
+					std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> mac_key(
+						EVP_PKEY_new_mac_key(EVP_PKEY_HMAC, nullptr, reinterpret_cast<const unsigned char*>(cek.data()),
+											 static_cast<int>(mac_key_size)),
+						EVP_PKEY_free);
+					std::unique_ptr<EVP_MD_CTX, decltype(&details::digest_state::destroy)> ctx(
+						details::digest_state::create(), details::digest_state::destroy);
+					// number of bits in the additional authenticated data as 64 bit big endian integer
+					const auto al = details::big_endian(static_cast<uint64_t>(aad.size()) * 8, 8);
+					tag.assign(static_cast<size_t>(EVP_MAX_MD_SIZE), '\0');
+					size_t len = tag.size();
+					if (!mac_key || !ctx || EVP_DigestSignInit(ctx.get(), nullptr, md(), nullptr, mac_key.get()) != 1 ||
+						EVP_DigestSignUpdate(ctx.get(), aad.data(), aad.size()) != 1 ||
+						EVP_DigestSignUpdate(ctx.get(), iv.data(), iv.size()) != 1 ||
+						EVP_DigestSignUpdate(ctx.get(), ciphertext.data(), ciphertext.size()) != 1 ||
+						EVP_DigestSignUpdate(ctx.get(), al.data(), al.size()) != 1 ||
+						EVP_DigestSignFinal(ctx.get(), reinterpret_cast<unsigned char*>(&tag[0]), &len) != 1 ||
+						len < mac_key_size)
+						return false;
+					tag.resize(mac_key_size);
+					return true;
+				}
+			};
+
+#ifndef OPENSSL10
+			/**
+			 * A128KW key management algorithm
+			 */
+			struct a128kw : public aes_kw {
+				/**
+				 * Construct new instance of algorithm
+				 * \param key 16 byte key encryption key
+				 */
+				explicit a128kw(std::string key) : aes_kw(std::move(key), EVP_aes_128_wrap, "A128KW") {}
+			};
+			/**
+			 * A256KW key management algorithm
+			 */
+			struct a256kw : public aes_kw {
+				/**
+				 * Construct new instance of algorithm
+				 * \param key 32 byte key encryption key
+				 */
+				explicit a256kw(std::string key) : aes_kw(std::move(key), EVP_aes_256_wrap, "A256KW") {}
+			};
+			/**
+			 * RSA-OAEP-256 key management algorithm, RSAES-OAEP with SHA-256 and MGF1 with SHA-256
+			 */
+			struct rsa_oaep_256 : public rsa_oaep {
+				/**
+				 * Construct new instance of algorithm
+				 * \param public_key RSA public key in PEM format
+				 * \param private_key RSA private key or empty string if not available. If empty, decrypting will
+				 * always fail.
+				 * \param public_key_password Password to decrypt public key pem.
+				 * \param private_key_password Password to decrypt private key pem.
+				 */
+				explicit rsa_oaep_256(const std::string& public_key, const std::string& private_key = "",
+									  const std::string& public_key_password = "",
+									  const std::string& private_key_password = "")
+					: rsa_oaep(public_key, private_key, public_key_password, private_key_password, EVP_sha256,
+							   "RSA-OAEP-256") {}
+			};
+#endif
+			/**
+			 * A128GCM content encryption algorithm
+			 */
+			struct a128gcm : public aes_gcm {
+				a128gcm() : aes_gcm(EVP_aes_128_gcm, "A128GCM") {}
+			};
+			/**
+			 * A256GCM content encryption algorithm
+			 */
+			struct a256gcm : public aes_gcm {
+				a256gcm() : aes_gcm(EVP_aes_256_gcm, "A256GCM") {}
+			};
+			/**
+			 * A128CBC-HS256 content encryption algorithm
+			 */
+			struct a128cbc_hs256 : public aes_cbc_hmac_sha2 {
+				a128cbc_hs256() : aes_cbc_hmac_sha2(EVP_aes_128_cbc, EVP_sha256, "A128CBC-HS256") {}
+			};
+
+		} // namespace algorithm
+
+#ifdef JWT_OPENSSL_ASYNC
+		/// Progress of an async_operation
+		enum class async_status {
+			/// The operation completed, see async_operation::get_error()
+			finished,
+			/// The operation waits for an asynchronous engine or provider, resume it once a wait fd is readable
+			paused
+		};
+
+		/**
+		 * \brief Runs a signing or verification operation inside an OpenSSL ASYNC_JOB
+		 *
+		 * With an asynchronous engine or provider (for example a hardware accelerator) the operation pauses
+		 * instead of blocking while the request is in flight, which lets one thread keep many operations going.
+		 * The file descriptors returned by get_wait_fds() become readable once the operation can make progress;
+		 * add them to an event loop and call resume() when they are ready. Without such an engine the operation
+		 * finishes on the first call to resume().
+		 *
+		 * An operation must be resumed on the thread that started it. If the job can not be started, because the
+		 * platform does not support ASYNC_JOBs or the job pool is exhausted, the operation runs synchronously.
+		 * An exception thrown by the operation ends it with std::errc::operation_canceled, see get_exception().
+		 *
+		 * Destroying a paused operation blocks until it finished, waiting on its wait fds between resumes. Drain
+		 * operations through the event loop before destroying them to keep the thread from blocking.
+		 */
+		class async_operation {
+		public:
+			/**
+			 * Create an operation, nothing runs before the first call to resume()
+			 * \param operation Work to run inside the job, reports its result through the error_code
+			 */
+			explicit async_operation(std::function<void(std::error_code&)> operation)
+				: st(new state{std::move(operation), {}, {}, nullptr, {nullptr, ASYNC_WAIT_CTX_free}, false}) {}
+			async_operation(async_operation&&) = default;
+			async_operation(const async_operation&) = delete;
+			async_operation& operator=(const async_operation&) = delete;
+			async_operation& operator=(async_operation&&) = delete;
+			~async_operation() {
+				if (!st) return;
+				while (resume() == async_status::paused)
+					wait_for_progress();
+			}
+
+			/**
+			 * Start the operation, or continue it after it paused
+			 * \return Whether the operation finished or paused again
+			 */
+			async_status resume() {
+				if (st->done) return async_status::finished;
+				if (!st->wait_ctx) st->wait_ctx.reset(ASYNC_WAIT_CTX_new());
+				if (!st->wait_ctx) return run_synchronously();
+
+				int ret = 0;
+				state* arg = st.get();
+				switch (ASYNC_start_job(&st->job, st->wait_ctx.get(), &ret, &state::run, &arg, sizeof(arg))) {
+				case ASYNC_PAUSE: return async_status::paused;
+				case ASYNC_FINISH:
+					st->job = nullptr;
+					st->done = true;
+					return async_status::finished;
+				default:
+					if (st->job == nullptr) return run_synchronously();
+					// A paused job failed to resume, its state is lost
+					st->job = nullptr;
+					st->ec = std::make_error_code(std::errc::operation_canceled);
+					st->done = true;
+					return async_status::finished;
+				}
+			}
+
+			/**
+			 * Check if the operation finished
+			 * \return true once resume() returned async_status::finished
+			 */
+			bool is_finished() const noexcept { return st->done; }
+
+			/**
+			 * Get the file descriptors the paused operation waits for
+			 * \return Descriptors registered by the engine or provider, empty if there are none
+			 */
+			std::vector<OSSL_ASYNC_FD> get_wait_fds() const {
+				size_t count = 0;
+				if (!st->wait_ctx || ASYNC_WAIT_CTX_get_all_fds(st->wait_ctx.get(), nullptr, &count) != 1 ||
+					count == 0)
+					return {};
+				std::vector<OSSL_ASYNC_FD> fds(count);
+				if (ASYNC_WAIT_CTX_get_all_fds(st->wait_ctx.get(), fds.data(), &count) != 1) return {};
+				fds.resize(count);
+				return fds;
+			}
+
+			/**
+			 * Get the result of the finished operation
+			 * \return Error reported by the operation, empty on success
+			 */
+			const std::error_code& get_error() const noexcept { return st->ec; }
+
+			/**
+			 * Get the exception thrown by the finished operation
+			 * \return Exception thrown by the operation, nullptr if it returned normally
+			 */
+			std::exception_ptr get_exception() const noexcept { return st->exception; }
+
+		private:
+			struct state {
+				std::function<void(std::error_code&)> operation;
+				std::error_code ec;
+				std::exception_ptr exception;
+				ASYNC_JOB* job;
+				std::unique_ptr<ASYNC_WAIT_CTX, decltype(&ASYNC_WAIT_CTX_free)> wait_ctx;
+				bool done;
+
+				// Called on the stack of the job, an exception must not unwind across it
+				static int run(void* arg) {
+					(*static_cast<state**>(arg))->invoke();
+					return 1;
+				}
+
+				void invoke() noexcept {
+					try {
+						operation(ec);
+					} catch (...) {
+						exception = std::current_exception();
+						ec = std::make_error_code(std::errc::operation_canceled);
+					}
+				}
+			};
+			std::unique_ptr<state> st;
+
+			async_status run_synchronously() {
+				st->invoke();
+				st->done = true;
+				return async_status::finished;
+			}
+
+			// Block until a wait fd of the paused operation is ready, engines without wait fds are polled
+			void wait_for_progress() const {
+				const auto fds = get_wait_fds();
+				if (fds.empty()) {
+					std::this_thread::yield();
+					return;
+				}
+#ifdef _WIN32
+				WaitForMultipleObjects(static_cast<DWORD>(std::min<size_t>(fds.size(), MAXIMUM_WAIT_OBJECTS)),
+									   fds.data(), FALSE, INFINITE);
+#else
+				std::vector<pollfd> polled;
+				for (const auto fd : fds)
+					polled.push_back({fd, POLLIN, 0});
+				while (poll(polled.data(), static_cast<nfds_t>(polled.size()), -1) < 0 && errno == EINTR) {}
+#endif
+			}
+		};
+
+		/**
+		 * Create an operation signing data inside an ASYNC_JOB
+		 * \param algo Algorithm to sign with, must outlive the operation
+		 * \param data Data to sign
+		 * \param signature Receives the signature once the operation finished, must outlive the operation
+		 * \return Operation, start it with async_operation::resume()
+		 */
+		template<typename Algo>
+		async_operation async_sign(const Algo& algo, std::string data, std::string& signature) {
+			return async_operation([&algo, &signature, data](std::error_code& ec) { signature = algo.sign(data, ec); });
+		}
+
+		/**
+		 * Create an operation verifying a signature inside an ASYNC_JOB
+		 * \param algo Algorithm to verify with, must outlive the operation
+		 * \param data Data the signature was created for
+		 * \param signature Signature to check
+		 * \return Operation, start it with async_operation::resume()
+		 */
+		template<typename Algo>
+		async_operation async_verify(const Algo& algo, std::string data, std::string signature) {
+			return async_operation(
+				[&algo, data, signature](std::error_code& ec) { algo.verify(data, signature, ec); });
+		}
+#endif
 	}	  // namespace crypto
 } // namespace jwt
 
@@ -0,0 +1,299 @@
+#ifndef JWT_CPP_REVOCATION_H
+#define JWT_CPP_REVOCATION_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace jwt {
+	/**
+	 * \brief Set of revoked token ids (or subjects) for the verifier to reject
+	 *
+	 * Membership is first tested against a blocked counting Bloom filter: the value is hashed once, the hash
+	 * selects a 64 byte block and six 8 bit counters inside it, which are read with relaxed atomic loads. Values
+	 * that are not revoked, the common case, are answered from that single cache line without locking. Only when
+	 * all six counters are set is the exact set consulted to rule out false positives. It is an immutable snapshot
+	 * that every change replaces, so checks never lock, also for revoked values. Changes are serialized, each one
+	 * copies the exact set: revoke many values at once with load().
+	 *
+	 * Every entry keeps the expiry of the token it revokes. Once it has passed the token is rejected as expired
+	 * anyway, so such entries are dropped on the next change to the list, or by evict_expired().
+	 *
+	 * Attach an instance to a verifier with `verifier::with_revocation_list`.
+	 */
+	class revocation_list {
+	public:
+		using clock = std::chrono::system_clock;
+
+		/**
+		 * Create an empty list
+		 * \param capacity Expected number of entries, the filter is sized for it. More entries are still found,
+		 *                 only the share of lookups going to the exact set grows
+		 */
+		explicit revocation_list(size_t capacity = 1024)
+			: block_count(filter_blocks(capacity)), storage(new unsigned char[(block_count + 1) * sizeof(block)]),
+			  blocks(place_blocks(storage.get(), block_count)), entries(std::make_shared<const entry_map>()) {}
+		revocation_list(const revocation_list&) = delete;
+		revocation_list& operator=(const revocation_list&) = delete;
+
+		/**
+		 * Revoke a value
+		 * \param value Token id or subject to revoke
+		 * \param expires Expiry of the revoked token, the entry is dropped after it. Defaults to never
+		 */
+		void revoke(const std::string& value, clock::time_point expires = clock::time_point::max()) {
+			std::lock_guard<std::mutex> lock(mtx);
+			const auto now = clock::now();
+			auto next = std::make_shared<entry_map>(*entries);
+			std::vector<std::string> added;
+			evict_expired(*next, now, lock);
+			insert(*next, value, expires, now, added, lock);
+			publish(std::move(next), added, lock);
+		}
+
+		/**
+		 * Revoke all values read from a stream, one per line
+		 *
+		 * A line may end with whitespace and the token expiry as NumericDate (seconds since the epoch), lines
+		 * without it never expire. Empty lines are skipped. The whole stream is read before the list changes.
+		 *
+		 * \param in Stream to read
+		 * \return Number of values read
+		 * \throw std::invalid_argument An expiry is too large for the clock, nothing is revoked then
+		 */
+		size_t load(std::istream& in) {
+			std::vector<std::pair<std::string, clock::time_point>> values;
+			std::string line;
+			for (size_t number = 1; std::getline(in, line); number++) {
+				if (!line.empty() && line.back() == '\r') line.pop_back();
+				if (line.empty()) continue;
+				auto expires = clock::time_point::max();
+				const auto sep = line.find_last_of(" \t");
+				if (sep != std::string::npos && sep + 1 < line.size() &&
+					line.find_first_not_of("0123456789", sep + 1) == std::string::npos) {
+					if (!parse_expiry(line, sep + 1, expires))
+						throw std::invalid_argument("expiry out of range on line " + std::to_string(number) +
+													" of revocation list");
+					line.erase(line.find_last_not_of(" \t", sep) + 1);
+				}
+				values.emplace_back(std::move(line), expires);
+			}
+			std::lock_guard<std::mutex> lock(mtx);
+			const auto now = clock::now();
+			auto next = std::make_shared<entry_map>(*entries);
+			std::vector<std::string> added;
+			evict_expired(*next, now, lock);
+			for (const auto& v : values)
+				insert(*next, v.first, v.second, now, added, lock);
+			publish(std::move(next), added, lock);
+			return values.size();
+		}
+
+		/**
+		 * Revoke all values listed in a file, one per line
+		 * \param path File to read, in the format described for load(std::istream&)
+		 * \return Number of values read
+		 * \throw std::runtime_error The file could not be opened
+		 * \throw std::invalid_argument An expiry is too large for the clock, nothing is revoked then
+		 */
+		size_t load_file(const std::string& path) {
+			std::ifstream in(path);
+			if (!in) throw std::runtime_error("failed to open revocation list " + path);
+			return load(in);
+		}
+
+		/**
+		 * Lift the revocation of a value
+		 * \param value Token id or subject
+		 * \return true if the value was revoked
+		 */
+		bool remove(const std::string& value) {
+			std::lock_guard<std::mutex> lock(mtx);
+			if (entries->count(value) == 0) return false;
+			auto next = std::make_shared<entry_map>(*entries);
+			next->erase(value);
+			publish(std::move(next), {}, lock);
+			update_filter(value, false);
+			return true;
+		}
+
+		/**
+		 * Drop all entries whose token has expired
+		 * \param now Current time
+		 * \return Number of entries dropped
+		 */
+		size_t evict_expired(clock::time_point now = clock::now()) {
+			std::lock_guard<std::mutex> lock(mtx);
+			if (expiries.empty() || expiries.begin()->first > now) return 0;
+			auto next = std::make_shared<entry_map>(*entries);
+			const auto count = evict_expired(*next, now, lock);
+			publish(std::move(next), {}, lock);
+			return count;
+		}
+
+		/**
+		 * Check if a value is revoked. Safe to call concurrently with changes to the list.
+		 * \param value Token id or subject
+		 * \return true if the value is revoked
+		 */
+		bool is_revoked(const std::string& value) const {
+			const auto hash = hash_value(value);
+			const auto& b = blocks[hash & (block_count - 1)];
+			const auto probes = mix(hash);
+			for (size_t i = 0; i < probe_count; i++)
+				if (b.counters[(probes >> (6 * i)) & 63].load(std::memory_order_relaxed) == 0) return false;
+			return std::atomic_load(&entries)->count(value) != 0;
+		}
+
+		/**
+		 * Get the number of revoked values
+		 * \return Number of entries
+		 */
+		size_t size() const { return std::atomic_load(&entries)->size(); }
+
+	private:
+		static constexpr size_t probe_count = 6;
+		// Counters stick at the maximum once reached, so a value sharing them is never lost
+		static constexpr uint8_t counter_max = 255;
+
+		// One cache line, placed on a 64 byte boundary by place_blocks()
+		struct block {
+			std::atomic<uint8_t> counters[64];
+
+			block() {
+				for (auto& c : counters)
+					c.store(0, std::memory_order_relaxed);
+			}
+		};
+		static_assert(sizeof(block) == 64, "a filter block must fill exactly one cache line");
+
+		using entry_map = std::unordered_map<std::string, clock::time_point>;
+
+		const size_t block_count;
+		// Holds the blocks plus room to align them
+		std::unique_ptr<unsigned char[]> storage;
+		block* const blocks;
+		// Serializes changes, readers only load the snapshot
+		std::mutex mtx;
+		std::shared_ptr<const entry_map> entries;
+		// Expiries in order, may hold stale records for values revoked again or removed
+		std::multimap<clock::time_point, std::string> expiries;
+
+		// new[] only aligns to alignof(std::max_align_t) before C++17, so the blocks are aligned by hand
+		static block* place_blocks(unsigned char* raw, size_t count) {
+			const auto offset = (sizeof(block) - reinterpret_cast<std::uintptr_t>(raw) % sizeof(block)) % sizeof(block);
+			auto* res = reinterpret_cast<block*>(raw + offset);
+			for (size_t i = 0; i < count; i++)
+				new (res + i) block();
+			return res;
+		}
+
+		// Four entries per block on average, about one lookup in a thousand reaches the exact set when full
+		static size_t filter_blocks(size_t capacity) {
+			size_t n = 1;
+			while (n * 4 < capacity)
+				n <<= 1;
+			return n;
+		}
+
+		// Hashes eight bytes per step, its low bits select the block
+		static uint64_t hash_value(const std::string& value) noexcept {
+			uint64_t hash = 0xcbf29ce484222325ULL ^ value.size();
+			size_t i = 0;
+			for (; i + 8 <= value.size(); i += 8) {
+				uint64_t word;
+				std::memcpy(&word, value.data() + i, 8);
+				hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+				hash ^= hash >> 32;
+			}
+			uint64_t tail = 0;
+			for (size_t shift = 0; i < value.size(); i++, shift += 8)
+				tail |= uint64_t{static_cast<unsigned char>(value[i])} << shift;
+			return mix(hash ^ tail);
+		}
+
+		// Finalizer of splitmix64, also gives the bits for the positions inside the block
+		static uint64_t mix(uint64_t x) noexcept {
+			x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+			return x ^ (x >> 31);
+		}
+
+		// Read the NumericDate made of the digits from pos to the end of line, false if the clock cannot hold it
+		static bool parse_expiry(const std::string& line, size_t pos, clock::time_point& expires) noexcept {
+			const auto limit = std::chrono::duration_cast<std::chrono::seconds>(clock::duration::max()).count();
+			std::chrono::seconds::rep seconds = 0;
+			for (; pos < line.size(); pos++) {
+				const auto digit = line[pos] - '0';
+				if (seconds > (limit - digit) / 10) return false;
+				seconds = seconds * 10 + digit;
+			}
+			expires = clock::time_point(std::chrono::duration_cast<clock::duration>(std::chrono::seconds{seconds}));
+			return true;
+		}
+
+		// Values whose token has already expired are not stored. New values are collected in added, their
+		// counters are only set once the snapshot holding them is published
+		void insert(entry_map& next, const std::string& value, clock::time_point expires, clock::time_point now,
+					std::vector<std::string>& added, const std::lock_guard<std::mutex>&) {
+			if (expires <= now) return;
+			const auto res = next.emplace(value, expires);
+			if (!res.second) {
+				if (res.first->second == expires) return;
+				res.first->second = expires;
+			} else {
+				added.push_back(value);
+			}
+			if (expires != clock::time_point::max()) expiries.emplace(expires, value);
+		}
+
+		// The exact set is replaced first so a reader seeing the counters always finds the new values
+		void publish(std::shared_ptr<entry_map> next, const std::vector<std::string>& added,
+					 const std::lock_guard<std::mutex>&) {
+			std::atomic_store(&entries, std::shared_ptr<const entry_map>(std::move(next)));
+			for (const auto& value : added)
+				update_filter(value, true);
+		}
+
+		size_t evict_expired(entry_map& next, clock::time_point now, const std::lock_guard<std::mutex>&) {
+			size_t count = 0;
+			while (!expiries.empty() && expiries.begin()->first <= now) {
+				const auto it = next.find(expiries.begin()->second);
+				if (it != next.end() && it->second == expiries.begin()->first) {
+					next.erase(it);
+					update_filter(expiries.begin()->second, false);
+					count++;
+				}
+				expiries.erase(expiries.begin());
+			}
+			return count;
+		}
+
+		// Only called with the mutex held, so counters have a single writer
+		void update_filter(const std::string& value, bool add) noexcept {
+			const auto hash = hash_value(value);
+			auto& b = blocks[hash & (block_count - 1)];
+			const auto probes = mix(hash);
+			for (size_t i = 0; i < probe_count; i++) {
+				auto& c = b.counters[(probes >> (6 * i)) & 63];
+				const auto v = c.load(std::memory_order_relaxed);
+				if (v == counter_max) continue;
+				c.store(static_cast<uint8_t>(add ? v + 1 : v - 1), std::memory_order_release);
+			}
+		}
+	};
+} // namespace jwt
+
+#endif
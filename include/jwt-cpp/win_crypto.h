@@ -691,6 +691,23 @@ namespace jwt {
 					}
 				}
 
+				/**
+				 * Check the signatures of many tokens signed with this key, one token at a time
+				 * \param data Signing inputs of the tokens
+				 * \param signatures Signature of each token, tokens without a signature fail
+				 * \param ec Resized to the number of signing inputs and filled with the result of each token
+				 */
+				void verify_batch(const std::vector<std::string>& data, const std::vector<std::string>& signatures,
+								  std::vector<std::error_code>& ec) const {
+					ec.assign(data.size(), std::error_code{});
+					for (size_t i = 0; i < data.size(); i++) {
+						if (i < signatures.size())
+							verify(data[i], signatures[i], ec[i]);
+						else
+							ec[i] = error::signature_verification_error::invalid_signature;
+					}
+				}
+
 				/**
 				 * Returns the algorithm name provided to the constructor
 				 * \return algorithm's name
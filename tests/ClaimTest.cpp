@@ -139,3 +139,35 @@ TEST(ClaimTest, MapOfClaim) {
 	ASSERT_EQ(claims.get_claim("bool").as_bool(), true);
 	ASSERT_THROW(claims.get_claim("__missing__"), jwt::error::claim_not_present_exception);
 }
+
+TEST(ClaimTest, VerifyAnyAudience) {
+	std::set<std::string> allowed;
+	for (int i = 0; i < 500; i++)
+		allowed.insert("service-" + std::to_string(i));
+	auto verify = jwt::verify().allow_algorithm(jwt::algorithm::none{}).with_any_audience(allowed);
+
+	auto verify_aud = [&verify](const jwt::claim& aud) {
+		std::error_code ec;
+		verify.verify(jwt::decode(jwt::create().set_payload_claim("aud", aud).sign(jwt::algorithm::none{})), ec);
+		return ec;
+	};
+
+	ASSERT_FALSE(verify_aud(jwt::claim(std::string("service-42"))));
+	ASSERT_FALSE(verify_aud(jwt::claim(std::set<std::string>{"other", "service-499"})));
+	ASSERT_EQ(verify_aud(jwt::claim(std::string("service-500"))),
+			  jwt::error::token_verification_error::audience_missmatch);
+	ASSERT_EQ(verify_aud(jwt::claim(std::set<std::string>{"other", "another"})),
+			  jwt::error::token_verification_error::audience_missmatch);
+	ASSERT_EQ(verify_aud(jwt::claim(std::set<std::string>{})),
+			  jwt::error::token_verification_error::audience_missmatch);
+	ASSERT_EQ(verify_aud(jwt::claim(picojson::value(int64_t{42}))),
+			  jwt::error::token_verification_error::claim_type_missmatch);
+	// Every element is checked, also those after a match
+	ASSERT_EQ(verify_aud(jwt::claim(picojson::value(picojson::array{picojson::value("service-1"),
+																	 picojson::value(int64_t{42})}))),
+			  jwt::error::token_verification_error::claim_type_missmatch);
+
+	std::error_code ec;
+	verify.verify(jwt::decode(jwt::create().sign(jwt::algorithm::none{})), ec);
+	ASSERT_EQ(ec, jwt::error::token_verification_error::missing_claim);
+}
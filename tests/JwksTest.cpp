@@ -1,5 +1,50 @@
 #include "jwt-cpp/jwt.h"
 #include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+
+inline namespace test_keys {
+	extern std::string rsa_priv_key;
+	extern std::string ecdsa256_priv_key;
+} // namespace test_keys
+
+namespace {
+	const std::string key_store_jwks = R"({
+	"keys": [{
+			"kid": "rsa-key",
+			"use": "sig",
+			"alg": "RS256",
+			"kty": "RSA",
+			"n": "uGbXWiK3dQTyCbX5xdE4yCuYp0AF2d15Qq1JSXT_lx8CEcXb9RbDddl8jGDv-spi5qPa8qEHiK7FwV2KpRE983wGPnYsAm9BxLFb4YrLYcDFOIGULuk2FtrPS512Qea1bXASuvYXEpQNpGbnTGVsWXI9C-yjHztqyL2h8P6mlThPY9E9ue2fCqdgixfTFIF9Dm4SLHbphUS2iw7w1JgT69s7of9-I9l5lsJ9cozf1rxrXX4V1u_SotUuNB3Fp8oB4C1fLBEhSlMcUJirz1E8AziMCxS-VrRPDM-zfvpIJg3JljAh3PJHDiLu902v9w-Iplu1WyoB2aPfitxEhRN0Yw",
+			"e": "AQAB"
+		},
+		{
+			"kid": "ec-key",
+			"kty": "EC",
+			"crv": "P-256",
+			"x": "Qgb5npLHd0Bk61bNnjK632uwmBfrF7I8hoPgaOZjyhg",
+			"y": "fgazwzugi-g_2lv8jzm115u0qWaIJkcBkTnDgN8lJXo"
+		},
+		{
+			"kid": "hmac-key",
+			"alg": "HS256",
+			"kty": "oct",
+			"k": "c2VjcmV0"
+		},
+		{
+			"kid": "enc-key",
+			"use": "enc",
+			"alg": "HS256",
+			"kty": "oct",
+			"k": "c2VjcmV0"
+		},
+		{
+			"kid": "unknown-key",
+			"kty": "OKP"
+		}
+	]
+})";
+} // namespace
 
 TEST(JwksTest, OneKeyParse) {
 	std::string publicKey = R"({
@@ -115,4 +160,311 @@ TEST(JwksTest, Missingx5c) {
 	auto jwk3 = jwks.get_jwk("internal-1");
 	ASSERT_EQ(jwk3.get_x5c().size(), 3);
 	ASSERT_EQ(jwk3.get_x5c_key_value(), "1");
-}
\ No newline at end of file
+}
+TEST(JwksTest, IndexedLookup) {
+	std::string public_key = R"({
+	"keys": [{
+			"kid": "internal-0",
+			"x5t": "thumbprint-0",
+			"x5t#S256": "sha256-thumbprint-0",
+			"alg": "RS256",
+			"kty": "RSA"
+		},
+		{
+			"kid": "internal-1",
+			"x5t": "thumbprint-1",
+			"alg": "ES256",
+			"kty": "EC"
+		},
+		{
+			"kid": "internal-0",
+			"alg": "HS256",
+			"kty": "oct"
+		},
+		{
+			"kid": 42,
+			"kty": "oct"
+		}
+	]
+})";
+
+	auto jwks = jwt::parse_jwks(public_key);
+
+	const auto& jwk = jwks.get_jwk("internal-0");
+	ASSERT_EQ(&jwk, &*jwks.begin());
+	ASSERT_EQ("RS256", jwk.get_algorithm());
+
+	ASSERT_TRUE(jwks.has_jwk_by_x5t("thumbprint-1"));
+	ASSERT_FALSE(jwks.has_jwk_by_x5t("thumbprint-2"));
+	ASSERT_EQ("internal-1", jwks.get_jwk_by_x5t("thumbprint-1").get_key_id());
+	ASSERT_THROW(jwks.get_jwk_by_x5t("thumbprint-2"), jwt::error::claim_not_present_exception);
+
+	ASSERT_TRUE(jwks.has_jwk_by_x5t_sha256("sha256-thumbprint-0"));
+	ASSERT_EQ(&jwk, &jwks.get_jwk_by_x5t_sha256("sha256-thumbprint-0"));
+
+	ASSERT_FALSE(jwks.has_jwk("42"));
+}
+
+TEST(JwksTest, StreamingParse) {
+	std::string public_key = R"({
+	"comment": {"nested": [1, -2.5e3, true, false, null, "\"}]"]},
+	"keys": [{
+			"kid": "kéy\/1😀",
+			"kty": "RSA",
+			"alg": "RS256",
+			"use": "sig",
+			"n": "nr9Usx",
+			"e": "AQAB",
+			"x5t": "thumb",
+			"x5c": ["first", "second"],
+			"key_ops": ["verify"],
+			"extra": {"a": [1, 2, {"b": "c"}]}
+		},
+		{
+			"kid": "ec-key",
+			"kty": "EC",
+			"crv": "P-256",
+			"x": "xx",
+			"y": "yy",
+			"x5c": []
+		}
+	],
+	"trailer": 42
+})";
+
+	auto full = jwt::parse_jwks(public_key);
+	auto stream = jwt::parse_jwks(public_key, jwt::jwks_retain::key_material);
+	auto with_x5c = jwt::parse_jwks(public_key, jwt::jwks_retain::key_material_and_x5c);
+
+	const std::string kid = "k\xC3\xA9y/1\xF0\x9F\x98\x80";
+	ASSERT_TRUE(stream.has_jwk(kid));
+	ASSERT_TRUE(stream.has_jwk_by_x5t("thumb"));
+	const auto& rsa = stream.get_jwk(kid);
+	ASSERT_EQ(full.get_jwk(kid).get_jwk_claim("n").as_string(), rsa.get_jwk_claim("n").as_string());
+	ASSERT_EQ("AQAB", rsa.get_jwk_claim("e").as_string());
+	ASSERT_EQ("RS256", rsa.get_algorithm());
+	ASSERT_EQ("sig", rsa.get_use());
+	ASSERT_FALSE(rsa.has_x5c());
+	ASSERT_FALSE(rsa.has_key_operations());
+	ASSERT_FALSE(rsa.has_jwk_claim("extra"));
+
+	const auto& ec = stream.get_jwk("ec-key");
+	ASSERT_EQ("P-256", ec.get_curve());
+	ASSERT_EQ("xx", ec.get_jwk_claim("x").as_string());
+	ASSERT_EQ("yy", ec.get_jwk_claim("y").as_string());
+
+	ASSERT_EQ(1, with_x5c.get_jwk(kid).get_x5c().size());
+	ASSERT_EQ("first", with_x5c.get_jwk(kid).get_x5c_key_value());
+	ASSERT_EQ(0, with_x5c.get_jwk("ec-key").get_x5c().size());
+
+	const auto mode = jwt::jwks_retain::key_material;
+	ASSERT_THROW(jwt::parse_jwks(R"({"keys": [{"kid": "a"}])", mode), jwt::error::invalid_json_exception);
+	ASSERT_THROW(jwt::parse_jwks(R"({"keys": [{"kid": "\x"}]})", mode), jwt::error::invalid_json_exception);
+	ASSERT_THROW(jwt::parse_jwks(R"({"keys": []} trailing)", mode), jwt::error::invalid_json_exception);
+	ASSERT_THROW(jwt::parse_jwks(R"({"other": []})", mode), jwt::error::invalid_json_exception);
+	ASSERT_THROW(jwt::parse_jwks(R"({"keys": ["not an object"]})", mode), std::bad_cast);
+	ASSERT_THROW(jwt::parse_jwks(R"({"keys": {}})", mode), std::bad_cast);
+	ASSERT_NO_THROW(jwt::parse_jwks(R"({"keys": []})", mode));
+	ASSERT_NO_THROW(jwt::parse_jwks(R"({"keys": [], "n": [0, -1.5, 2e10, 3E-2, 0.25e+1]})", mode));
+	for (const auto number : {"1-+e", "01", "-", "1.", ".5", "1e", "1e+", "+1", "--1"})
+		ASSERT_THROW(jwt::parse_jwks(std::string(R"({"keys": [], "n": )") + number + "}", mode),
+					 jwt::error::invalid_json_exception)
+			<< number;
+}
+
+TEST(JwksTest, KeyStoreVerify) {
+	auto store = std::make_shared<jwt::jwks_key_store<jwt::picojson_traits>>(jwt::parse_jwks(key_store_jwks));
+	ASSERT_EQ(3, store->get_snapshot()->size());
+	ASSERT_TRUE(store->has_key("rsa-key"));
+	ASSERT_FALSE(store->has_key("enc-key"));
+	ASSERT_FALSE(store->has_key("unknown-key"));
+	ASSERT_EQ("ES256", store->get_key("ec-key")->get_algorithm());
+
+	auto verify = jwt::verify().with_key_store(store).with_issuer("auth0");
+
+	const auto rsa_token = jwt::create().set_issuer("auth0").set_key_id("rsa-key").sign(
+		jwt::crypto::algorithm::rs256("", rsa_priv_key, "", ""));
+	verify.verify(jwt::decode(rsa_token));
+
+	const auto ec_token = jwt::create().set_issuer("auth0").set_key_id("ec-key").sign(
+		jwt::crypto::algorithm::es256("", ecdsa256_priv_key, "", ""));
+	verify.verify(jwt::decode(ec_token));
+
+	const auto hmac_token =
+		jwt::create().set_issuer("auth0").set_key_id("hmac-key").sign(jwt::crypto::algorithm::hs256("secret"));
+	verify.verify(jwt::decode(hmac_token));
+
+	std::error_code ec;
+	const auto unknown_kid =
+		jwt::create().set_issuer("auth0").set_key_id("enc-key").sign(jwt::crypto::algorithm::hs256("secret"));
+	verify.verify(jwt::decode(unknown_kid), ec);
+	ASSERT_EQ(ec, jwt::error::token_verification_error::key_not_found);
+
+	const auto wrong_alg =
+		jwt::create().set_issuer("auth0").set_key_id("rsa-key").sign(jwt::crypto::algorithm::hs256("secret"));
+	verify.verify(jwt::decode(wrong_alg), ec);
+	ASSERT_EQ(ec, jwt::error::token_verification_error::wrong_algorithm);
+
+	const auto wrong_key =
+		jwt::create().set_issuer("auth0").set_key_id("hmac-key").sign(jwt::crypto::algorithm::hs256("other"));
+	verify.verify(jwt::decode(wrong_key), ec);
+	ASSERT_EQ(ec, jwt::error::signature_verification_error::invalid_signature);
+}
+
+TEST(JwksTest, KeyStoreRefresh) {
+	jwt::jwks_key_store<jwt::picojson_traits> store(jwt::parse_jwks(key_store_jwks));
+	const auto before = store.get_snapshot();
+
+	auto updated = key_store_jwks;
+	updated.replace(updated.find("c2VjcmV0"), 8, "b3RoZXI");
+	store.refresh(updated);
+	const auto after = store.get_snapshot();
+
+	ASSERT_NE(before, after);
+	ASSERT_EQ(before->find("rsa-key"), after->find("rsa-key"));
+	ASSERT_EQ(before->find("ec-key"), after->find("ec-key"));
+	ASSERT_NE(before->find("hmac-key"), after->find("hmac-key"));
+	ASSERT_EQ(after->find("hmac-key")->get_fingerprint().find("b3RoZXI"), std::string::npos);
+	ASSERT_EQ(after->find("hmac-key")->get_fingerprint().size(), 64);
+
+	const auto token = jwt::create().set_key_id("hmac-key").sign(jwt::crypto::algorithm::hs256("other"));
+	const auto decoded = jwt::decode(token);
+	std::error_code ec;
+	after->find("hmac-key")->verify(decoded.get_header_base64() + "." + decoded.get_payload_base64(),
+									decoded.get_signature(), ec);
+	ASSERT_FALSE(ec);
+	before->find("hmac-key")->verify(decoded.get_header_base64() + "." + decoded.get_payload_base64(),
+									 decoded.get_signature(), ec);
+	ASSERT_EQ(ec, jwt::error::signature_verification_error::invalid_signature);
+
+	store.refresh(R"({"keys": []})");
+	ASSERT_FALSE(store.has_key("rsa-key"));
+	ASSERT_EQ(3, after->size());
+}
+
+TEST(JwksTest, RefreshManagerCoalescesMisses) {
+	std::atomic<int> fetches{0};
+	std::string document = key_store_jwks;
+	std::mutex document_mutex;
+	auto fetch = [&]() {
+		fetches++;
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		std::lock_guard<std::mutex> lock(document_mutex);
+		return document;
+	};
+
+	jwt::jwks_refresh_options opts;
+	opts.min_refresh_interval = std::chrono::milliseconds(0);
+	opts.negative_cache_ttl = std::chrono::milliseconds(200);
+	jwt::jwks_refresh_manager<jwt::picojson_traits> manager(fetch, opts);
+	ASSERT_EQ(1, fetches);
+	ASSERT_NE(nullptr, manager.get_key("rsa-key"));
+	ASSERT_EQ(1, fetches);
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 8; i++) {
+		threads.emplace_back([&manager]() { ASSERT_EQ(nullptr, manager.get_key("new-key")); });
+	}
+	for (auto& t : threads)
+		t.join();
+	ASSERT_EQ(2, fetches);
+
+	// negative cached
+	ASSERT_EQ(nullptr, manager.get_key("new-key"));
+	ASSERT_EQ(2, fetches);
+
+	{
+		std::lock_guard<std::mutex> lock(document_mutex);
+		document.replace(document.find("enc-key"), 7, "new-key");
+		document.replace(document.find("\"enc\""), 5, "\"sig\"");
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(250));
+	ASSERT_NE(nullptr, manager.get_key("new-key"));
+	ASSERT_EQ(3, fetches);
+}
+
+TEST(JwksTest, RefreshManagerRateLimit) {
+	int fetches = 0;
+	jwt::jwks_refresh_options opts;
+	opts.min_refresh_interval = std::chrono::hours(1);
+	jwt::jwks_refresh_manager<jwt::picojson_traits> manager(
+		[&fetches]() {
+			fetches++;
+			if (fetches > 1) throw std::runtime_error("endpoint unavailable");
+			return key_store_jwks;
+		},
+		opts);
+
+	ASSERT_EQ(nullptr, manager.get_key("unknown-0"));
+	ASSERT_EQ(nullptr, manager.get_key("unknown-1"));
+	ASSERT_EQ(1, fetches);
+
+	ASSERT_FALSE(manager.refresh());
+	ASSERT_EQ(2, fetches);
+	ASSERT_NE(nullptr, manager.get_key("rsa-key"));
+
+	auto verify = jwt::verify().with_key_lookup([&manager](const std::string& kid) { return manager.get_key(kid); });
+	const auto token = jwt::create().set_key_id("hmac-key").sign(jwt::crypto::algorithm::hs256("secret"));
+	verify.verify(jwt::decode(token));
+}
+
+TEST(JwksTest, RefreshManagerRateLimitedMissIsNotRemembered) {
+	std::string document = key_store_jwks;
+	std::mutex document_mutex;
+	jwt::jwks_refresh_options opts;
+	opts.min_refresh_interval = std::chrono::milliseconds(20);
+	opts.negative_cache_ttl = std::chrono::hours(1);
+	jwt::jwks_refresh_manager<jwt::picojson_traits> manager(
+		[&]() {
+			std::lock_guard<std::mutex> lock(document_mutex);
+			return document;
+		},
+		opts);
+
+	// Within the rate limit, nothing was fetched to prove the key unknown
+	ASSERT_EQ(nullptr, manager.get_key("new-key"));
+	{
+		std::lock_guard<std::mutex> lock(document_mutex);
+		document.replace(document.find("enc-key"), 7, "new-key");
+		document.replace(document.find("\"enc\""), 5, "\"sig\"");
+	}
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (manager.get_key("new-key") == nullptr && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	ASSERT_NE(nullptr, manager.get_key("new-key"));
+}
+
+TEST(JwksTest, RefreshManagerFetchThrowsAnything) {
+	int fetches = 0;
+	jwt::jwks_refresh_manager<jwt::picojson_traits> manager([&fetches]() -> std::string {
+		if (fetches++ > 0) throw 42;
+		return key_store_jwks;
+	});
+	ASSERT_FALSE(manager.refresh());
+	ASSERT_TRUE(manager.get_key_store()->has_key("rsa-key"));
+}
+
+TEST(JwksTest, RefreshManagerBackground) {
+	std::atomic<int> fetches{0};
+	jwt::jwks_refresh_options opts;
+	opts.refresh_interval = std::chrono::milliseconds(10);
+	opts.refresh_jitter = std::chrono::milliseconds(5);
+	jwt::jwks_refresh_manager<jwt::picojson_traits> manager(
+		[&fetches]() {
+			fetches++;
+			return key_store_jwks;
+		},
+		opts);
+
+	manager.start();
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (fetches < 4 && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	manager.stop();
+	ASSERT_GE(fetches, 4);
+
+	const auto stopped = fetches.load();
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	ASSERT_EQ(stopped, fetches);
+	ASSERT_TRUE(manager.get_key_store()->has_key("ec-key"));
+}
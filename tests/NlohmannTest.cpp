@@ -136,6 +136,28 @@ TEST(NlohmannTest, VerifyTokenHS256) {
 	verify.verify(decoded_token);
 }
 
+TEST(NlohmannTest, VerifyTokenStructuredClaim) {
+	const auto roles = nlohmann::json::parse(R"(["admin", {"scope": ["read", "write"]}])");
+	const auto token = jwt::create<nlohmann_traits>()
+						   .set_issuer("auth0")
+						   .set_payload_claim("roles", jwt::basic_claim<nlohmann_traits>(roles))
+						   .sign(jwt::algorithm::hs256{"secret"});
+	auto decoded_token = jwt::decode<nlohmann_traits>(token);
+
+	std::error_code ec;
+	jwt::verify<jwt::default_clock, nlohmann_traits>({})
+		.allow_algorithm(jwt::algorithm::hs256{"secret"})
+		.with_claim("roles", jwt::basic_claim<nlohmann_traits>(roles))
+		.verify(decoded_token, ec);
+	ASSERT_FALSE(ec);
+
+	jwt::verify<jwt::default_clock, nlohmann_traits>({})
+		.allow_algorithm(jwt::algorithm::hs256{"secret"})
+		.with_claim("roles", jwt::basic_claim<nlohmann_traits>(nlohmann::json::parse(R"(["admin"])")))
+		.verify(decoded_token, ec);
+	ASSERT_EQ(ec, jwt::error::token_verification_error::claim_value_missmatch);
+}
+
 TEST(NlohmannTest, VerifyTokenExpirationValid) {
 	const auto token = jwt::create<nlohmann_traits>()
 						   .set_issuer("auth0")
@@ -24,7 +24,7 @@ static uint64_t fail_PEM_read_bio_PUBKEY = 0;
 static uint64_t fail_PEM_read_bio_PrivateKey = 0;
 static uint64_t fail_PEM_read_bio_EC_PUBKEY = 0;
 static uint64_t fail_PEM_read_bio_ECPrivateKey = 0;
-static uint64_t fail_HMAC = 0;
+static uint64_t fail_HMAC_init = 0;
 static uint64_t fail_EVP_MD_CTX_new = 0;
 static uint64_t fail_EVP_DigestInit = 0;
 static uint64_t fail_EVP_DigestUpdate = 0;
@@ -167,18 +167,30 @@ EC_KEY* PEM_read_bio_ECPrivateKey(BIO* bp, EC_KEY** x, pem_password_cb* cb, void
 		return origMethod(bp, x, cb, u);
 }
 
-unsigned char* HMAC(const EVP_MD* evp_md, const void* key, int key_len, const unsigned char* d, size_t n,
-					unsigned char* md, unsigned int* md_len) {
-	static unsigned char* (*origMethod)(const EVP_MD* evp_md, const void* key, int key_len, const unsigned char* d,
-										size_t n, unsigned char* md, unsigned int* md_len) = nullptr;
-	if (origMethod == nullptr) origMethod = (decltype(origMethod))dlsym(RTLD_NEXT, "HMAC");
-	bool fail = fail_HMAC & 1;
-	fail_HMAC = fail_HMAC >> 1;
+#ifdef JWT_OPENSSL_3_0
+int EVP_MAC_init(EVP_MAC_CTX* ctx, const unsigned char* key, size_t keylen, const OSSL_PARAM params[]) {
+	static int (*origMethod)(EVP_MAC_CTX * ctx, const unsigned char* key, size_t keylen,
+							 const OSSL_PARAM params[]) = nullptr;
+	if (origMethod == nullptr) origMethod = (decltype(origMethod))dlsym(RTLD_NEXT, "EVP_MAC_init");
+	bool fail = fail_HMAC_init & 1;
+	fail_HMAC_init = fail_HMAC_init >> 1;
 	if (fail)
-		return nullptr;
+		return 0;
 	else
-		return origMethod(evp_md, key, key_len, d, n, md, md_len);
+		return origMethod(ctx, key, keylen, params);
 }
+#else
+int HMAC_Init_ex(HMAC_CTX* ctx, const void* key, int len, const EVP_MD* md, ENGINE* impl) {
+	static int (*origMethod)(HMAC_CTX * ctx, const void* key, int len, const EVP_MD* md, ENGINE* impl) = nullptr;
+	if (origMethod == nullptr) origMethod = (decltype(origMethod))dlsym(RTLD_NEXT, "HMAC_Init_ex");
+	bool fail = fail_HMAC_init & 1;
+	fail_HMAC_init = fail_HMAC_init >> 1;
+	if (fail)
+		return 0;
+	else
+		return origMethod(ctx, key, len, md, impl);
+}
+#endif
 
 EVP_MD_CTX* EVP_MD_CTX_new(void) {
 	static EVP_MD_CTX* (*origMethod)(void) = nullptr;
@@ -556,7 +568,7 @@ TEST(OpenSSLErrorTest, HMACSign) {
 	auto verify = jwt::verify().allow_algorithm(jwt::algorithm::hs256{"secret"}).with_issuer("auth0");
 
 	auto decoded_token = jwt::decode(token);
-	std::vector<multitest_entry> mapping{{&fail_HMAC, 1, jwt::error::signature_generation_error::hmac_failed}};
+	std::vector<multitest_entry> mapping{{&fail_HMAC_init, 1, jwt::error::signature_generation_error::hmac_failed}};
 
 	run_multitest(mapping, [&](std::error_code& ec) { verify.verify(decoded_token, ec); });
 }